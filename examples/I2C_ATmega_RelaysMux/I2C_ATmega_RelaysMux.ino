@@ -5,7 +5,7 @@
 **    Date     : 12-04-2020
 */
 #define _MAJOR_VERSION  1
-#define _MINOR_VERSION  7
+#define _MINOR_VERSION  17
 /*
 **
 **  Copyright (c) 2020 Willem Aandewiel
@@ -67,6 +67,7 @@
 // #include <Arduino.h>
 #include <Wire.h>
 #include <EEPROM.h>
+#include "boardProfile.h"
 
 #define _I2C_DEFAULT_ADDRESS  0x48  // 72 dec
 
@@ -80,13 +81,34 @@ struct registerLayout {
   byte      lastGpioState;  // 0x03
   byte      whoAmI;         // 0x04
   byte      numberOfRelays; // 0x05
-  byte      filler[3];      // 0x06 .. 0x08
+  uint16_t  relayState;     // 0x06 .. 0x07
+  byte      bootReason;     // 0x08 MCUSR at the last reset
+  byte      powerOnMode;    // 0x09 _POWERON_OFF, _POWERON_MASK or _POWERON_LAST
+  uint16_t  powerOnMask;    // 0x0A .. 0x0B relays 'closed' at power-on
 };
 
 
+//------ bits in registerStack.status -------------------------------------
+#define _STATUS_BUSY            0   // received messages not yet executed
+#define _STATUS_OVERRUN         1   // a message was dropped (cleared on read)
+#define _STATUS_SCHEDULE        2   // a relay timer or the sequence is running
+#define _STATUS_EVENTS          3   // there are events in the log (see eventStuff)
+#define _STATUS_RESTARTED       4   // set at power-on/reset (cleared on read)
+
 #define _CMD_REGISTER           0xF0
+#define _LATCH_REGISTER         0xF2  // also accepted as General Call
+#define _EVENT_REGISTER         0xF3  // read the event log
+#define _BATCH_REGISTER         0xF4  // batch frame in, acknowledgement out
+#define _CYCLES_REGISTER        0xF5  // [0xF5, page] in, relay cycle counters out
 #define _I2CMUX_WHOAMI          0x04
 #define _I2CMUX_NUMBEROFRELAYS  0x05
+#define _I2CMUX_POWERONMODE     0x09
+#define _I2CMUX_POWERONMASK     0x0A  // 0x0A .. 0x0B
+
+//------ relay state at power-on -------------------------------------------
+#define _POWERON_OFF            0   // all relays 'open'
+#define _POWERON_MASK           1   // powerOnMask
+#define _POWERON_LAST           2   // the last relay state (saved by savePowerOnState())
 
 //These are the defaults for all settings
 registerLayout registerStack = {
@@ -96,7 +118,10 @@ registerLayout registerStack = {
   .lastGpioState  = 0 ,                   // 0x03 - RO
   .whoAmI         = _I2C_DEFAULT_ADDRESS, // 0x04 - RW
   .numberOfRelays = 16,                   // 0x05 - RW
-  .filler =  {0xFF, 0xFF, 0xFF}           // 0x06 .. 0x08
+  .relayState     = 0,                    // 0x06 .. 0x07 - RO
+  .bootReason     = 0,                    // 0x08 - RO
+  .powerOnMode    = _POWERON_OFF,         // 0x09 - RW (CMD_WRITECONF to save)
+  .powerOnMask    = 0                     // 0x0A .. 0x0B - RW (CMD_WRITECONF to save)
 };
   //----
 byte  I2CMUX_COMMAND         = 0xF0 ; // -> this is NOT a "real" register!!
@@ -109,47 +134,50 @@ char d1[10];
 volatile byte     registerNumber; 
 char d2[10];
 
-//                    x  <-------PD--------->  <---PB--->  <-----PC----->
-//         relay      0, 1, 2, 3, 4, 5, 6, 7,  8, 9,10,11, 12,13,14,15,16
-int8_t p2r16[17] = { -1, 1, 0, 3, 2, 5, 4, 7,  6, 9, 8,13, 10,15,14,17,16} ;  // 16 relay board
-int8_t  p2r8[17] = { -1, 1, 3, 5, 7, 9,13,15, 17, 0, 0, 0,  0, 0, 0, 0, 0} ;  //  8 relay board
+//------ messages from the master, received in the TWI interrupt ----------
+//------ and executed in loop() --------------------------------------------
+#define _MSG_QUEUE_SIZE         4
+#define _MAX_MESSAGE           32   // Wire buffer length
+
+struct i2cMessage {
+  byte      length;
+  byte      data[_MAX_MESSAGE];     // data[0] is the registerNumber
+};
+
+i2cMessage        msgQueue[_MSG_QUEUE_SIZE];
+volatile byte     msgHead = 0;      // only changed by receiveEvent()
+volatile byte     msgTail = 0;      // only changed by processMessages()
+volatile bool     latchQueued = false;  // a latch waits for the messages
+volatile byte     latchAt;              // .. before it: until msgTail is here
 
 
 //------ commands ----------------------------------------------------------
 enum  {  CMD_PINMODE, CMD_DIGITALWRITE, CMD_DIGITALREAD
-       , CMD_TESTRELAYS, CMD_SPARE5
+       , CMD_TESTRELAYS, CMD_EXTENDED
        , CMD_READCONF, CMD_WRITECONF, CMD_REBOOT 
       };
 
-//==========================================================================
-void wait(uint16_t msecs)
-{
-  sei();
-  delay(msecs);
-  cli();
-  
-} // wait()
-
+//------ extended commands (byte following 1<<CMD_EXTENDED) ----------------
+enum  {  XCMD_WRITEALL, XCMD_STAGEALL
+       , XCMD_PULSE, XCMD_DELAYED, XCMD_SEQLOAD, XCMD_SEQSTART, XCMD_STOP
+       , XCMD_RESETCYCLES
+      };
 
 //==========================================================================
 void oneLoop()
 {
     for (int i=1; i<=registerStack.numberOfRelays; i++) 
     {
-      if (registerStack.numberOfRelays == 8)
-            digitalWrite(p2r8[i],  LOW);
-      else  digitalWrite(p2r16[i], LOW);
+      writeRelay(i, HIGH);
       wdt_reset();
-      wait(100);
+      delay(100);
     }
 //  wait(300);
     wdt_reset();
     for (int i=1; i<=registerStack.numberOfRelays; i++) 
     {
-      if (registerStack.numberOfRelays == 8)
-            digitalWrite(p2r8[i],  HIGH);
-      else  digitalWrite(p2r16[i], HIGH);
-      wait(100);
+      writeRelay(i, LOW);
+      delay(100);
       wdt_reset();
     }
 //  wait(300);
@@ -170,12 +198,13 @@ void testRelays()
 //==========================================================================
 void reBoot()
 {
+  flushCycleCounters();
   while(true) 
   {
-    digitalWrite(p2r16[11], LOW);
-    wait(500);
-    digitalWrite(p2r16[11], HIGH);
-    wait(500);
+    digitalWrite(relayBoard<16>::pin[11], LOW);
+    delay(500);
+    digitalWrite(relayBoard<16>::pin[11], HIGH);
+    delay(500);
   }
   while (true) {} // let WDT crash
 
@@ -185,19 +214,30 @@ void reBoot()
 //==========================================================================
 void setup()
 {
+  registerStack.bootReason = MCUSR;   // why did we (re)start?
   MCUSR=0x00; //<<<-- keep this in!
   wdt_disable();
 
+  //-- read the config first, so the relays go straight to their
+  //-- power-on state (no "all off" glitch after a brownout or WDT reset)
+  readConfig();
+
   PORTB = B00100111;  // PB0=D08,PB1=D09,PB2=D10,PB5=D13
-  DDRB  = B00100111;  // set GPIO pins on PORTB to OUTPUT
   PORTC = B00001111;  // PC0=D12,PC1=D13,PC2=D14,PC3=D15
-  DDRC  = B00001111;  // set GPIO pins on PORTC to OUTPUT  
   PORTD = B11111111;  // PD0=D00,PD1=D01,PC2=D02,PC3=D03,PC4=D04,PD5=D05,PD6=D06,PD7=D07
+  if (registerStack.powerOnMode != _POWERON_OFF) 
+  {
+    applyRelayMask(registerStack.powerOnMask);  // only sets the PORT bits
+  }
+  DDRB  = B00100111;  // set GPIO pins on PORTB to OUTPUT
+  DDRC  = B00001111;  // set GPIO pins on PORTC to OUTPUT  
   DDRD  = B11111111;  // set all GPIO pins on PORTD to OUTPUT 
 
   registerStack.lastGpioState = LOW;    
+  startCycleCounters();
 
-  readConfig();
+  registerStack.status = _BV(_STATUS_RESTARTED);  // the master lost what we had in RAM
+  startEventLog();
   
   startI2C();
   
@@ -210,6 +250,12 @@ void setup()
 void loop()
 {
    wdt_reset();
+
+   processMessages();
+   handleSchedule();
+   logRelayChanges();
+   savePowerOnState();
+   handleCycleCounters();
    
 } // loop()
 
@@ -16,7 +16,13 @@ void startI2C()
 
   Wire.begin(registerStack.whoAmI);
   //Wire.begin(_I2C_DEFAULT_ADDRESS);
-  Wire.setClock(100000L);
+  //-- as a Slave we follow the clock of the master. Because all the
+  //-- work is done in loop() and not in the interrupt, Fast mode 
+  //-- (400kHz) is no problem at 16MHz
+  Wire.setClock(400000L);
+  //-- also listen to the General Call address (0x00) so a master
+  //-- can latch staged relays on all boards at the same moment
+  TWAR |= _BV(TWGCE);
 
   // (Re)Declare the Events.
   Wire.onReceive(receiveEvent);
@@ -37,62 +43,96 @@ boolean isConnected()
 } // isConnected()
 
 
+//------------------------------------------------------------------
+//-- the message processMessages() is executing --------------------
+i2cMessage  msg;
+byte        msgPos;
+
+//------------------------------------------------------------------
+//-- next byte of the message (0 if there are no more bytes) -------
+byte readMessage()
+{
+  if (msgPos < msg.length) return (msg.data[msgPos++]);
+  return (0);
+
+} // readMessage()
+
+
+//------------------------------------------------------------------
+void processExtCommand(byte xCommand)
+{
+  byte      LSB, MSB, GPIO_PIN, HIGH_LOW, offset, count;
+  uint32_t  msecs;
+  
+  switch(xCommand)
+  {
+    case XCMD_WRITEALL:
+            LSB = readMessage();
+            MSB = readMessage();
+            stopSchedule();
+            applyRelayMask(((uint16_t)MSB << 8) | LSB);
+            break;
+    case XCMD_STAGEALL:
+            LSB = readMessage();
+            MSB = readMessage();
+            stageRelayMask(((uint16_t)MSB << 8) | LSB);
+            break;
+    case XCMD_PULSE:
+    case XCMD_DELAYED:
+            GPIO_PIN = readMessage();
+            HIGH_LOW = readMessage();
+            msecs    = readMessage();
+            msecs   |= (uint32_t)readMessage() << 8;
+            msecs   |= (uint32_t)readMessage() << 16;
+            msecs   |= (uint32_t)readMessage() << 24;
+            if (xCommand == XCMD_PULSE) 
+                  pulseRelay(GPIO_PIN, HIGH_LOW, msecs);
+            else  delayRelay(GPIO_PIN, HIGH_LOW, msecs);
+            break;
+    case XCMD_SEQLOAD:
+            offset = readMessage();
+            count  = readMessage();
+            loadSequence(offset, count);
+            break;
+    case XCMD_SEQSTART:
+            LSB    = readMessage();
+            MSB    = readMessage();
+            count  = readMessage();   // passes
+            offset = readMessage();   // length
+            startSequence(((uint16_t)MSB << 8) | LSB, count, offset);
+            break;
+    case XCMD_STOP:
+            stopSchedule();
+            break;
+    case XCMD_RESETCYCLES:
+            resetCycleCounters(readMessage());
+            break;
+  }
+
+} // processExtCommand()
+
+
 //------------------------------------------------------------------
 void processCommand(byte command)
 {
   byte GPIO_PIN, PINMODE, HIGH_LOW, GPIOSTATE;
   if ((command & (1<<CMD_PINMODE))) {
-    GPIO_PIN = Wire.read();
-    PINMODE = Wire.read();
-    if (registerStack.numberOfRelays == 8)
-    {
-      if (GPIO_PIN >= 1 && GPIO_PIN <= 8) 
-      {
-        pinMode(p2r8[GPIO_PIN], PINMODE);
-      }
-    }
-    else
-    {
-      if (GPIO_PIN >= 1 && GPIO_PIN <= 16) 
-      {
-        pinMode(p2r16[GPIO_PIN], PINMODE);
-      }
-    }
+    GPIO_PIN = readMessage();
+    PINMODE = readMessage();
+    if (relayPin(GPIO_PIN) >= 0) pinMode(relayPin(GPIO_PIN), PINMODE);
   }
   else if ((command & (1<<CMD_DIGITALWRITE))) {
-    GPIO_PIN = Wire.read();
-    HIGH_LOW = Wire.read();
-    if (registerStack.numberOfRelays == 8)
-    {
-      if (GPIO_PIN >= 1 && GPIO_PIN <= 8) 
-      {
-        digitalWrite(p2r8[GPIO_PIN], !HIGH_LOW);
-      }
-    }
-    else
-    {
-      if (GPIO_PIN >= 1 && GPIO_PIN <= 16) 
-      {
-        digitalWrite(p2r16[GPIO_PIN], !HIGH_LOW);
-      }
-    }
+    GPIO_PIN = readMessage();
+    HIGH_LOW = readMessage();
+    cancelTimer(GPIO_PIN);
+    writeRelay(GPIO_PIN, HIGH_LOW);
   }
   else if ((command & (1<<CMD_DIGITALREAD))) {
-    GPIO_PIN = Wire.read();
-    if (registerStack.numberOfRelays == 8)
-    {
-      if (GPIO_PIN >= 1 && GPIO_PIN <= 8) 
-      {
-        registerStack.lastGpioState = !digitalRead(p2r8[GPIO_PIN]);
-      }
-    }
-    else
-    {
-      if (GPIO_PIN >= 1 && GPIO_PIN <= 16) 
-      {
-        registerStack.lastGpioState = !digitalRead(p2r16[GPIO_PIN]);
-      }
-    }
+    GPIO_PIN = readMessage();
+    if (relayPin(GPIO_PIN) >= 0) registerStack.lastGpioState = readRelay(GPIO_PIN);
+  }
+  else if ((command & (1<<CMD_EXTENDED))) {
+    processExtCommand(readMessage());
   }
   if ((command & (1<<CMD_TESTRELAYS))) 
   {
@@ -115,33 +155,181 @@ void processCommand(byte command)
 } // processCommand()
 
 //------------------------------------------------------------------
-//-- The master sends updated info that will be stored in the ------
-//-- register(s)
-//-- All Setters end up here ---------------------------------------
-void receiveEvent(int numberOfBytesReceived) 
+//-- A batch frame is [seq][length][commands ..][CRC-8]. The -------
+//-- commands are the ones the master writes to _CMD_REGISTER ------
+//-- and are executed in order, but only if the CRC is right and ---
+//-- all of them are known. The acknowledgement is read back from --
+//-- _BATCH_REGISTER (see sendBatchAck()) --------------------------
+#define _BATCH_OK               0
+#define _BATCH_BADCRC           1
+#define _BATCH_BADFRAME         2
+#define _BATCH_ACK_SIZE         8   // status + 6 bytes + CRC-8
+
+struct batchResult {
+  byte      seq;
+  byte      result;
+  byte      commands;     // commands executed
+  byte      readStates;   // bit n is the (n+1)th digitalRead ('1' is 'closed')
+  uint16_t  relayState;
+};
+batchResult batchAck = { 0, _BATCH_OK, 0, 0, 0 };
+
+//------------------------------------------------------------------
+//-- bytes of the command at cmd (0 if it can't be in a batch) -----
+byte batchCommandLength(const byte *cmd, byte left)
 {
-  //(void)numberOfBytesReceived;  // cast unused parameter to void to avoid compiler warning
-  
-  registerNumber = Wire.read(); // Get the memory map offset from the user
-  
-  if (registerNumber == _CMD_REGISTER) {   // command
-    byte command = Wire.read(); // read the command
+  byte length;
+
+  switch(cmd[0])
+  {
+    case (1<<CMD_PINMODE):
+    case (1<<CMD_DIGITALWRITE): length = 3;  break;
+    case (1<<CMD_DIGITALREAD):  length = 2;  break;
+    case (1<<CMD_READCONF):
+    case (1<<CMD_WRITECONF):    length = 1;  break;
+    case (1<<CMD_EXTENDED):
+            if (left < 2) return 0;
+            switch(cmd[1])
+            {
+              case XCMD_WRITEALL:
+              case XCMD_STAGEALL:   length = 4;  break;
+              case XCMD_PULSE:
+              case XCMD_DELAYED:    length = 8;  break;
+              case XCMD_SEQLOAD:    if (left < 4) return 0;
+                                    length = 4 + (cmd[3] * 2);
+                                    break;
+              case XCMD_SEQSTART:   length = 6;  break;
+              case XCMD_STOP:       length = 2;  break;
+              case XCMD_RESETCYCLES: length = 3; break;
+              default:              return 0;
+            }
+            break;
+    //-- CMD_TESTRELAYS and CMD_REBOOT take (for)ever --
+    default:  return 0;
+  }
+  return (length <= left) ? length : 0;
+
+} // batchCommandLength()
+
+
+//------------------------------------------------------------------
+void processBatch()
+{
+  batchResult ack   = { 0, _BATCH_OK, 0, 0, 0 };
+  byte        length, crc = 0, reads = 0;
+
+  ack.seq = readMessage();
+  length  = readMessage();
+  if (msg.length != (length + 4))   // [reg][seq][length] .. [crc]
+  {
+    ack.result = _BATCH_BADFRAME;
+  }
+  else
+  {
+    for (byte i = 1; i < (length + 3); i++) crc = crc8(crc, msg.data[i]);
+    if (crc != msg.data[length + 3]) ack.result = _BATCH_BADCRC;
+  }
+  //-- check all commands before executing the first --
+  for (byte pos = 3; ack.result == _BATCH_OK && pos < (length + 3); )
+  {
+    byte cmdLength = batchCommandLength(&msg.data[pos], (length + 3) - pos);
+    if (cmdLength == 0) ack.result = _BATCH_BADFRAME;
+    pos += cmdLength;
+  }
+  if (ack.result == _BATCH_OK)
+  {
+    msg.length = length + 3;        // readMessage() stops at the CRC
+    while (msgPos < msg.length)
+    {
+      byte command = readMessage();
+      processCommand(command);
+      if (command == (1<<CMD_DIGITALREAD))
+      {
+        if (registerStack.lastGpioState) ack.readStates |= _BV(reads);
+        reads++;
+      }
+      ack.commands++;
+    }
+  }
+  ack.relayState = readRelayMask();
+
+  byte oldSREG = SREG;
+  cli();
+  batchAck = ack;
+  SREG = oldSREG;
+
+} // processBatch()
+
+
+//------------------------------------------------------------------
+//-- called from requestEvent() for _BATCH_REGISTER ----------------
+void sendBatchAck()
+{
+  byte block[_BATCH_ACK_SIZE];
+  byte crc = 0;
+
+  block[0] = registerStack.status;
+  block[1] = batchAck.seq;
+  block[2] = batchAck.result;
+  block[3] = batchAck.commands;
+  block[4] = batchAck.readStates;
+  block[5] = batchAck.relayState & 0xFF;
+  block[6] = batchAck.relayState >> 8;
+  for (byte i = 0; i < (_BATCH_ACK_SIZE - 1); i++) crc = crc8(crc, block[i]);
+  block[_BATCH_ACK_SIZE - 1] = crc;
+  Wire.write(block, _BATCH_ACK_SIZE);
+
+} // sendBatchAck()
+
+
+//------------------------------------------------------------------
+//-- only the config registers can be written: STATUS, the releases,
+//-- lastGpioState, relayState and bootReason are read-only ---------
+bool registerWritable(uint16_t regNr)
+{
+  switch(regNr)
+  {
+    case _I2CMUX_WHOAMI:
+    case _I2CMUX_NUMBEROFRELAYS:
+    case _I2CMUX_POWERONMODE:
+    case _I2CMUX_POWERONMASK:
+    case _I2CMUX_POWERONMASK + 1:   return true;
+  }
+  return false;
+
+} // registerWritable()
+
+
+//------------------------------------------------------------------
+//-- Execute a message from the master. All Setters end up here ----
+void processMessage(byte regNr)
+{
+  if (regNr == _CMD_REGISTER) {   // command
+    byte command = readMessage(); // read the command
     processCommand(command);
     return;
   }
+  if (regNr == _BATCH_REGISTER) { // batch of commands
+    processBatch();
+    return;
+  }
+  if (regNr == _LATCH_REGISTER) { // a second latch while one waits
+    byte oldSREG = SREG;
+    cli();
+    latchRelayMask();
+    SREG = oldSREG;
+    return;
+  }
 
   //Begin recording the following incoming bytes to the temp memory map
-  //starting at the registerNumber (the first byte received)
-  for (byte x = 0 ; x < numberOfBytesReceived - 1 ; x++) {
-    byte temp = Wire.read();
-    if ( (x + registerNumber) < sizeof(registerLayout)) {
+  //starting at the regNr (the first byte received)
+  for (byte x = 0 ; x < msg.length - 1 ; x++) {
+    byte temp = readMessage();
+    if (registerWritable(regNr + x)) {
       //Store the result into the register map
-      if ((registerNumber + x) < 4 && (registerNumber + x) >= 6) {
-        return;
-      }
-      registerPointer[registerNumber + x] = temp;
+      registerPointer[regNr + x] = temp;
       //--- address change is a special case: writeConfig
-      if ((registerNumber + x) == _I2CMUX_WHOAMI) 
+      if ((regNr + x) == _I2CMUX_WHOAMI) 
       {
         writeConfig();
         reBoot();
@@ -149,6 +337,85 @@ void receiveEvent(int numberOfBytesReceived)
     }
   }
 
+} //  processMessage()
+
+
+//------------------------------------------------------------------
+//-- called from loop(): execute the received messages in order ----
+void processMessages()
+{
+  while (msgTail != msgHead) 
+  {
+    byte oldSREG = SREG;
+    cli();
+    memcpy(&msg, &msgQueue[msgTail], sizeof(msg));
+    SREG = oldSREG;
+
+    msgPos = 1;
+    processMessage(msg.data[0]);
+
+    oldSREG = SREG;
+    cli();
+    msgTail = (msgTail + 1) % _MSG_QUEUE_SIZE;
+    if (latchQueued && msgTail == latchAt) {
+      latchQueued = false;
+      latchRelayMask();
+    }
+    if (msgTail == msgHead && !configSaveBusy()) registerStack.status &= ~_BV(_STATUS_BUSY);
+    SREG = oldSREG;
+  }
+  countLatchedRelays();
+
+} // processMessages()
+
+
+//------------------------------------------------------------------
+//-- The master sends updated info that will be stored in the ------
+//-- register(s) or a command. This runs in the TWI interrupt, so --
+//-- the message is only queued; loop() executes it. The BUSY bit --
+//-- tells the master there is still work to do --------------------
+void receiveEvent(int numberOfBytesReceived) 
+{
+  registerNumber = Wire.read(); // Get the memory map offset from the user
+
+  //-- just setting the register pointer for a read ---
+  if (numberOfBytesReceived <= 1 && registerNumber != _LATCH_REGISTER) {
+    return;
+  }
+  //-- a (broadcast) latch switches the relays right here, or as soon --
+  //-- as the messages before it have been executed -------------------
+  if (registerNumber == _LATCH_REGISTER && !latchQueued) {
+    while (Wire.available()) Wire.read();
+    if (msgHead == msgTail) {
+      latchRelayMask();
+    } else {
+      latchAt     = msgHead;
+      latchQueued = true;
+    }
+    return;
+  }
+  //-- selecting the page is done here, so it can be read right away ---
+  if (registerNumber == _CYCLES_REGISTER) {
+    selectCyclePage(Wire.read());
+    while (Wire.available()) Wire.read();
+    return;
+  }
+
+  byte next = (msgHead + 1) % _MSG_QUEUE_SIZE;
+  if (next == msgTail) {        // loop() can't keep up
+    registerStack.status |= _BV(_STATUS_OVERRUN);
+    while (Wire.available()) Wire.read();
+    return;
+  }
+  i2cMessage *m = &msgQueue[msgHead];
+  m->data[0] = registerNumber;
+  m->length  = 1;
+  while (Wire.available() && m->length < _MAX_MESSAGE) {
+    m->data[m->length++] = Wire.read();
+  }
+  msgHead = next;
+  registerStack.status |= _BV(_STATUS_BUSY);
+
 } //  receiveEvent()
 
 //------------------------------------------------------------------
@@ -157,10 +424,27 @@ void receiveEvent(int numberOfBytesReceived)
 //-- All getters get there data from here --------------------------
 void requestEvent()
 {
-  //----- return max. 4 bytes to master, starting at registerNumber -------
-  for (uint8_t x = 0; ( (x < 4) && (x + registerNumber) < (sizeof(registerLayout) - 1) ); x++) {
-    Wire.write(registerPointer[(x + registerNumber)]);
+  if (registerNumber == _EVENT_REGISTER) {
+    sendEvents();
+    return;
+  }
+  if (registerNumber == _BATCH_REGISTER) {
+    sendBatchAck();
+    return;
+  }
+  if (registerNumber == _CYCLES_REGISTER) {
+    sendCycles();
+    return;
+  }
+  registerStack.relayState = readRelayMask();
+  
+  //----- return all bytes from registerNumber up to the end of the ------
+  //----- registers; the master stops (NACK's) after what it needs ------
+  for (uint8_t x = registerNumber; x < sizeof(registerLayout); x++) {
+    Wire.write(registerPointer[x]);
   }
+  //-- the master has seen the overrun and the restart ---
+  if (registerNumber == 0) registerStack.status &= ~(_BV(_STATUS_OVERRUN) | _BV(_STATUS_RESTARTED));
 
 } // requestEvent()
 
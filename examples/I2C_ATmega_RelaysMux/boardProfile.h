@@ -0,0 +1,181 @@
+/*
+***************************************************************************
+**
+**    Program : boardProfile.h (part of I2C_ATmega_RelaysMux)
+**
+**    Copyright (C) 2020 Willem Aandewiel
+**
+**    The relay-to-pin maps of the 8 and the 16 relay board, worked out
+**    by the compiler. relayPins<relayBoard<N>> unrolls every loop over
+**    the relays, so switching one relay is a compare and a single
+**    sbi/cbi and a whole mask is a few instructions per relay, with
+**    no table lookups and no digitalWrite() at run time.
+**
+**    TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _BOARDPROFILE_H
+#define _BOARDPROFILE_H
+
+//-- Arduino pin 0..7 is PORTD, 8..13 is PORTB and 14..19 is PORTC --------
+#define _PORT_B     0
+#define _PORT_C     1
+#define _PORT_D     2
+
+constexpr uint8_t portOf(int8_t pin)
+{
+  return (pin < 8) ? _PORT_D : (pin < 14) ? _PORT_B : _PORT_C;
+}
+
+constexpr uint8_t bitOf(int8_t pin)
+{
+  return (pin < 8) ? _BV(pin) : (pin < 14) ? _BV(pin - 8) : _BV(pin - 14);
+}
+
+//--------------------------------------------------------------------------
+//-- the board profiles: pin[relay] is the Arduino pin of that relay ------
+template <uint8_t N> struct relayBoard;
+
+template <> struct relayBoard<16>
+{
+  static constexpr uint8_t numRelays = 16;
+  //                                 x  <-------PD--------->  <---PB--->  <-----PC----->
+  //                      relay      0, 1, 2, 3, 4, 5, 6, 7,  8, 9,10,11, 12,13,14,15,16
+  static constexpr int8_t pin[17] = { -1, 1, 0, 3, 2, 5, 4, 7,  6, 9, 8,13, 10,15,14,17,16};
+};
+constexpr int8_t relayBoard<16>::pin[17];
+
+template <> struct relayBoard<8>
+{
+  static constexpr uint8_t numRelays = 8;
+  //                      relay      0, 1, 2, 3, 4, 5, 6, 7,  8
+  static constexpr int8_t pin[9]  = { -1, 1, 3, 5, 7, 9,13,15, 17};
+};
+constexpr int8_t relayBoard<8>::pin[9];
+
+
+//--------------------------------------------------------------------------
+//-- with constant port and bits these fold into a single sbi/cbi ---------
+inline void setPortBits(uint8_t port, uint8_t bits)
+{
+  if      (port == _PORT_D) PORTD |= bits;
+  else if (port == _PORT_B) PORTB |= bits;
+  else                      PORTC |= bits;
+}
+
+inline void clearPortBits(uint8_t port, uint8_t bits)
+{
+  if      (port == _PORT_D) PORTD &= ~bits;
+  else if (port == _PORT_B) PORTB &= ~bits;
+  else                      PORTC &= ~bits;
+}
+
+
+//--------------------------------------------------------------------------
+//-- relay R of BOARD and (recursively) all relays below it ---------------
+//-- the relays are "active LOW" so a '0' on the port is 'closed' ---------
+template <class BOARD, uint8_t R = BOARD::numRelays>
+struct relayPins
+{
+  typedef relayPins<BOARD, R - 1> next;
+
+  static constexpr uint8_t port   = portOf(BOARD::pin[R]);
+  static constexpr uint8_t pinBit = bitOf(BOARD::pin[R]);
+
+  //-- all port bits of 'port' that drive a relay --
+  static constexpr uint8_t portMask(uint8_t p)
+  {
+    return (port == p ? pinBit : 0) | next::portMask(p);
+  }
+
+  //-- collect the port bits that must go HIGH for relayMask --
+  static inline void collect(uint16_t relayMask, uint8_t &offB, uint8_t &offC, uint8_t &offD)
+  {
+    if (!(relayMask & ((uint16_t)1 << (R - 1))))
+    {
+      if      (port == _PORT_D) offD |= pinBit;
+      else if (port == _PORT_B) offB |= pinBit;
+      else                      offC |= pinBit;
+    }
+    next::collect(relayMask, offB, offC, offD);
+  }
+
+  //-- relayMask of the port snapshots (bit 0 is relay 1) --
+  static inline uint16_t read(uint8_t portB, uint8_t portC, uint8_t portD)
+  {
+    uint8_t portState = (port == _PORT_D) ? portD : (port == _PORT_B) ? portB : portC;
+    return ((portState & pinBit) ? 0 : ((uint16_t)1 << (R - 1))) | next::read(portB, portC, portD);
+  }
+
+  //-- switch relayNr (1 .. R), returns false if there is no such relay --
+  static inline bool write(uint8_t relayNr, bool closed)
+  {
+    if (relayNr != R) return next::write(relayNr, closed);
+    if (closed) clearPortBits(port, pinBit);
+    else        setPortBits(port, pinBit);
+    return true;
+  }
+};
+
+template <class BOARD>
+struct relayPins<BOARD, 0>
+{
+  static constexpr uint8_t portMask(uint8_t) { return 0; }
+  static inline void       collect(uint16_t, uint8_t &, uint8_t &, uint8_t &) {}
+  static inline uint16_t   read(uint8_t, uint8_t, uint8_t) { return 0; }
+  static inline bool       write(uint8_t, bool) { return false; }
+};
+
+
+//--------------------------------------------------------------------------
+//-- set all relays of BOARD in one go: bit 0 of relayMask is relay 1 -----
+template <class BOARD>
+inline void writeBoard(uint16_t relayMask)
+{
+  typedef relayPins<BOARD> pins;
+  uint8_t offB = 0, offC = 0, offD = 0;   // port bits that must go HIGH
+
+  pins::collect(relayMask, offB, offC, offD);
+
+  //-- the three port writes are only a few cycles apart ------------------
+  byte oldSREG = SREG;
+  cli();
+  PORTD = (PORTD & ~pins::portMask(_PORT_D)) | offD;
+  PORTB = (PORTB & ~pins::portMask(_PORT_B)) | offB;
+  PORTC = (PORTC & ~pins::portMask(_PORT_C)) | offC;
+  SREG  = oldSREG;
+}
+
+//--------------------------------------------------------------------------
+//-- read all relays of BOARD in one go: bit 0 is relay 1 -----------------
+template <class BOARD>
+inline uint16_t readBoard()
+{
+  return relayPins<BOARD>::read(PINB, PINC, PIND);
+}
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
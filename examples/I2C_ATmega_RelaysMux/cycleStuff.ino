@@ -0,0 +1,199 @@
+/*
+***************************************************************************
+**
+**    Program : cycleStuff (part of I2C_ATmega_RelaysMux)
+**
+**    Copyright (C) 2020 Willem Aandewiel
+**
+**    TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+//--------------------------------------------------------------------------
+//-- Relays wear out. For every relay we count the switch cycles (the
+//-- times it closed) and the total time it was closed. writeRelay() and
+//-- applyRelayMask() report every change (so a pulse that is over before
+//-- loop() comes around counts too). The counters are kept in RAM and
+//-- saved to EEPROM (see eepromStuff) at most every _CYCLES_SAVE_INTERVAL
+//-- msecs, one byte per loop(), and before a reboot.
+//--
+//-- The master selects a page by writing [0xF5, page] (handled in the
+//-- TWI interrupt, so it can read at once) and then reads 0xF5. It gets
+//-- one block of _CYCLES_BLOCK bytes:
+//--    [page] [numberOfRelays] [cycles, onSeconds] x _CYCLES_PER_PAGE [CRC-8]
+//-- cycles and onSeconds are 4 bytes, LSB first, of relay
+//-- (page * _CYCLES_PER_PAGE) + 1 and up. Relays beyond 16 are all 0.
+//-- A page past the last one gives the last one.
+//--------------------------------------------------------------------------
+
+#define _CYCLES_PER_PAGE     3
+#define _CYCLES_PAGES       ((16 + _CYCLES_PER_PAGE - 1) / _CYCLES_PER_PAGE)
+#define _CYCLES_BLOCK       (2 + (_CYCLES_PER_PAGE * 8) + 1)
+
+uint32_t          relayCycles[16];
+uint32_t          relayOnSeconds[16];
+uint16_t          relayOnMillis[16];      // not yet a whole second
+uint16_t          cycledMask    = 0;      // the relays as last counted
+uint32_t          onTimeTimer;            // millis() of the last accrueOnTime()
+bool              cyclesCounting = false;
+bool              cyclesChanged  = false; // not yet saved to EEPROM
+volatile byte     cyclePage      = 0;
+
+
+//--------------------------------------------------------------------------
+//-- called from setup(), after the relays got their power-on state -------
+void startCycleCounters()
+{
+  loadCycleCounters();
+  onTimeTimer    = millis();
+  cycledMask     = 0;             // relays closed at power-on made a cycle
+  cyclesCounting = true;
+  countRelayChanges(readRelayMask());
+
+} // startCycleCounters()
+
+
+//--------------------------------------------------------------------------
+//-- add the time since the last call to every relay that is closed -------
+void accrueOnTime()
+{
+  uint32_t elapsed = millis() - onTimeTimer;
+
+  if (elapsed == 0) return;
+  onTimeTimer += elapsed;
+  if (cycledMask == 0) return;
+
+  for (byte r = 0; r < 16; r++)
+  {
+    if (!(cycledMask & ((uint16_t)1 << r))) continue;
+    uint32_t onMillis = relayOnMillis[r] + elapsed;
+    byte oldSREG = SREG;
+    cli();    // sendCycles() runs in the TWI interrupt
+    relayOnSeconds[r] += onMillis / 1000;
+    SREG = oldSREG;
+    relayOnMillis[r]   = onMillis % 1000;
+  }
+  cyclesChanged = true;
+
+} // accrueOnTime()
+
+
+//--------------------------------------------------------------------------
+//-- relayMask is the new state of the relays: count the ones that closed -
+//-- (the caller knows the new state, the PIN registers lag one cycle) ----
+void countRelayChanges(uint16_t relayMask)
+{
+  if (!cyclesCounting || relayMask == cycledMask) return;
+
+  accrueOnTime();     // the old state was there until now
+  uint16_t closed = relayMask & ~cycledMask;
+  for (byte r = 0; closed != 0; r++, closed >>= 1)
+  {
+    if (!(closed & 1)) continue;
+    byte oldSREG = SREG;
+    cli();
+    relayCycles[r]++;
+    SREG = oldSREG;
+  }
+  cycledMask    = relayMask;
+  cyclesChanged = true;
+
+} // countRelayChanges()
+
+
+//--------------------------------------------------------------------------
+//-- relayNr 1 .. 16, or 0 for all relays (after replacing a board) -------
+void resetCycleCounters(byte relayNr)
+{
+  accrueOnTime();
+  for (byte r = 0; r < 16; r++)
+  {
+    if (relayNr != 0 && relayNr != (r + 1)) continue;
+    byte oldSREG = SREG;
+    cli();
+    relayCycles[r]    = 0;
+    relayOnSeconds[r] = 0;
+    SREG = oldSREG;
+    relayOnMillis[r]  = 0;
+  }
+  cyclesChanged = true;
+
+} // resetCycleCounters()
+
+
+//--------------------------------------------------------------------------
+//-- called from loop(): keep the on-time up-to-date and save it now and then
+void handleCycleCounters()
+{
+  if ((millis() - onTimeTimer) >= 1000) accrueOnTime();
+  saveCycleCounters(false);
+
+} // handleCycleCounters()
+
+
+//--------------------------------------------------------------------------
+//-- called from reBoot(): don't lose what was counted since the last save
+void flushCycleCounters()
+{
+  accrueOnTime();
+  saveCycleCounters(true);
+
+} // flushCycleCounters()
+
+
+//--------------------------------------------------------------------------
+//-- called from receiveEvent() for [_CYCLES_REGISTER, page] --------------
+void selectCyclePage(byte page)
+{
+  if (page >= _CYCLES_PAGES) page = _CYCLES_PAGES - 1;
+  cyclePage = page;
+
+} // selectCyclePage()
+
+
+//--------------------------------------------------------------------------
+//-- called from requestEvent(): send the selected page -------------------
+void sendCycles()
+{
+  byte crc   = 0;
+  byte first = cyclePage * _CYCLES_PER_PAGE;
+  byte block[_CYCLES_BLOCK];
+  byte *b    = block;
+
+  *b++ = cyclePage;
+  *b++ = registerStack.numberOfRelays;
+  for (byte r = first; r < (first + _CYCLES_PER_PAGE); r++)
+  {
+    uint32_t cycles    = (r < 16) ? relayCycles[r]    : 0;
+    uint32_t onSeconds = (r < 16) ? relayOnSeconds[r] : 0;
+    for (byte i = 0; i < 4; i++) *b++ = cycles    >> (8 * i);
+    for (byte i = 0; i < 4; i++) *b++ = onSeconds >> (8 * i);
+  }
+  for (byte i = 0; i < (_CYCLES_BLOCK - 1); i++) crc = crc8(crc, block[i]);
+  *b = crc;
+  Wire.write(block, _CYCLES_BLOCK);
+
+} // sendCycles()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
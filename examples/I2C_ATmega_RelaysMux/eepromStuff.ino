@@ -9,40 +9,400 @@
 ***************************************************************************
 */
 
+//--------------------------------------------------------------------------
+//-- The config is kept in _CONFIG_SLOTS slots that are used in turn, so
+//-- the EEPROM wears _CONFIG_SLOTS times slower. A slot holds:
+//--    [sequence LSB, MSB] [layout] [length] [configData ..] [CRC-8]
+//-- The valid slot with the highest sequence number is the config. A
+//-- write that is interrupted (power fail, reset) leaves a bad CRC in its
+//-- slot, so the previous config is still there.
+//-- Fields are only ever added at the end of configData (and 
+//-- _CONFIG_LAYOUT goes up by one). A slot written by an older firmware
+//-- release is migrated: the fields its layout has are taken, the rest
+//-- gets its default. A newer release gives what both know. A slot whose
+//-- length does not fit its layout is not used.
+//--------------------------------------------------------------------------
+
+#define _CONFIG_LAYOUT        2     // +1 when a field is added to configData
+#define _CONFIG_START      0x10     // 0x00 .. 0x0F is the config of firmware < v1.13
+#define _CONFIG_SLOTS         8
+#define _CONFIG_SLOTSIZE     16
+#define _CONFIG_HEADER        4     // sequence (2), layout, length
+
+#define _POWERON_SAVE_DELAY     10000 // msecs the relay state must be unchanged to be saved
+#define _POWERON_SAVE_INTERVAL 600000 // min. msecs between two saves of the relay state
+
+//--------------------------------------------------------------------------
+//-- The cycle counters (see cycleStuff) have slots of their own, also
+//-- used in turn:
+//--    [sequence LSB, MSB] [16] [relayCycles ..] [relayOnSeconds ..] [CRC-8]
+//-- A save writes one byte per loop() and only when the EEPROM is ready,
+//-- so it never keeps a message from the master waiting.
+//--------------------------------------------------------------------------
+#define _CYCLES_START     0x100
+#define _CYCLES_SLOTS         4
+#define _CYCLES_HEADER        3     // sequence (2), number of counters
+#define _CYCLES_SLOTSIZE    (_CYCLES_HEADER + (16 * 8) + 1)
+
+#define _CYCLES_SAVE_INTERVAL  900000 // min. msecs between two saves of the counters
+
+struct __attribute__((packed)) configData {
+  byte      whoAmI;
+  byte      numberOfRelays;
+  byte      powerOnMode;      // layout 2
+  uint16_t  powerOnMask;      // layout 2
+};
+
+//-- the length of configData in each layout (index is the layout) --------
+const byte configLength[_CONFIG_LAYOUT + 1] = { 0, 2, sizeof(configData) };
+
+const configData configDefaults = {
+  .whoAmI         = _I2C_DEFAULT_ADDRESS,
+  .numberOfRelays = 16,
+  .powerOnMode    = _POWERON_OFF,
+  .powerOnMask    = 0
+};
+
+configData  configStored;             // what is in the newest slot
+bool        configValid    = false;   // .. if there is one
+byte        configSlot     = _CONFIG_SLOTS - 1;
+uint16_t    configSequence = 0;
+byte        configRecord[_CONFIG_SLOTSIZE]; // the slot being saved ..
+configData  configSaving;                   // .. holds this config
+int8_t      configSavePos  = -1;            // next byte to save, -1 is "not saving"
+
+
+//--------------------------------------------------------------------------
+//-- CRC-8 (Dallas/Maxim, polynomial x^8 + x^5 + x^4 + 1) ------------------
+static byte crc8(byte crc, byte data)
+{
+  crc ^= data;
+  for (byte b = 0; b < 8; b++)
+  {
+    if (crc & 0x01) crc = (crc >> 1) ^ 0x8C;
+    else            crc = (crc >> 1);
+  }
+  return crc;
+
+} // crc8()
+
+
+//--------------------------------------------------------------------------
+//-- read one slot into (configData) data, that must hold the defaults ----
+static bool readConfigSlot(byte slot, void *data, uint16_t *sequence)
+{
+  byte  record[_CONFIG_SLOTSIZE];
+  int   addr = _CONFIG_START + (slot * _CONFIG_SLOTSIZE);
+  byte  crc  = 0;
+
+  for (byte i = 0; i < _CONFIG_SLOTSIZE; i++)
+  {
+    record[i] = EEPROM.read(addr + i);
+  }
+  byte layout = record[2];
+  byte length = record[3];
+  if (length == 0 || length > (_CONFIG_SLOTSIZE - _CONFIG_HEADER - 1)) return false;
+  if (layout == 0)                                                      return false;
+  if (layout <= _CONFIG_LAYOUT && length != configLength[layout])       return false;
+  if (layout >  _CONFIG_LAYOUT && length <  sizeof(configData))         return false;
+  for (byte i = 0; i < (_CONFIG_HEADER + length); i++)
+  {
+    crc = crc8(crc, record[i]);
+  }
+  if (crc != record[_CONFIG_HEADER + length]) return false;
+
+  *sequence = ((uint16_t)record[1] << 8) | record[0];
+  //-- take what both layouts know, an older layout keeps the defaults --
+  //-- for the fields added after it ------------------------------------
+  if (length > sizeof(configData)) length = sizeof(configData);
+  memcpy(data, &record[_CONFIG_HEADER], length);
+  return true;
+
+} // readConfigSlot()
+
+
 //--------------------------------------------------------------------------
 static void readConfig()
 {
-  registerLayout registersSaved;
-
-  eeprom_read_block(&registersSaved, 0, sizeof(registersSaved));
-  //--- the registerStack will not change in the same Major Version --
-  if (   registersSaved.majorRelease == _MAJOR_VERSION 
-      && registerStack.whoAmI > 0 && registerStack.whoAmI <= 127) {
-    registerStack = registersSaved;
-
-  //--- the Major version has changed and there is no way of -----
-  //--- knowing the registerStack has not changed, so rebuild ----
-  } else {  
-    registerStack.majorRelease    = _MAJOR_VERSION;
-    registerStack.minorRelease    = _MINOR_VERSION;
-    registerStack.whoAmI          = _I2C_DEFAULT_ADDRESS;
-    registerStack.numberOfRelays  = 16;
-
-    writeConfig();
+  configData  data;
+  uint16_t    sequence;
+
+  configValid = false;
+  for (byte slot = 0; slot < _CONFIG_SLOTS; slot++)
+  {
+    data = configDefaults;
+    if (!readConfigSlot(slot, &data, &sequence)) continue;
+    if (!configValid || (int16_t)(sequence - configSequence) > 0)
+    {
+      configStored    = data;
+      configSequence  = sequence;
+      configSlot      = slot;
+      configValid     = true;
+    }
+  }
+  data = configStored;
+  if (!configValid)
+  {
+    //-- firmware before v1.13 saved the registerStack at address 0 --
+    registerLayout registersSaved;
+    eeprom_read_block(&registersSaved, 0, sizeof(registersSaved));
+    data = configDefaults;
+    if (registersSaved.majorRelease == _MAJOR_VERSION)
+    {
+      data.whoAmI         = registersSaved.whoAmI;
+      data.numberOfRelays = registersSaved.numberOfRelays;
+    }
   }
+  //-- replace what makes no sense by its default --
+  if (data.whoAmI < 1 || data.whoAmI > 127)   
+    data.whoAmI = configDefaults.whoAmI;
+  if (data.numberOfRelays != 8 && data.numberOfRelays != 16) 
+    data.numberOfRelays = configDefaults.numberOfRelays;
+  if (data.powerOnMode > _POWERON_LAST) 
+    data.powerOnMode = configDefaults.powerOnMode;
+
+  registerStack.majorRelease    = _MAJOR_VERSION;
+  registerStack.minorRelease    = _MINOR_VERSION;
+  registerStack.whoAmI          = data.whoAmI;
+  registerStack.numberOfRelays  = data.numberOfRelays;
+  registerStack.powerOnMode     = data.powerOnMode;
+  registerStack.powerOnMask     = data.powerOnMask;
+
+  if (!configValid) writeConfig();
   
 } // readConfig()
 
 
 //--------------------------------------------------------------------------
+//-- prepare the config in the registerStack for the next slot: false if
+//-- nothing changed (don't wear the EEPROM, nor keep the master waiting)
+static bool startConfigSave()
+{
+  configData  data;
+  byte        crc = 0;
+
+  data.whoAmI         = registerStack.whoAmI;
+  data.numberOfRelays = registerStack.numberOfRelays;
+  data.powerOnMode    = registerStack.powerOnMode;
+  data.powerOnMask    = registerStack.powerOnMask;
+  if (data.powerOnMode > _POWERON_LAST) data.powerOnMode = _POWERON_OFF;
+  if (configValid && memcmp(&data, &configStored, sizeof(data)) == 0) return false;
+
+  configSlot = (configSlot + 1) % _CONFIG_SLOTS;
+  configSequence++;
+  configRecord[0] = configSequence & 0xFF;
+  configRecord[1] = configSequence >> 8;
+  configRecord[2] = _CONFIG_LAYOUT;
+  configRecord[3] = sizeof(configData);
+  memcpy(&configRecord[_CONFIG_HEADER], &data, sizeof(configData));
+  for (byte i = 0; i < (_CONFIG_HEADER + sizeof(configData)); i++)
+  {
+    crc = crc8(crc, configRecord[i]);
+  }
+  configRecord[_CONFIG_HEADER + sizeof(configData)] = crc;
+  configSaving  = data;
+  configSavePos = 0;
+  return true;
+
+} // startConfigSave()
+
+
+//--------------------------------------------------------------------------
+//-- write the next byte of the config save going on, only if the EEPROM
+//-- is ready. With now the rest is written right away
+static void continueConfigSave(bool now)
+{
+  int addr = _CONFIG_START + (configSlot * _CONFIG_SLOTSIZE);
+
+  while (configSavePos >= 0)
+  {
+    if (!now && !eeprom_is_ready()) return;
+    EEPROM.update(addr + configSavePos, configRecord[configSavePos]);
+    wdt_reset();
+    if (++configSavePos > (int8_t)(_CONFIG_HEADER + sizeof(configData)))
+    {
+      configSavePos = -1;
+      configStored  = configSaving;
+      configValid   = true;
+      byte oldSREG = SREG;
+      cli();    // receiveEvent() also changes the status register
+      if (msgTail == msgHead) registerStack.status &= ~_BV(_STATUS_BUSY);
+      SREG = oldSREG;
+    }
+    if (!now) return;
+  }
+
+} // continueConfigSave()
+
+
+//--------------------------------------------------------------------------
+//-- true while savePowerOnState() is writing a slot (the Slave is BUSY) --
+bool configSaveBusy()
+{
+  return (configSavePos >= 0);
+
+} // configSaveBusy()
+
+
+//--------------------------------------------------------------------------
+//-- write the config to the next slot, only the bytes that changed -------
 static void writeConfig()
 {
-  //eeprom_update_block(&registerStack, 0, sizeof(registerStack));
-  eeprom_write_block(&registerStack, 0, sizeof(registerStack));
+  continueConfigSave(true);     // first finish the save going on
+  if (startConfigSave()) continueConfigSave(true);
   
 } // writeConfig()
 
 
+//--------------------------------------------------------------------------
+//-- called from loop(): with _POWERON_LAST save the relay state when it
+//-- did not change for _POWERON_SAVE_DELAY msecs, at most once every
+//-- _POWERON_SAVE_INTERVAL msecs (the EEPROM wears) and not while relay
+//-- timers or the sequence are running. The slot is written one byte per
+//-- loop(), the Slave is BUSY until it is done
+void savePowerOnState()
+{
+  static uint32_t saveTimer    = 0 - (uint32_t)_POWERON_SAVE_INTERVAL; // first save: no wait
+  static uint32_t changedTimer = 0;
+  static uint16_t lastMask     = 0;
+
+  if (configSavePos >= 0)
+  {
+    continueConfigSave(false);
+    return;
+  }
+  if (registerStack.powerOnMode != _POWERON_LAST)           return;
+  if (registerStack.status & _BV(_STATUS_SCHEDULE))         return;
+
+  uint16_t relayMask = readRelayMask();
+  if (relayMask != lastMask)
+  {
+    lastMask     = relayMask;
+    changedTimer = millis();
+    return;
+  }
+  if (relayMask == registerStack.powerOnMask)               return;
+  if ((millis() - changedTimer) < _POWERON_SAVE_DELAY)      return;
+  if ((millis() - saveTimer) < _POWERON_SAVE_INTERVAL)      return;
+
+  registerStack.powerOnMask = relayMask;
+  if (!startConfigSave())                                   return;
+  byte oldSREG = SREG;
+  cli();
+  registerStack.status |= _BV(_STATUS_BUSY);
+  SREG = oldSREG;
+  saveTimer = millis();
+
+} // savePowerOnState()
+
+
+//--------------------------------------------------------------------------
+byte        cyclesSlot     = _CYCLES_SLOTS - 1;
+uint16_t    cyclesSequence = 0;
+int16_t     cyclesSavePos  = -1;      // next byte to save, -1 is "not saving"
+
+
+//--------------------------------------------------------------------------
+//-- byte pos of the cycles record (relayCycles and relayOnSeconds at the
+//-- moment their first byte is asked for) --------------------------------
+static byte cycleRecordByte(int16_t pos)
+{
+  static uint32_t field;
+
+  if (pos == 0) return (cyclesSequence & 0xFF);
+  if (pos == 1) return (cyclesSequence >> 8);
+  if (pos == 2) return 16;
+  pos -= _CYCLES_HEADER;
+  byte r = (pos / 4) % 16;
+  if ((pos % 4) == 0) field = (pos < (16 * 4)) ? relayCycles[r] : relayOnSeconds[r];
+  return (field >> (8 * (pos % 4)));
+
+} // cycleRecordByte()
+
+
+//--------------------------------------------------------------------------
+//-- load the counters from the valid slot with the highest sequence -----
+void loadCycleCounters()
+{
+  bool      found = false;
+  uint16_t  sequence;
+
+  memset(relayCycles,    0, sizeof(relayCycles));
+  memset(relayOnSeconds, 0, sizeof(relayOnSeconds));
+  memset(relayOnMillis,  0, sizeof(relayOnMillis));
+  cyclesSavePos = -1;
+
+  for (byte slot = 0; slot < _CYCLES_SLOTS; slot++)
+  {
+    int   addr = _CYCLES_START + (slot * _CYCLES_SLOTSIZE);
+    byte  crc  = 0;
+
+    for (int i = 0; i < (_CYCLES_SLOTSIZE - 1); i++)
+    {
+      crc = crc8(crc, EEPROM.read(addr + i));
+    }
+    if (crc != EEPROM.read(addr + _CYCLES_SLOTSIZE - 1)) continue;
+    if (EEPROM.read(addr + 2) != 16)                      continue;
+    sequence = ((uint16_t)EEPROM.read(addr + 1) << 8) | EEPROM.read(addr);
+    if (found && (int16_t)(sequence - cyclesSequence) <= 0) continue;
+
+    cyclesSequence = sequence;
+    cyclesSlot     = slot;
+    found          = true;
+  }
+  if (!found) return;
+
+  int addr = _CYCLES_START + (cyclesSlot * _CYCLES_SLOTSIZE) + _CYCLES_HEADER;
+  EEPROM.get(addr,          relayCycles);
+  EEPROM.get(addr + 16 * 4, relayOnSeconds);
+
+} // loadCycleCounters()
+
+
+//--------------------------------------------------------------------------
+//-- called from loop() (now is false): when the counters changed and the
+//-- last save is _CYCLES_SAVE_INTERVAL msecs ago write the next slot, one
+//-- byte at a time and only if the EEPROM is ready. With now a save that
+//-- is going on (and the one after it) is written right away
+void saveCycleCounters(bool now)
+{
+  static uint32_t saveTimer = 0;
+  static byte     crc;
+
+  do
+  {
+    if (cyclesSavePos < 0)
+    {
+      if (!cyclesChanged)                                           return;
+      if (!now && (millis() - saveTimer) < _CYCLES_SAVE_INTERVAL)   return;
+      cyclesSlot    = (cyclesSlot + 1) % _CYCLES_SLOTS;
+      cyclesSequence++;
+      cyclesSavePos = 0;
+      cyclesChanged = false;
+      crc           = 0;
+      saveTimer     = millis();
+    }
+    if (!now && !eeprom_is_ready()) return;
+
+    int   addr = _CYCLES_START + (cyclesSlot * _CYCLES_SLOTSIZE) + cyclesSavePos;
+    byte  data;
+    if (cyclesSavePos == (_CYCLES_SLOTSIZE - 1)) 
+    {
+      data = crc;
+      cyclesSavePos = -1;
+    }
+    else
+    {
+      data = cycleRecordByte(cyclesSavePos++);
+      crc  = crc8(crc, data);
+    }
+    EEPROM.update(addr, data);
+    wdt_reset();
+  } while (now);
+
+} // saveCycleCounters()
+
+
 /***************************************************************************
 *
 * Permission is hereby granted, free of charge, to any person obtaining a
@@ -0,0 +1,156 @@
+/*
+***************************************************************************
+**
+**    Program : eventStuff (part of I2C_ATmega_RelaysMux)
+**
+**    Copyright (C) 2020 Willem Aandewiel
+**
+**    TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+//--------------------------------------------------------------------------
+//-- Every relay change (whoever did it: a command, a timer, the sequence)
+//-- is logged with a timestamp in a small ring buffer. As long as there
+//-- are events in the log the "changed" line (D12, open-drain) is pulled
+//-- LOW, so a master only has to read the log when something happened.
+//--
+//-- The master reads the log from pseudo register 0xF3. It gets one
+//-- block of _EVENT_BLOCK bytes:
+//--    [header] [relay, state, tickLSB, tickMSB] x _EVENTS_PER_READ
+//--    header bit 0..3 : number of events in this block
+//--    header bit 6    : there are more events in the log
+//--    header bit 7    : events were lost (log overflow), read all relays
+//-- tick is millis() (wraps every 65 seconds).
+//--------------------------------------------------------------------------
+
+#define _EVENT_LOG_SIZE     16    // must be a power of 2
+#define _EVENTS_PER_READ     7
+#define _EVENT_BLOCK        (1 + (_EVENTS_PER_READ * 4))
+#define _CHANGED_BIT         4    // PB4 = D12
+
+struct relayEvent {
+  byte      relay;          // 1 .. 16
+  byte      state;          // 1 is 'closed'
+  uint16_t  tick;           // millis() at the time of the change
+};
+
+relayEvent        eventLog[_EVENT_LOG_SIZE];
+volatile byte     eventHead = 0;    // only changed by logRelayChanges()
+volatile byte     eventTail = 0;    // changed by sendEvents() (and on overflow)
+bool              eventsLost = false;
+uint16_t          loggedMask;
+
+
+//--------------------------------------------------------------------------
+//-- pull the "changed" line LOW (open-drain: never drive it HIGH) ---------
+void assertChangedLine(bool changed)
+{
+  PORTB &= ~_BV(_CHANGED_BIT);
+  if (changed)  DDRB |=  _BV(_CHANGED_BIT);
+  else          DDRB &= ~_BV(_CHANGED_BIT);
+
+} // assertChangedLine()
+
+
+//--------------------------------------------------------------------------
+void startEventLog()
+{
+  eventHead  = 0;
+  eventTail  = 0;
+  eventsLost = false;
+  loggedMask = readRelayMask();
+  assertChangedLine(false);
+
+} // startEventLog()
+
+
+//--------------------------------------------------------------------------
+//-- called from loop(): log what changed since the last call --------------
+void logRelayChanges()
+{
+  uint16_t relayMask = readRelayMask();
+  uint16_t changed   = relayMask ^ loggedMask;
+
+  if (!changed) return;
+  loggedMask = relayMask;
+
+  for (byte r = 1; r <= 16; r++)
+  {
+    if (!(changed & ((uint16_t)1 << (r - 1)))) continue;
+
+    byte oldSREG = SREG;
+    cli();    // sendEvents() runs in the TWI interrupt
+    byte next = (eventHead + 1) & (_EVENT_LOG_SIZE - 1);
+    if (next == eventTail)  // full: drop the oldest
+    {
+      eventTail  = (eventTail + 1) & (_EVENT_LOG_SIZE - 1);
+      eventsLost = true;
+    }
+    eventLog[eventHead].relay = r;
+    eventLog[eventHead].state = (relayMask >> (r - 1)) & 1;
+    eventLog[eventHead].tick  = (uint16_t)millis();
+    eventHead = next;
+    registerStack.status |= _BV(_STATUS_EVENTS);
+    assertChangedLine(true);
+    SREG = oldSREG;
+  }
+
+} // logRelayChanges()
+
+
+//--------------------------------------------------------------------------
+//-- called from requestEvent(): send (and remove) the oldest events ------
+void sendEvents()
+{
+  byte count  = 0;
+  byte header;
+
+  header = (eventsLost ? _BV(7) : 0);
+  for (byte e = eventTail; e != eventHead && count < _EVENTS_PER_READ; e = (e + 1) & (_EVENT_LOG_SIZE - 1))
+  {
+    count++;
+  }
+  if (((eventTail + count) & (_EVENT_LOG_SIZE - 1)) != eventHead) header |= _BV(6);
+  Wire.write(header | count);
+
+  for (byte e = 0; e < _EVENTS_PER_READ; e++)
+  {
+    relayEvent *ev = &eventLog[(eventTail + e) & (_EVENT_LOG_SIZE - 1)];
+    Wire.write(e < count ? ev->relay : 0);
+    Wire.write(e < count ? ev->state : 0);
+    Wire.write(e < count ? (ev->tick & 0xFF) : 0);
+    Wire.write(e < count ? (ev->tick >> 8)   : 0);
+  }
+  eventTail  = (eventTail + count) & (_EVENT_LOG_SIZE - 1);
+  eventsLost = false;
+  if (eventTail == eventHead)
+  {
+    registerStack.status &= ~_BV(_STATUS_EVENTS);
+    assertChangedLine(false);
+  }
+
+} // sendEvents()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
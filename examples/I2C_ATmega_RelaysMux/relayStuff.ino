@@ -0,0 +1,163 @@
+/*
+***************************************************************************
+**
+**    Program : relayStuff (part of I2C_ATmega_RelaysMux)
+**
+**    Copyright (C) 2020 Willem Aandewiel
+**
+**    TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+//--------------------------------------------------------------------------
+//-- the pin maps and port access are in boardProfile.h, these pick -------
+//-- the 8 or the 16 relay board (registerStack.numberOfRelays) -----------
+//--------------------------------------------------------------------------
+
+
+volatile uint16_t stagedMask;
+volatile bool     maskStaged  = false;
+volatile uint16_t latchedMask;
+volatile bool     maskLatched = false;   // countLatchedRelays() still to do
+
+
+//--------------------------------------------------------------------------
+//-- set all relays in one go: bit 0 of relayMask is relay 1 ---------------
+void applyRelayMask(uint16_t relayMask)
+{
+  if (registerStack.numberOfRelays == 8)
+  {
+    writeBoard<relayBoard<8>>(relayMask);
+    relayMask &= 0x00FF;
+  }
+  else  writeBoard<relayBoard<16>>(relayMask);
+  countRelayChanges(relayMask);
+
+} // applyRelayMask()
+
+
+//--------------------------------------------------------------------------
+//-- switch one relay (1 .. numberOfRelays), HIGH is 'closed' --------------
+void writeRelay(byte relayNr, byte HIGH_LOW)
+{
+  bool valid;
+
+  if (registerStack.numberOfRelays == 8)
+        valid = relayPins<relayBoard<8>>::write(relayNr, HIGH_LOW);
+  else  valid = relayPins<relayBoard<16>>::write(relayNr, HIGH_LOW);
+  if (!valid) return;
+
+  uint16_t relayBit = (uint16_t)1 << (relayNr - 1);
+  countRelayChanges(HIGH_LOW ? (cycledMask | relayBit) : (cycledMask & ~relayBit));
+
+} // writeRelay()
+
+
+//--------------------------------------------------------------------------
+//-- true if relayNr is 'closed' -------------------------------------------
+bool readRelay(byte relayNr)
+{
+  if (relayNr < 1 || relayNr > registerStack.numberOfRelays) return false;
+  return (readRelayMask() & ((uint16_t)1 << (relayNr - 1)));
+
+} // readRelay()
+
+
+//--------------------------------------------------------------------------
+//-- the Arduino pin of relayNr, -1 if there is no such relay --------------
+int8_t relayPin(byte relayNr)
+{
+  if (relayNr < 1 || relayNr > registerStack.numberOfRelays) return -1;
+  if (registerStack.numberOfRelays == 8)
+        return relayBoard<8>::pin[relayNr];
+  else  return relayBoard<16>::pin[relayNr];
+
+} // relayPin()
+
+
+//--------------------------------------------------------------------------
+//-- remember relayMask until the next latch -------------------------------
+void stageRelayMask(uint16_t relayMask)
+{
+  byte oldSREG = SREG;
+  cli();    // latchRelayMask() runs in the TWI interrupt
+  stagedMask  = relayMask;
+  maskStaged  = true;
+  SREG = oldSREG;
+
+} // stageRelayMask()
+
+
+//--------------------------------------------------------------------------
+//-- apply the staged relayMask (if any). This runs in the TWI interrupt ---
+//-- so a General Call switches all boards at once; loop() does the -------
+//-- cycle counting in countLatchedRelays() --------------------------------
+void latchRelayMask()
+{
+  if (!maskStaged) return;
+  stopSchedule();               // a latched mask overrules all timers
+  if (registerStack.numberOfRelays == 8)
+  {
+    writeBoard<relayBoard<8>>(stagedMask);
+    latchedMask = stagedMask & 0x00FF;
+  }
+  else 
+  {
+    writeBoard<relayBoard<16>>(stagedMask);
+    latchedMask = stagedMask;
+  }
+  maskStaged  = false;
+  maskLatched = true;
+
+} // latchRelayMask()
+
+
+//--------------------------------------------------------------------------
+//-- called from loop(): count the relays the last latch closed ------------
+void countLatchedRelays()
+{
+  if (!maskLatched) return;
+
+  byte oldSREG = SREG;
+  cli();
+  uint16_t relayMask = latchedMask;
+  maskLatched = false;
+  SREG = oldSREG;
+  countRelayChanges(relayMask);
+
+} // countLatchedRelays()
+
+
+//--------------------------------------------------------------------------
+//-- read all relays in one go: bit 0 is relay 1 ---------------------------
+uint16_t readRelayMask()
+{
+  if (registerStack.numberOfRelays == 8)
+        return readBoard<relayBoard<8>>();
+  else  return readBoard<relayBoard<16>>();
+
+} // readRelayMask()
+
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
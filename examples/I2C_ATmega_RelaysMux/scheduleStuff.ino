@@ -0,0 +1,193 @@
+/*
+***************************************************************************
+**
+**    Program : scheduleStuff (part of I2C_ATmega_RelaysMux)
+**
+**    Copyright (C) 2020 Willem Aandewiel
+**
+**    TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+//--------------------------------------------------------------------------
+//-- Timed switching, done here so it does not depend on the master (or ---
+//-- the bus). Everything runs from millis() in loop():
+//--   - a timer per relay: switch the relay to 'state' after 'duration'
+//--     (a pulse is a write now plus a timer to switch it back)
+//--   - one sequence table: relayMasks applied one after the other
+//-- A direct write to a relay (digitalWrite, writeAll, latch) cancels
+//-- its timer and stops the sequence.
+//--------------------------------------------------------------------------
+
+#define _MAX_SEQ_STEPS   16
+
+struct relayTimer {
+  bool      active;
+  byte      state;          // HIGH_LOW when the timer expires
+  uint32_t  start;
+  uint32_t  duration;       // msecs
+};
+
+relayTimer  timers[17];     // relay 1 .. 16
+
+uint16_t    seqSteps[_MAX_SEQ_STEPS];
+byte        seqLength     = 0;
+byte        seqStep;
+byte        seqPassesLeft;  // 0 is forever
+uint16_t    seqInterval;
+uint32_t    seqTimer;
+bool        seqRunning    = false;
+
+
+//--------------------------------------------------------------------------
+//-- keep the SCHEDULE bit in the status register up-to-date ---------------
+void updateScheduleStatus()
+{
+  bool scheduled = seqRunning;
+  for (byte r = 1; r <= 16; r++)
+  {
+    if (timers[r].active) scheduled = true;
+  }
+  byte oldSREG = SREG;
+  cli();    // receiveEvent() also changes the status register
+  if (scheduled)  registerStack.status |=  _BV(_STATUS_SCHEDULE);
+  else            registerStack.status &= ~_BV(_STATUS_SCHEDULE);
+  SREG = oldSREG;
+
+} // updateScheduleStatus()
+
+
+//--------------------------------------------------------------------------
+void delayRelay(byte relayNr, byte HIGH_LOW, uint32_t msecs)
+{
+  if (relayNr < 1 || relayNr > registerStack.numberOfRelays) return;
+  timers[relayNr].state    = HIGH_LOW;
+  timers[relayNr].start    = millis();
+  timers[relayNr].duration = msecs;
+  timers[relayNr].active   = true;
+  updateScheduleStatus();
+
+} // delayRelay()
+
+
+//--------------------------------------------------------------------------
+void pulseRelay(byte relayNr, byte HIGH_LOW, uint32_t msecs)
+{
+  writeRelay(relayNr, HIGH_LOW);
+  delayRelay(relayNr, !HIGH_LOW, msecs);
+
+} // pulseRelay()
+
+
+//--------------------------------------------------------------------------
+void cancelTimer(byte relayNr)
+{
+  if (relayNr < 1 || relayNr > 16) return;
+  timers[relayNr].active = false;
+  seqRunning = false;
+  updateScheduleStatus();
+
+} // cancelTimer()
+
+
+//--------------------------------------------------------------------------
+void stopSchedule()
+{
+  for (byte r = 1; r <= 16; r++)
+  {
+    timers[r].active = false;
+  }
+  seqRunning = false;
+  updateScheduleStatus();
+
+} // stopSchedule()
+
+
+//--------------------------------------------------------------------------
+//-- store 'count' relayMasks (LSB, MSB) from the message at 'offset' ------
+void loadSequence(byte offset, byte count)
+{
+  for (byte s = offset; s < (offset + count) && s < _MAX_SEQ_STEPS; s++)
+  {
+    byte LSB = readMessage();
+    byte MSB = readMessage();
+    seqSteps[s] = ((uint16_t)MSB << 8) | LSB;
+  }
+
+} // loadSequence()
+
+
+//--------------------------------------------------------------------------
+void startSequence(uint16_t interval, byte passes, byte length)
+{
+  if (length == 0 || length > _MAX_SEQ_STEPS || interval == 0) return;
+  seqLength     = length;
+  seqInterval   = interval;
+  seqPassesLeft = passes;
+  seqStep       = 0;
+  seqTimer      = millis();
+  seqRunning    = true;
+  applyRelayMask(seqSteps[0]);
+  updateScheduleStatus();
+
+} // startSequence()
+
+
+//--------------------------------------------------------------------------
+//-- called from loop() ----------------------------------------------------
+void handleSchedule()
+{
+  bool changed = false;
+
+  for (byte r = 1; r <= 16; r++)
+  {
+    if (timers[r].active && (millis() - timers[r].start) >= timers[r].duration)
+    {
+      writeRelay(r, timers[r].state);
+      timers[r].active = false;
+      changed = true;
+    }
+  }
+
+  if (seqRunning && (millis() - seqTimer) >= seqInterval)
+  {
+    seqTimer += seqInterval;  // no drift
+    if (++seqStep >= seqLength)
+    {
+      seqStep = 0;
+      if (seqPassesLeft > 0 && --seqPassesLeft == 0) 
+      {
+        seqRunning = false;   // keep the last step
+        changed    = true;
+      }
+    }
+    if (seqRunning) applyRelayMask(seqSteps[seqStep]);
+  }
+
+  if (changed) updateScheduleStatus();
+
+} // handleSchedule()
+
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
@@ -22,6 +22,7 @@
 **     board        SCL o---------o GPIO-05    ESP8266
 **     with         SDA o---------o GPIO-04
 **     I2C_Mux      Vin o---------o 3v3
+**                  D12 o---------o GPIO-14    (optional "changed" line)
 **   -------------------/         |
 **                                +---------------------
 **
@@ -37,7 +38,8 @@
 **  time you (re)boot the I2C_Multiplexer.
 **  
 **  You can connect to the ESP8266 by telnet (PuTTY) on port 23 or
-**  by entering the IP address in your browser.
+**  by entering the IP address in your browser. The page follows the
+**  relays as they change (Server-Sent Events, see sseStuff).
 */
 
 
@@ -47,8 +49,11 @@
 
 #define LOOP_INTERVAL        1000
 #define INACTIVE_TIME      300000
+#define RELAY_VERIFY_INTERVAL  5000
+#define CHANGED_PIN            14    // GPIO-14 (D5) <- D12 of the I2C_RelaysMux
 
 #include <I2C_RelaysMux.h>
+#include <I2C_RelaysMuxCommand.h>
 
 #include <TelnetStream.h>       // https://github.com/jandrassy/TelnetStream/commit/1294a9ee5cc9b1f7e51005091e351d60c8cddecf
 
@@ -78,8 +83,11 @@ int           numRelays;
 uint32_t      loopTimer, inactiveTimer;
 bool          loopTestOn = false;
 uint16_t      loopRegister = 0;
-String        command;
-byte          commandBy = 1;  // 1= Serial, 2=TelnetStream
+uint16_t      relayStates  = 0;     // kept up-to-date from the event log
+uint32_t      eventTimer;
+I2CMUXCommand serialCommand;        // one parser per input, see setupCommands()
+I2CMUXCommand telnetCommand;
+I2CMUXCommand restCommand;          // POST /api/command
 
 
 
@@ -137,27 +145,58 @@ byte findSlaveAddress(Stream *sOut, byte startAddress)
       return address;
     }
     yield();
-    delay(25);
   }
   return 0xFF;
 
 } // findSlaveAddress()
 
 
+//===========================================================================================
+void onReadAll(uint8_t handle, bool success, uint16_t relayState)
+{
+  if (success) loopRegister = relayState;
+  
+} // onReadAll()
+
+
 //===========================================================================================
 void setLoopRegister()
 {
-  loopRegister = 0;  
-  for (int p=1; p<=numRelays; p++) {
-    if (relay.digitalRead(p) == 1)
-    {
-      loopRegister |= (1<< (p-1));
-    }
-  }
+  //-- only ask for a new snapshot when nothing else is going on --
+  if (relay.pending() == 0) relay.queueReadAll(onReadAll);
   
 } // setLoopRegister()
 
 
+//===========================================================================================
+void readRelayEvents()
+{
+  I2CMUX_EventBlock events;
+  bool              lost = false;
+
+  //-- the Slave pulls CHANGED_PIN LOW when it has logged relay changes. Without
+  //-- that line connected we look every RELAY_VERIFY_INTERVAL msecs
+  if (   digitalRead(CHANGED_PIN) == HIGH 
+      && (millis() - eventTimer) < RELAY_VERIFY_INTERVAL) return;
+  eventTimer = millis();
+
+  do {
+    if (!relay.readEvents(events)) {      // bus error, or Slave firmware older than v1.12
+      relayStates = relay.readAll();
+      return;
+    }
+    for (uint8_t e = 0; e < events.count; e++) {
+      if (events.event[e].state)  relayStates |=  (1 << (events.event[e].relay - 1));
+      else                        relayStates &= ~(1 << (events.event[e].relay - 1));
+    }
+    if (events.lost) lost = true;
+  } while (events.more);
+  
+  if (lost) relayStates = relay.readAll();
+  
+} // readRelayEvents()
+
+
 //===========================================================================================
 void displayPinState(Stream *sOut)
 {
@@ -167,9 +206,10 @@ void displayPinState(Stream *sOut)
   }
   sOut->println();
 
+  uint16_t relayState = relay.readAll();
   sOut->print("State: ");
   for (int p=numRelays; p>=1; p--) {
-    int pState = relay.digitalRead(p);
+    int pState = (relayState >> (p-1)) & 1;
     if (pState == HIGH) sOut->print("H");
     else                sOut->print("L");
   }
@@ -202,16 +242,11 @@ void loopRelays()
     if (loopRegister == 0) loopRegister = 7;
     loopRegister = rightRotate(loopRegister, 1, numRelays);
 
-    for (int i=0; i<numRelays; i++)
-    {
-      if (loopRegister & (1<<i)) relay.digitalWrite((i+1), HIGH);
-      else                       relay.digitalWrite((i+1), LOW);
-    }
     for (int i=(numRelays+1); i<=16; i++)
     {
       loopRegister &= ~(1<< (i-1));
-      relay.digitalWrite((i+1), LOW);
     }
+    relay.queueWriteAll(loopRegister);
     relay.showRegister(sizeof(loopRegister), &loopRegister, &Serial);
     relay.showRegister(sizeof(loopRegister), &loopRegister, &TelnetStream);
 
@@ -221,25 +256,47 @@ void loopRelays()
 //===========================================================================================
 bool Mux_Status(Stream *sOut)
 {
-  whoAmI       = relay.getWhoAmI();
+  I2CMUX_Info info;
+
+  //-- one transaction for all board info (Slave firmware v1.9+) --
+  if (!relay.readInfo(info)) {
+    sOut->println("readInfo() failed .. (Slave firmware older than v1.9?)");
+    return false;
+  }
+  whoAmI       = info.whoAmI;
   sOut->print("whoAmI[0x"); sOut->print(whoAmI, HEX); sOut->println("]");
   if (whoAmI != I2C_MUX_ADDRESS && whoAmI != 0x24) {
     sOut->print("whoAmI returned [0x"); sOut->print(whoAmI, HEX); sOut->println("]");
     return false;
   }
   displayPinState(sOut);
-  //Serial.println("getMajorRelease() ..");
-  majorRelease = relay.getMajorRelease();
-  //Serial.println("getMinorRelease() ..");
-  minorRelease = relay.getMinorRelease();
+  majorRelease = info.majorRelease;
+  minorRelease = info.minorRelease;
     
   sOut->print("\nSlave say's he's [0x");sOut->print(whoAmI, HEX); 
   sOut->print("] Release[");            sOut->print(majorRelease);
   sOut->print(".");                     sOut->print(minorRelease);
   sOut->println("]");
-  numRelays = relay.getNumRelays();
+  numRelays = info.numberOfRelays;
+  setCommandRelays(numRelays);
   sOut->print("Board has [");  sOut->print(numRelays);
-  sOut->println("] relays\r\n"); 
+  sOut->println("] relays"); 
+  byte bootReason = relay.getBootReason();
+  sOut->print("Last reset by [");
+  if      (bootReason & I2CMUX_BOOT_WATCHDOG) sOut->print("watchdog");
+  else if (bootReason & I2CMUX_BOOT_BROWNOUT) sOut->print("brown-out");
+  else if (bootReason & I2CMUX_BOOT_EXTERNAL) sOut->print("reset pin");
+  else if (bootReason & I2CMUX_BOOT_POWERON)  sOut->print("power-on");
+  else                                        sOut->print("unknown");
+  sOut->println("]");
+  I2CMUX_Errors errors;
+  relay.getErrors(errors);
+  sOut->print("Bus errors [");  sOut->print(errors.nacks + errors.busErrors + errors.shortReads);
+  sOut->print("] retries [");   sOut->print(errors.retries);
+  sOut->print("] failed [");    sOut->print(errors.failures);
+  sOut->print("] Slave restarts ["); sOut->print(errors.restarts);
+  sOut->println("]\r\n");
+  return true;
 
 } // Mux_Status()
 
@@ -256,8 +313,11 @@ bool ScanI2Cbus(Stream *sOut, byte startAddress)
       sOut->println(F("]"));
       sOut->flush();
       if (relay.begin(Wire, actI2Caddress)) {
-        majorRelease = relay.getMajorRelease();
-        minorRelease = relay.getMinorRelease();
+        I2CMUX_Info info;
+        if (relay.readInfo(info)) {
+          majorRelease = info.majorRelease;
+          minorRelease = info.minorRelease;
+        }
         sOut->print(F(". connected with slave @[0x"));
         sOut->print(actI2Caddress, HEX);
         sOut->print(F("] Release[v"));
@@ -266,7 +326,11 @@ bool ScanI2Cbus(Stream *sOut, byte startAddress)
         sOut->print(minorRelease);
         sOut->println(F("]"));
         sOut->flush();
-        actI2Caddress = relay.getWhoAmI();
+        //-- Slave firmware v1.10+ keeps up with Fast mode (400kHz) --
+        if (relay.setBusClock(400000L)) sOut->println(F(". bus clock set to 400kHz"));
+        //-- serve relay states from the library, re-check every 5 seconds --
+        relay.enableCache(RELAY_VERIFY_INTERVAL, true);
+        relayStates = relay.readAll();
         I2C_MuxConnected = true;
         return true;
         
@@ -290,8 +354,13 @@ void help(Stream *sOut)
   sOut->println(F("  Commands are:"));
   sOut->println(F("    n=1;         -> sets relay n to 'closed'"));
   sOut->println(F("    n=0;         -> sets relay n to 'open'"));
+  sOut->println(F("    1-4,7=1;     -> sets relays 1 to 4 and 7 to 'closed'"));
   sOut->println(F("    all=1;       -> sets all relay's to 'closed'"));
   sOut->println(F("    all=0;       -> sets all relay's to 'open'"));
+  sOut->println(F("    mask=0x0F0F; -> sets all relay's (bit 0 is relay 1)"));
+  sOut->println(F("    @night;      -> sets the relay's of scene 'night'"));
+  sOut->println(F("    1-8=0 3=1;   -> items are combined in one write"));
+  sOut->println(F("                       (plus a read unless the cache is on)"));
   sOut->println(F("    address48;   -> sets I2C address to 0x48"));
   sOut->println(F("    address24;   -> sets I2C address to 0x24"));
   sOut->println(F("    board8;      -> set's board to 8 relay's"));
@@ -299,9 +368,14 @@ void help(Stream *sOut)
   sOut->println(F("    status;      -> I2C mux status"));
   sOut->println(F("    pinstate;    -> List's state of all relay's"));
   sOut->println(F("    looptest;    -> Chasing Relays test"));
+  sOut->println(F("    seqtest;     -> Chasing Relays test run by the Slave"));
+  sOut->println(F("    pulse=ms;    -> closes relay 1 for ms (default 2000) milliseconds"));
+  sOut->println(F("    stop;        -> stops all timers on the Slave"));
   sOut->println(F("    muxtest;     -> On board test"));
   sOut->println(F("    whoami;      -> shows I2C address Slave MUX"));
   sOut->println(F("    writeconfig; -> write config to eeprom"));
+  sOut->println(F("    powerlast;   -> after a reset the Mux restores the last relay state"));
+  sOut->println(F("    poweroff;    -> after a reset all relays are 'open'"));
   sOut->println(F("    reboot;      -> reboot I2C Mux"));
   sOut->println(F("  * reScan;      -> re-scan I2C devices"));
   sOut->println(F("    help;        -> shows all commands"));
@@ -310,138 +384,92 @@ void help(Stream *sOut)
 
 
 //===========================================================================================
-void setAllToZero()
+//-- all command parsers switch the same relays and know the same scenes --
+void setupCommands()
 {
-  relay.setNumRelays(16);
-  for (int i=1; i<=16; i++) relay.digitalWrite(i, LOW); 
-  relay.setNumRelays(numRelays);
-  
-} // setAllToZero()
+  I2CMUXCommand *parser[] = { &serialCommand, &telnetCommand, &restCommand };
+
+  for (int p = 0; p < 3; p++)
+  {
+    parser[p]->setNumRelays(numRelays);
+    //-- "@night;" closes relay 1 and opens 2 to 8, "@day;" the other way around --
+    parser[p]->addScene("night", 0x0001, 0x00FE);
+    parser[p]->addScene("day",   0x00FE, 0x0001);
+  }
+
+} // setupCommands()
+
+
+//===========================================================================================
+void setCommandRelays(int newNumRelays)
+{
+  serialCommand.setNumRelays(newNumRelays);
+  telnetCommand.setNumRelays(newNumRelays);
+  restCommand.setNumRelays(newNumRelays);
+
+} // setCommandRelays()
+
 
 //===========================================================================================
-void executeCommand(String command)
+void executeCommand(const I2CMUX_Command &cmd, I2CMUXCommand &parser, Stream *sOut)
 {
   inactiveTimer = millis();
   loopTestOn    = false;
 
-  if (command == "0=1")       relay.digitalWrite(0,  HIGH); 
-  if (command == "0=0")       relay.digitalWrite(0,  LOW); 
-  if (command == "1=1")       relay.digitalWrite(1,  HIGH); 
-  if (command == "1=0")       relay.digitalWrite(1,  LOW); 
-  if (command == "2=1")       relay.digitalWrite(2,  HIGH); 
-  if (command == "2=0")       relay.digitalWrite(2,  LOW); 
-  if (command == "3=1")       relay.digitalWrite(3,  HIGH); 
-  if (command == "3=0")       relay.digitalWrite(3,  LOW); 
-  if (command == "4=1")       relay.digitalWrite(4,  HIGH); 
-  if (command == "4=0")       relay.digitalWrite(4,  LOW); 
-  if (command == "5=1")       relay.digitalWrite(5,  HIGH); 
-  if (command == "5=0")       relay.digitalWrite(5,  LOW); 
-  if (command == "6=1")       relay.digitalWrite(6,  HIGH); 
-  if (command == "6=0")       relay.digitalWrite(6,  LOW); 
-  if (command == "7=1")       relay.digitalWrite(7,  HIGH); 
-  if (command == "7=0")       relay.digitalWrite(7,  LOW); 
-  if (command == "8=1")       relay.digitalWrite(8,  HIGH); 
-  if (command == "8=0")       relay.digitalWrite(8,  LOW); 
-  if (command == "9=1")       relay.digitalWrite(9,  HIGH); 
-  if (command == "9=0")       relay.digitalWrite(9,  LOW); 
-  if (command == "10=1")      relay.digitalWrite(10, HIGH); 
-  if (command == "10=0")      relay.digitalWrite(10, LOW); 
-  if (command == "11=1")      relay.digitalWrite(11, HIGH); 
-  if (command == "11=0")      relay.digitalWrite(11, LOW); 
-  if (command == "12=1")      relay.digitalWrite(12, HIGH); 
-  if (command == "12=0")      relay.digitalWrite(12, LOW); 
-  if (command == "13=1")      relay.digitalWrite(13, HIGH); 
-  if (command == "13=0")      relay.digitalWrite(13, LOW); 
-  if (command == "14=1")      relay.digitalWrite(14, HIGH); 
-  if (command == "14=0")      relay.digitalWrite(14, LOW); 
-  if (command == "15=1")      relay.digitalWrite(15, HIGH); 
-  if (command == "15=0")      relay.digitalWrite(15, LOW); 
-  if (command == "16=1")      relay.digitalWrite(16, HIGH); 
-  if (command == "16=0")      relay.digitalWrite(16, LOW); 
-  if (command == "all=1")
+  if (cmd.type == I2CMUX_CMD_ERROR)
   {
-    for (int i=1; i<=numRelays; i++) relay.digitalWrite(i, HIGH); 
+    sOut->printf("error at position %d\r\n", cmd.errorPos + 1);
+    return;
+  }
+  if (cmd.type == I2CMUX_CMD_RELAYS)
+  {
+    if (!parser.apply(relay)) sOut->println(F("error switching relays"));
+    return;
   }
-  if (command == "all=0")       setAllToZero();
-  if (command == "address48")   {actI2Caddress = 0x48; relay.setI2Caddress(actI2Caddress); }
-  if (command == "address24")   {actI2Caddress = 0x24; relay.setI2Caddress(actI2Caddress); }
-  if (command == "board8")      {numRelays = 8;  relay.setNumRelays(numRelays); command = "all=0"; }
-  if (command == "board16")     {numRelays = 16; relay.setNumRelays(numRelays); command = "all=0"; }
-  if (command == "status")      { if (commandBy == 1) Mux_Status(&Serial);
-                                  else          Mux_Status(&TelnetStream);
-                                }
-  if (command == "pinstate")    { if (commandBy == 1) displayPinState(&Serial);
-                                  else          displayPinState(&TelnetStream);
-                                }
-  if (command == "looptest")    loopTestOn = true;
-  if (command == "muxtest")     relay.writeCommand(1<<CMD_TESTRELAYS);
-  if (command == "whoami")      { if (commandBy == 1) {
-                                    Serial.print(">>> I am 0x");
-                                    Serial.println(relay.getWhoAmI(), HEX);
-                                  }
-                                  else {
-                                    TelnetStream.print(">>> I am 0x");
-                                    TelnetStream.println(relay.getWhoAmI(), HEX);
-                                  }
-                                }
-  if (command == "readconfig")  relay.writeCommand(1<<CMD_READCONF);
-  if (command == "writeconfig") relay.writeCommand(1<<CMD_WRITECONF);
-  if (command == "reboot")      relay.writeCommand(1<<CMD_REBOOT);
-  if (command == "help")        { if (commandBy == 1) help(&Serial); else help(&TelnetStream); }
-  if (command == "rescan")      { if (commandBy == 1) ScanI2Cbus(&Serial, 1);
-                                  else          ScanI2Cbus(&TelnetStream, 1);
-                                }
+
+  if (!strcmp(cmd.word, "address48"))   {actI2Caddress = 0x48; relay.setI2Caddress(actI2Caddress); }
+  if (!strcmp(cmd.word, "address24"))   {actI2Caddress = 0x24; relay.setI2Caddress(actI2Caddress); }
+  if (!strcmp(cmd.word, "board8"))      {numRelays = 8;  relay.setNumRelays(numRelays); setCommandRelays(numRelays); }
+  if (!strcmp(cmd.word, "board16"))     {numRelays = 16; relay.setNumRelays(numRelays); setCommandRelays(numRelays); }
+  if (!strcmp(cmd.word, "status"))      Mux_Status(sOut);
+  if (!strcmp(cmd.word, "pinstate"))    displayPinState(sOut);
+  if (!strcmp(cmd.word, "looptest"))    loopTestOn = true;
+  if (!strcmp(cmd.word, "seqtest"))     { relay.loadRotation(0x0003, numRelays); relay.startSequence(250); }
+  if (!strcmp(cmd.word, "pulse"))       relay.pulse(1, HIGH, (cmd.value > 0) ? cmd.value : 2000);
+  if (!strcmp(cmd.word, "stop"))        relay.stopSchedule();
+  if (!strcmp(cmd.word, "muxtest"))     relay.writeCommand(1<<CMD_TESTRELAYS);
+  if (!strcmp(cmd.word, "whoami"))      { sOut->print(">>> I am 0x");
+                                          sOut->println(relay.getWhoAmI(), HEX);
+                                        }
+  if (!strcmp(cmd.word, "readconfig"))  relay.writeCommand(1<<CMD_READCONF);
+  if (!strcmp(cmd.word, "writeconfig")) relay.writeCommand(1<<CMD_WRITECONF);
+  if (!strcmp(cmd.word, "powerlast"))   relay.setPowerOnState(I2CMUX_POWERON_LAST);
+  if (!strcmp(cmd.word, "poweroff"))    relay.setPowerOnState(I2CMUX_POWERON_OFF);
+  if (!strcmp(cmd.word, "reboot"))      relay.writeCommand(1<<CMD_REBOOT);
+  if (!strcmp(cmd.word, "help"))        help(sOut);
+  if (!strcmp(cmd.word, "rescan"))      ScanI2Cbus(sOut, 1);
+
 } // executeCommand()
 
 
 //===========================================================================================
+//-- never waits: takes what Serial has and executes a command when it is complete --
 void readSerial()
 {
-  String command = "";
-  if (!Serial.available()) {
-    return;
-  }
-  Serial.setTimeout(500);  // ten seconds
-  command = Serial.readStringUntil(';');
-  command.toLowerCase();
-  command.trim();
-  for (int i = 0; i < command.length(); i++)
-  {
-    if (command[i] < ' ' || command[i] > '~') command[i] = 0;
-  }
-  
-  if (command.length() < 1) { help(&Serial); return; }
-
-  Serial.print("command["); Serial.print(command); Serial.println("]");
+  if (!serialCommand.poll(Serial)) return;
 
-  commandBy = 1;
-  executeCommand(command);
+  executeCommand(serialCommand.command(), serialCommand, &Serial);
   
 } // readSerial()
 
 
 //===========================================================================================
+//-- a telnet session has its own parser, so it never mixes with Serial --
 void readTelnet()
 {
-  String command = "";
-  if (!TelnetStream.available()) {
-    return;
-  }
-  TelnetStream.setTimeout(500);  // ten seconds
-  command = TelnetStream.readStringUntil(';');
-  command.toLowerCase();
-  command.trim();
-  for (int i = 0; i < command.length(); i++)
-  {
-    if (command[i] < ' ' || command[i] > '~') command[i] = 0;
-  }
-  
-  if (command.length() < 1) { help(&TelnetStream); return; }
-
-  TelnetStream.print("command["); TelnetStream.print(command); TelnetStream.println("]");
+  if (!telnetCommand.poll(TelnetStream)) return;
 
-  commandBy = 2;
-  executeCommand(command);
+  executeCommand(telnetCommand.command(), telnetCommand, &TelnetStream);
   
 } // readTelnet()
 
@@ -490,6 +518,7 @@ void setup()
   //Wire.setClock(200000L); // <-- don't make this 400000. It won't work
   Serial.println(F(".. done\r\n"));
   Serial.flush();
+  pinMode(CHANGED_PIN, INPUT_PULLUP);   // the Slave only pulls it LOW
 
   I2C_MuxConnected = false;
   while (!ScanI2Cbus(&Serial, 1))
@@ -505,6 +534,7 @@ void setup()
   inactiveTimer = millis();
 
   if (I2C_MuxConnected) Mux_Status(&Serial);
+  setupCommands();
 
   help(&Serial);
   help(&TelnetStream);
@@ -541,6 +571,9 @@ void loop()
 {
   httpServer.handleClient();
   MDNS.update();
+  relay.tick();
+  readRelayEvents();
+  pushRelayStates();
 
   if (loopTestOn)
   {
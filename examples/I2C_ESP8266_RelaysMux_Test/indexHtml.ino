@@ -46,8 +46,17 @@ static const char indexHTML[] PROGMEM =
           needBootsTrapMain = false;
             
           clearInterval(timeTimer);  
-          refreshRelayState();
-          timeTimer = setInterval(refreshRelayState, 2 * 1000); // repeat every 2s
+          if (window.EventSource)
+          {
+            //-- the ESP8266 pushes all relays once and then only the changes --
+            var events = new EventSource(APIGW+"events");
+            events.onmessage = function(e) { showRelayStates(JSON.parse(e.data)); };
+          }
+          else
+          {
+            refreshRelayState();
+            timeTimer = setInterval(refreshRelayState, 2 * 1000); // repeat every 2s
+          }
       
         } // bootsTrapMain()
   
@@ -56,51 +65,7 @@ static const char indexHTML[] PROGMEM =
         {
           fetch(APIGW+"states")
             .then(response => response.json())
-            .then(json => {
-                //console.log('parsed .., states is ['+ JSON.stringify(json)+']');
-                var data = json.states;
-                for (var i in data) 
-                {
-                  var tableRef = document.getElementById('switches').getElementsByTagName('tbody')[0];
-                  if( ( document.getElementById('row_'+data[i].relay)) == null )
-                  {
-                    var newRow  = tableRef.insertRow();
-                    newRow.setAttribute('id', 'row_'+data[i].relay);
-                    // Insert a cell in the row at index 0
-                    var newCell = newRow.insertCell(0);                  // relay
-                    var newText = document.createTextNode('');
-                    newCell.appendChild(newText);
-                    newCell     = newRow.insertCell(1);                  // state
-                    newCell.appendChild(newText);
-                  }
-                  tableCells = document.getElementById('row_'+data[i].relay).cells;
-                  tableCells[0].innerHTML = 'Relay('+data[i].relay+')';
-                  tableCells[1].setAttribute("id", "cell_"+data[i].relay);
-                  if (data[i].state == 1)
-                  {
-                    if (   tableCells[1].innerHTML != 'ON' 
-                        || tableCells[1].style.backgroundColor != 'gray')
-                    {
-                      tableCells[1].setAttribute("style", "color: white; background: red");
-                      tableCells[1].innerHTML = 'ON';
-                      tableCells[1].addEventListener("click", clickOff);                  
-                    }
-                  }
-                  else 
-                  {
-                    if (   tableCells[1].innerHTML != 'Off' 
-                        || tableCells[1].style.backgroundColor != 'gray')
-                    {
-                      tableCells[1].setAttribute("style", "background: lightgreen");
-                      tableCells[1].innerHTML = 'Off';
-                      tableCells[1].addEventListener("click", clickOn);                  
-                    }
-                  }
-                  tableCells[1].style.textAlign = "center";
-                }
-                startBar();
-                //console.log("-->done..");
-            })
+            .then(json => showRelayStates(json))
             .catch(function(error) {
               var p = document.createElement('p');
               p.appendChild(
@@ -109,6 +74,56 @@ static const char indexHTML[] PROGMEM =
             }); 
         };  // refreshRelayState()
 
+        //============================================================================  
+        function showRelayStates(json)
+        {
+          //console.log('parsed .., states is ['+ JSON.stringify(json)+']');
+          var data = json.states;
+          for (var i in data) 
+          {
+            var tableRef = document.getElementById('switches').getElementsByTagName('tbody')[0];
+            if( ( document.getElementById('row_'+data[i].relay)) == null )
+            {
+              var newRow  = tableRef.insertRow();
+              newRow.setAttribute('id', 'row_'+data[i].relay);
+              // Insert a cell in the row at index 0
+              var newCell = newRow.insertCell(0);                  // relay
+              var newText = document.createTextNode('');
+              newCell.appendChild(newText);
+              newCell     = newRow.insertCell(1);                  // state
+              newCell.appendChild(newText);
+            }
+            tableCells = document.getElementById('row_'+data[i].relay).cells;
+            tableCells[0].innerHTML = 'Relay('+data[i].relay+')';
+            tableCells[1].setAttribute("id", "cell_"+data[i].relay);
+            if (data[i].state == 1)
+            {
+              if (   tableCells[1].innerHTML != 'ON' 
+                  || tableCells[1].style.backgroundColor == 'gray')
+              {
+                tableCells[1].setAttribute("style", "color: white; background: red");
+                tableCells[1].innerHTML = 'ON';
+                tableCells[1].removeEventListener("click", clickOn);
+                tableCells[1].addEventListener("click", clickOff);                  
+              }
+            }
+            else 
+            {
+              if (   tableCells[1].innerHTML != 'Off' 
+                  || tableCells[1].style.backgroundColor == 'gray')
+              {
+                tableCells[1].setAttribute("style", "background: lightgreen");
+                tableCells[1].innerHTML = 'Off';
+                tableCells[1].removeEventListener("click", clickOff);
+                tableCells[1].addEventListener("click", clickOn);                  
+              }
+            }
+            tableCells[1].style.textAlign = "center";
+          }
+          startBar();
+          //console.log("-->done..");
+        };  // showRelayStates()
+
         //==============================================================
         function sendRelayState(nr, state) 
         {
@@ -123,6 +138,10 @@ static const char indexHTML[] PROGMEM =
 
           fetch(APIGW+"state", other_params)
             .then(function(response) {
+                  if (!response.ok) {
+                    console.log('Error['+response.status+']');
+                    refreshRelayState();  // no change will be pushed, undo the gray
+                  }
                   //console.log(response.status );    //=> number 100–599
                   //console.log(response.statusText); //=> String
                   //console.log(response.headers);    //=> Headers
@@ -131,6 +150,7 @@ static const char indexHTML[] PROGMEM =
                   //return response.text()
             }, function(error) {
               console.log('Error['+error.message+']'); //=> String
+              refreshRelayState();    // no change will be pushed, undo the gray
             });
       
         } // sendRelayState()
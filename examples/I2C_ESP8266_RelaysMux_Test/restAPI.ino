@@ -10,136 +10,350 @@
 */
 
 
+#define _API_MAX_SEGMENTS      4
+#define _API_URI_SIZE         50
+#define _API_BODY_SIZE       600      // {"states":[..]} of 16 relays fits
+#define _JSON_BUFF_SIZE     1100      // {"cycles":[..]} of 16 relays fits
+
+//-- all REST replies are built here and send in one go (no String's) --
+static char     jsonBuff[_JSON_BUFF_SIZE];
+static uint16_t jsonLen;
+
+//-- the request is parsed from here: ESP8266WebServer only has it in --
+//-- String's of its own, they are read in place and never copied to a -
+//-- new String -------------------------------------------------------
+static char     uriBuff[_API_URI_SIZE];
+static char     bodyBuff[_API_BODY_SIZE];
+
+
 //=======================================================================
 void processAPI() 
 {
-  String words[10];
-  char   URI[50];
+  char   *segment[_API_MAX_SEGMENTS];
+  bool    isWrite = (httpServer.method() == HTTP_POST || httpServer.method() == HTTP_PUT);
   
-  strncpy( URI, httpServer.uri().c_str(), sizeof(URI) );
-  //Serial.printf("From[%s] URI[%s]\r\n", httpServer.client().remoteIP().toString().c_str(), URI);
+  if (!copyRequest(httpServer.uri(), uriBuff, sizeof(uriBuff)))
+  {
+    sendApiNotFound();
+    return;
+  }
+  //Serial.printf("URI[%s]\r\n", uriBuff);
   
-  int8_t wc = splitString(URI, '/', words, 10);
+  uint8_t sc = splitPath(uriBuff, segment, _API_MAX_SEGMENTS);
   
-  if (words[1] != "api")
+  if (sc != 2 || strcmp(segment[0], "api") != 0)
   {
-    sendApiNotFound(URI);
+    sendApiNotFound();
     return;
-  } else if (   (httpServer.method() == HTTP_GET) 
-             && (words[2] == "states") )
+  } 
+  else if (httpServer.method() == HTTP_GET && strcmp(segment[1], "states") == 0)
+  {
+    sendRelayStates(relayStates);
+  }
+  else if (httpServer.method() == HTTP_GET && strcmp(segment[1], "cycles") == 0)
   {
-    sendRelayStates();
+    sendRelayCycles();
   }
-  else if (   (httpServer.method() == HTTP_POST || httpServer.method() == HTTP_PUT) 
-           && (words[2] == "state") )
+  else if (httpServer.method() == HTTP_GET && strcmp(segment[1], "events") == 0)
+  {
+    addEventClient();     // see sseStuff
+  }
+  else if (isWrite && strcmp(segment[1], "state") == 0)
   {
     setRelayState();
     inactiveTimer = millis();
     loopTestOn    = false;
   }
-  else sendApiNotFound(URI);
+  else if (isWrite && strcmp(segment[1], "states") == 0)
+  {
+    setRelayStates();
+    inactiveTimer = millis();
+    loopTestOn    = false;
+  }
+  else if (isWrite && strcmp(segment[1], "command") == 0)
+  {
+    runRelayCommand();
+    inactiveTimer = millis();
+    loopTestOn    = false;
+  }
+  else sendApiNotFound();
   
 } // processAPI()
 
 
+//=======================================================================
+// Copy the uri or the body (a reference to the String of httpServer) to
+// buff, false if it does not fit
+bool copyRequest(const String &request, char *buff, size_t buffSize)
+{
+  if (request.length() >= buffSize) return false;
+  memcpy(buff, request.c_str(), request.length() + 1);
+  return true;
+
+} // copyRequest()
+
+
+//=======================================================================
+// Split path in place ("/api/states" -> "api", "states") 
+uint8_t splitPath(char *path, char *segment[], uint8_t maxSegments)
+{
+  uint8_t count = 0;
+
+  while (*path && count < maxSegments)
+  {
+    while (*path == '/') *path++ = '\0';
+    if (*path == '\0') break;
+    segment[count++] = path;
+    while (*path && *path != '/') path++;
+  }
+  return count;
+
+} // splitPath()
+
+
 //====================================================
-void sendRelayStates()
+// states of all relays in one reply: no bus traffic, relayStates 
+// follows the event log of the Slave
+void sendRelayStates(uint16_t states)
 {
-  sendStartJsonObj("states");
+  jsonBegin();
+  jsonAppend("{\"states\":[");
   for (int i=1; i<= numRelays; i++)
   {
-    sendNestedJsonObj(i, relay.digitalRead(i));
+    jsonAppend("%s{\"relay\":%d,\"state\":%d}", (i > 1 ? ",\r\n" : "\r\n"), i, (states >> (i-1)) & 1);
   }
-  sendEndJsonObj();
+  jsonAppend("\r\n]}\r\n");
+  httpServer.sendHeader("Access-Control-Allow-Origin", "*");
+  httpServer.send(200, "application/json", jsonBuff);
   
 } // sendRelayStates()
 
 
 //====================================================
-void sendApiNotFound(const char *URI)
+// wear of all relays (Slave firmware v1.17+): how often each relay
+// closed and for how many seconds, to see which ones need replacing
+void sendRelayCycles()
+{
+  I2CMUX_CycleCounters counters;
+
+  httpServer.sendHeader("Access-Control-Allow-Origin", "*");
+  if (!relay.readCycleCounters(counters))
+  {
+    httpServer.send(503, "text/plain", "no counters\r\n");
+    return;
+  }
+  jsonBegin();
+  jsonAppend("{\"cycles\":[");
+  for (int i=1; i<= counters.numRelays && i <= 16; i++)
+  {
+    jsonAppend("%s{\"relay\":%d,\"cycles\":%lu,\"onSeconds\":%lu}", (i > 1 ? ",\r\n" : "\r\n")
+                , i, (unsigned long)counters.cycles[i-1], (unsigned long)counters.onSeconds[i-1]);
+  }
+  jsonAppend("\r\n]}\r\n");
+  httpServer.send(200, "application/json", jsonBuff);
+  
+} // sendRelayCycles()
+
+
+//====================================================
+void sendApiNotFound()
 {
   httpServer.sendHeader("Access-Control-Allow-Origin", "*");
   httpServer.send ( 404, "text/plain", "API error\r\n");
 
 } // sendApiNotFound()
 
-static char objSprtr[10] = "";
 
 //=======================================================================
-void sendStartJsonObj(const char *objName)
+void jsonBegin()
 {
-  char sBuff[50] = "";
-  objSprtr[0]    = '\0';
-
-  snprintf(sBuff, sizeof(sBuff), "{\"%s\":[\r\n", objName);
-  httpServer.sendHeader("Access-Control-Allow-Origin", "*");
-  httpServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
-  httpServer.send(200, "application/json", sBuff);
+  jsonLen     = 0;
+  jsonBuff[0] = '\0';
   
-} // sendStartJsonObj()
+} // jsonBegin()
 
 
 //=======================================================================
-void sendEndJsonObj()
+void jsonAppend(const char *fmt, ...)
 {
-  httpServer.sendContent("\r\n]}\r\n");
+  va_list args;
+
+  va_start(args, fmt);
+  int len = vsnprintf(&jsonBuff[jsonLen], sizeof(jsonBuff) - jsonLen, fmt, args);
+  va_end(args);
+  if (len < 0) return;
+  jsonLen += len;
+  if (jsonLen >= sizeof(jsonBuff))
+  {
+    jsonLen = sizeof(jsonBuff) - 1;
+    Serial.printf("jsonBuff > %u chars\r\n", (unsigned)sizeof(jsonBuff));
+  }
   
-} // sendEndJsonObj()
+} // jsonAppend()
 
 
 //=======================================================================
-void sendNestedJsonObj(uint8_t relayNr, uint8_t state)
+// Walk json without copying it: returns the text after the next 
+// "key":value pair with a number (or true/false) as value, or NULL 
+// if there is none. Nested objects and arrays are flattened
+const char *jsonNextPair(const char *json, char *key, uint8_t keySize, int32_t &value)
 {
-  char jsonBuff[200] = "";
-  
-  snprintf(jsonBuff, sizeof(jsonBuff), "%s{\"relay\": %d, \"state\": %d }"
-                                 , objSprtr, relayNr, state);
+  while (json != NULL && *json)
+  {
+    if ((json = strchr(json, '"')) == NULL) return NULL;
+    const char *keyEnd = strchr(++json, '"');
+    if (keyEnd == NULL) return NULL;
 
-  httpServer.sendContent(jsonBuff);
-  sprintf(objSprtr, ",\r\n");
+    uint8_t len = min((int)(keyEnd - json), keySize - 1);
+    memcpy(key, json, len);
+    key[len] = '\0';
+    json = keyEnd + 1;
+    while (isspace(*json)) json++;
+    if (*json != ':') continue;   // a string value, not a key
+    json++;
+    while (isspace(*json)) json++;
+    if (*json == '-' || isdigit(*json))
+    {
+      char *end;
+      value = strtol(json, &end, 10);
+      return end;
+    }
+    if (strncmp(json, "true", 4) == 0)  { value = 1; return json + 4; }
+    if (strncmp(json, "false", 5) == 0) { value = 0; return json + 5; }
+    //-- an object, array or string: its contents are next --
+  }
+  return NULL;
 
-} // sendNestedJsonObj(int, int)
+} // jsonNextPair()
 
 
 //=======================================================================
+// {"relay":<n>,"state":<0|1>}
 void setRelayState()
 {
-  String  wOut[5];
-  String  wPair[5];
-  String  jsonIn = httpServer.arg(0).c_str();
-  uint8_t relayNr, newState;
+  const char   *json = bodyBuff;
+  char          key[10];
+  int32_t       value, relayNr = 0, newState = 0;
   
-  Serial.printf("setRelayState(%s)\r\n", httpServer.arg(0).c_str());
+  httpServer.sendHeader("Access-Control-Allow-Origin", "*");
+  if (!copyRequest(httpServer.arg(0), bodyBuff, sizeof(bodyBuff)))
+  {
+    httpServer.send (413, "text/plain", "too long\r\n");
+    return;
+  }
+  Serial.printf("setRelayState(%s)\r\n", bodyBuff);
 
-  jsonIn.replace("{", "");
-  jsonIn.replace("}", "");
-  jsonIn.replace("\"", "");
-  int8_t wp = splitString(jsonIn.c_str(), ',',  wPair, 5) ;
-  for (int i=0; i<wp; i++)
+  while ((json = jsonNextPair(json, key, sizeof(key), value)) != NULL)
   {
-    int8_t wc = splitString(wPair[i].c_str(), ':',  wOut, 5) ;
-    if (wOut[0].equalsIgnoreCase("relay"))  relayNr   = wOut[1].toInt();
-    if (wOut[0].equalsIgnoreCase("state"))  newState  = wOut[1].toInt();
+    if (strcasecmp(key, "relay") == 0)  relayNr   = value;
+    if (strcasecmp(key, "state") == 0)  newState  = value;
   }
   if (relayNr >= 1 && relayNr <= numRelays)
   {
-    if (newState == 0)  relay.digitalWrite((byte)relayNr, LOW);
+    //-- the relay is switched by relay.tick() in loop() --
+    uint8_t handle;
+    if (newState == 0)  handle = relay.queueDigitalWrite((byte)relayNr, LOW);
     else 
     {
-      relay.digitalWrite((byte)relayNr, HIGH);
+      handle = relay.queueDigitalWrite((byte)relayNr, HIGH);
       loopRegister |= (1<< (relayNr-1));
     }
-    httpServer.sendHeader("Access-Control-Allow-Origin", "*");
-    httpServer.send(200, "application/json", httpServer.arg(0));
+    if (handle == 0)  httpServer.send(503, "text/plain", "busy\r\n");
+    else              httpServer.send(200, "application/json", bodyBuff);
   }
   else
   {
-    httpServer.sendHeader("Access-Control-Allow-Origin", "*");
     httpServer.send (404, "text/plain", "error\r\n");
   }
 } // setRelayState()
 
 
+//=======================================================================
+// Many relays in one request (and one bus transaction), the same 
+// format GET /api/states returns: 
+//    {"states":[{"relay":<n>,"state":<0|1>}, ..]}
+void setRelayStates()
+{
+  const char   *json = bodyBuff;
+  char          key[10];
+  int32_t       value, relayNr = -1, newState = -1;
+  uint16_t      setMask = 0, clearMask = 0;
+  
+  httpServer.sendHeader("Access-Control-Allow-Origin", "*");
+  if (!copyRequest(httpServer.arg(0), bodyBuff, sizeof(bodyBuff)))
+  {
+    httpServer.send (413, "text/plain", "too long\r\n");
+    return;
+  }
+  Serial.printf("setRelayStates(%s)\r\n", bodyBuff);
+
+  while ((json = jsonNextPair(json, key, sizeof(key), value)) != NULL)
+  {
+    if      (strcasecmp(key, "relay") == 0)  relayNr   = value;
+    else if (strcasecmp(key, "state") == 0)  newState  = value;
+    else continue;
+    if (relayNr < 0 || newState < 0) continue;   // need both
+    if (relayNr < 1 || relayNr > numRelays)
+    {
+      httpServer.send (404, "text/plain", "error\r\n");
+      return;
+    }
+    if (newState) setMask   |= (1<< (relayNr-1));
+    else          clearMask |= (1<< (relayNr-1));
+    relayNr = newState = -1;
+  }
+  if ((setMask | clearMask) == 0)
+  {
+    httpServer.send (400, "text/plain", "no relays\r\n");
+    return;
+  }
+  //-- all relays are switched at once by relay.tick() in loop(), the --
+  //-- other relays stay as they are by then (relayStates may be behind) -
+  if (relay.queueWriteMasks(setMask, clearMask) == 0)
+  {
+    httpServer.send(503, "text/plain", "busy\r\n");
+    return;
+  }
+  loopRegister |= setMask;
+  sendRelayStates((relayStates | setMask) & ~clearMask);
+
+} // setRelayStates()
+
+
+//=======================================================================
+// The console syntax as plain text, e.g. "1-4=0 7=1" or "@night": 
+// only relay commands, all of them in one bus transaction
+void runRelayCommand()
+{
+  httpServer.sendHeader("Access-Control-Allow-Origin", "*");
+  if (!copyRequest(httpServer.arg(0), bodyBuff, sizeof(bodyBuff)))
+  {
+    httpServer.send (413, "text/plain", "too long\r\n");
+    return;
+  }
+  Serial.printf("runRelayCommand(%s)\r\n", bodyBuff);
+
+  if (!restCommand.parse(bodyBuff) || restCommand.command().type != I2CMUX_CMD_RELAYS)
+  {
+    jsonBegin();
+    jsonAppend("{\"error\":%d}\r\n", restCommand.command().errorPos + 1);
+    httpServer.send(400, "application/json", jsonBuff);
+    return;
+  }
+  //-- all relays are switched at once by relay.tick() in loop(), the --
+  //-- other relays stay as they are by then (relayStates may be behind) -
+  const I2CMUX_Command &cmd = restCommand.command();
+  if (relay.queueWriteMasks(cmd.setMask, cmd.clearMask) == 0)
+  {
+    httpServer.send(503, "text/plain", "busy\r\n");
+    return;
+  }
+  loopRegister |= cmd.setMask;
+  sendRelayStates(restCommand.relayStates(relayStates));
+
+} // runRelayCommand()
+
+
 /***************************************************************************
 *
 * Permission is hereby granted, free of charge, to any person obtaining a
@@ -0,0 +1,135 @@
+/* 
+***************************************************************************  
+**  Program  : sseStuff, part of I2C_ESP8266_RelaysMux_Test
+**  Version  : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.                                                            
+***************************************************************************      
+*/
+
+//-- Server-Sent Events: a browser opens GET /api/events once and gets
+//-- the relay states pushed as they change, in the same format as 
+//-- GET /api/states:
+//--    data: {"states":[{"relay":<n>,"state":<0|1>}, ..]}
+//-- The first message has all relays, after that only the ones that
+//-- changed. All clients are fed from relayStates (kept up-to-date from
+//-- the event log of the Slave), so the bus traffic does not depend on
+//-- the number of open dashboards.
+
+#define _SSE_MAX_CLIENTS       4
+#define _SSE_KEEPALIVE     15000      // msecs, also finds clients that are gone
+
+static WiFiClient sseClients[_SSE_MAX_CLIENTS];
+static uint16_t   sseStates;          // what the clients have seen
+static uint32_t   sseKeepAliveTimer;
+
+
+//=======================================================================
+// GET /api/events: keep the connection of this request open
+void addEventClient()
+{
+  int8_t slot = -1;
+
+  for (int8_t c = 0; c < _SSE_MAX_CLIENTS; c++)
+  {
+    if (!sseClients[c].connected()) { slot = c; break; }
+  }
+  if (slot < 0)
+  {
+    httpServer.sendHeader("Access-Control-Allow-Origin", "*");
+    httpServer.send(503, "text/plain", "too many clients\r\n");
+    return;
+  }
+  pushRelayStates();                  // the others first catch up
+
+  sseClients[slot] = httpServer.client();
+  sseClients[slot].setNoDelay(true);  // no Nagle: a change goes out at once
+  sseClients[slot].print(F("HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/event-stream\r\n"
+                           "Cache-Control: no-cache\r\n"
+                           "Connection: keep-alive\r\n"
+                           "Access-Control-Allow-Origin: *\r\n\r\n"
+                           "retry: 2000\n\n"));
+  sendEventStates(sseClients[slot], 0xFFFF, sseStates);
+  Serial.printf("SSE client [%d] from [%s]\r\n", slot, sseClients[slot].remoteIP().toString().c_str());
+
+} // addEventClient()
+
+
+//=======================================================================
+// one event with the relays in relayMask, a client that can't take it
+// is dropped (its browser reconnects and gets all relays again)
+void sendEventStates(WiFiClient &client, uint16_t relayMask, uint16_t states)
+{
+  bool first = true;
+
+  jsonBegin();
+  jsonAppend("data: {\"states\":[");
+  for (int i=1; i<= numRelays; i++)
+  {
+    if (!(relayMask & (1 << (i-1)))) continue;
+    jsonAppend("%s{\"relay\":%d,\"state\":%d}", (first ? "" : ","), i, (states >> (i-1)) & 1);
+    first = false;
+  }
+  jsonAppend("]}\n\n");
+  if (client.availableForWrite() < jsonLen)
+  {
+    client.stop();
+    return;
+  }
+  client.write((const uint8_t *)jsonBuff, jsonLen);
+
+} // sendEventStates()
+
+
+//=======================================================================
+// called from loop(): push the relays that changed to all clients
+void pushRelayStates()
+{
+  uint16_t changed = relayStates ^ sseStates;
+
+  if (changed)
+  {
+    sseStates = relayStates;
+    for (int8_t c = 0; c < _SSE_MAX_CLIENTS; c++)
+    {
+      if (sseClients[c].connected()) sendEventStates(sseClients[c], changed, sseStates);
+    }
+  }
+  if ((millis() - sseKeepAliveTimer) < _SSE_KEEPALIVE) return;
+  sseKeepAliveTimer = millis();
+  for (int8_t c = 0; c < _SSE_MAX_CLIENTS; c++)
+  {
+    //-- a comment line, the browser ignores it --
+    if (sseClients[c].connected()) sseClients[c].print(F(":\n\n"));
+    else                           sseClients[c].stop();
+  }
+
+} // pushRelayStates()
+
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+****************************************************************************
+*/
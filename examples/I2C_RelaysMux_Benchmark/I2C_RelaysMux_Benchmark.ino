@@ -0,0 +1,123 @@
+/*
+***************************************************************************
+**
+**  Program     : I2C_RelaysMux_Benchmark
+*/
+#define _FW_VERSION  "v1.0 (17-10-2020)"
+/*
+**  Description : Measure relay-update throughput and latency of the
+**                I2C_RelaysMux API on a real bus
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+/*
+**  Connect the I2C_RelaysMux board like in I2C_UNO_RelaysMux_Test or
+**  I2C_ESP8266_RelaysMux_Test. After (re)boot the benchmark runs once
+**  and prints its results to the Serial Monitor (set BENCH_FORMAT to
+**  BENCH_JSON for JSON). Enter "r" to run it again.
+**
+**  bytes_per_op is only measured if the library is build with
+**  I2CMUX_ENABLE_STATS (see I2C_RelaysMux.h).
+**
+**  The same benchmark runs on the host against a simulated bus, see
+**  extras/hostSim/benchmark.cpp. Relays WILL switch, so disconnect
+**  any load first!
+*/
+
+#define I2C_MUX_ADDRESS      0x48    // the 7-bit address 
+#define BENCH_CALLS           200    // calls per test
+#define BENCH_FORMAT    BENCH_CSV    // or BENCH_JSON
+#define BENCH_PACING    I2CMUX_PACING_ADAPTIVE
+#define BENCH_CLOCK           400000L // falls back to 100kHz for firmware < v1.10
+
+#include <I2C_RelaysMux.h>
+#include "relaysMuxBench.h"
+
+I2CMUX          relay; //Create instance of the I2CMUX object
+
+#ifdef I2CMUX_ENABLE_STATS
+//------------------------------------------------------------------------
+uint32_t busBytes()
+{
+  I2CMUX_Stats stats;
+  relay.getStats(stats);
+  return (stats.bytes);
+}
+RelaysMuxBench  bench(relay, Serial, BENCH_FORMAT, busBytes);
+#else
+RelaysMuxBench  bench(relay, Serial, BENCH_FORMAT);   // bytes_per_op will be -1
+#endif
+
+
+//------------------------------------------------------------------------
+void runBenchmark()
+{
+  Serial.print(F("# I2C_RelaysMux_Benchmark "));
+  Serial.println(_FW_VERSION);
+  if (!relay.isConnected()) {
+    Serial.println(F("# No connection with RelaysMux board .. abort!"));
+    return;
+  }
+  bench.runAll(BENCH_CALLS);
+  Serial.println(F("# done"));
+
+} // runBenchmark()
+
+
+//------------------------------------------------------------------------
+void setup()
+{
+  Serial.begin(115200);
+  while(!Serial) { /* wait a bit */ }
+  Serial.println();
+
+  Wire.begin();
+  if (!relay.begin(Wire, I2C_MUX_ADDRESS)) {
+    Serial.println(F("# No connection with RelaysMux board .. abort!"));
+  }
+  relay.setPacing(BENCH_PACING);
+  if (!relay.setBusClock(BENCH_CLOCK)) {
+    Serial.println(F("# bus clock stays at 100kHz"));
+  }
+  runBenchmark();
+
+} // setup()
+
+
+//------------------------------------------------------------------------
+void loop()
+{
+  if (Serial.available()) {
+    if (Serial.read() == 'r') runBenchmark();
+  }
+
+} // loop()
+
+
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
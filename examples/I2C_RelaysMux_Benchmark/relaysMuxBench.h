@@ -0,0 +1,264 @@
+/*
+***************************************************************************
+**
+**  File    : relaysMuxBench.h (part of I2C_RelaysMux_Benchmark)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Benchmark engine. Used by the I2C_RelaysMux_Benchmark sketch (real
+**  bus) and by extras/hostSim/benchmark.cpp (simulated bus) so both 
+**  produce the same rows:
+**
+**    test, calls, ops_per_s, relays_per_s, p50_us, p99_us, max_us, bytes_per_op
+**
+**  Latencies are the duration of one complete API call (pacing 
+**  included). The last BENCH_SAMPLES calls of every test are used for
+**  the percentiles. bytes_per_op needs a bus byte counter; without one
+**  it is reported as -1.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _RELAYSMUXBENCH_H
+#define _RELAYSMUXBENCH_H
+
+#include <I2C_RelaysMux.h>
+
+#ifndef BENCH_SAMPLES
+  #if defined(__AVR__)
+    #define BENCH_SAMPLES   64
+  #else
+    #define BENCH_SAMPLES  500
+  #endif
+#endif
+
+enum { BENCH_CSV, BENCH_JSON };
+
+typedef uint32_t (*BenchByteCounter)();
+
+//--------------------------------------------------------------------------
+class RelaysMuxBench
+{
+public:
+  RelaysMuxBench(I2CMUX &relay, Print &out, uint8_t format, BenchByteCounter busBytes = NULL)
+    : _relay(relay), _out(out), _format(format), _busBytes(busBytes), _rows(0) {}
+
+  //----------------------------------------------------------------------
+  void runAll(uint16_t calls)
+  {
+    uint8_t  numRelays = _relay.getNumRelays();
+    uint16_t allMask   = (numRelays >= 16) ? 0xFFFF : ((1 << numRelays) - 1);
+
+    header(numRelays);
+
+    measure("getStatus",    calls, [&](uint16_t)   { _relay.getStatus(); return 0; });
+    measure("readInfo",     calls, [&](uint16_t)   { I2CMUX_Info info; _relay.readInfo(info); return 0; });
+    measure("pinMode",      calls, [&](uint16_t i) { _relay.pinMode((i % numRelays) + 1, OUTPUT); return 0; });
+    measure("digitalWrite", calls, [&](uint16_t i) { 
+        _relay.digitalWrite((i % numRelays) + 1, ((i / numRelays) & 1) ? LOW : HIGH); 
+        return 1; 
+      });
+    measure("digitalRead",  calls, [&](uint16_t i) { _relay.digitalRead((i % numRelays) + 1); return 0; });
+    measure("writeAll",     calls, [&](uint16_t i) { 
+        _relay.writeAll((i & 1) ? 0 : allMask); 
+        return numRelays; 
+      });
+
+    //-- time to snapshot all relays -------------------------------------
+    measure("snapshot_readAll",     calls, [&](uint16_t)   { _relay.readAll(); return 0; });
+    measure("snapshot_digitalRead", calls, [&](uint16_t)   { 
+        for (uint8_t r = 1; r <= numRelays; r++) _relay.digitalRead(r);
+        return 0;
+      });
+
+    //-- sweeps, like loopRelays() in the ESP8266 and UNO examples -------
+    sweep("sweep8",  8,  calls);
+    if (numRelays >= 16) sweep("sweep16", 16, calls);
+
+    _relay.writeAll(0);
+    footer();
+
+  } // runAll()
+
+private:
+  I2CMUX           &_relay;
+  Print            &_out;
+  uint8_t           _format;
+  BenchByteCounter  _busBytes;
+  uint8_t           _rows;
+  uint32_t          _samples[BENCH_SAMPLES];
+
+  //----------------------------------------------------------------------
+  //-- one step rotates three "on" relays one place, written with one
+  //-- writeAll() (like loopRelays()) or relay by relay with digitalWrite()
+  void sweep(const char *name, uint8_t width, uint16_t calls)
+  {
+    char      label[32];
+    uint16_t  mask    = (width >= 16) ? 0xFFFF : ((1 << width) - 1);
+    uint16_t  pattern = 7;
+
+    snprintf(label, sizeof(label), "%s_writeAll", name);
+    _relay.writeAll(0);
+    measure(label, calls, [&](uint16_t) {
+        uint16_t next = ((pattern >> 1) | (pattern << (width - 1))) & mask;
+        _relay.writeAll(next);
+        uint8_t toggled = popCount(pattern ^ next);
+        pattern = next;
+        return toggled;
+      });
+
+    snprintf(label, sizeof(label), "%s_digitalWrite", name);
+    _relay.writeAll(0);
+    pattern = 0;
+    measure(label, calls, [&](uint16_t) {
+        uint16_t next = pattern ? (((pattern >> 1) | (pattern << (width - 1))) & mask) : 7;
+        uint8_t  toggled = 0;
+        for (uint8_t r = 1; r <= width; r++) {
+          uint16_t bit = ((uint16_t)1 << (r - 1));
+          if ((pattern ^ next) & bit) {
+            _relay.digitalWrite(r, (next & bit) ? HIGH : LOW);
+            toggled++;
+          }
+        }
+        pattern = next;
+        return toggled;
+      });
+
+  } // sweep()
+
+  //----------------------------------------------------------------------
+  template <typename F>
+  void measure(const char *name, uint16_t calls, F apiCall)
+  {
+    uint32_t relays    = 0;
+    uint32_t bytes     = _busBytes ? _busBytes() : 0;
+    uint32_t startTime = micros();
+
+    if (calls == 0) calls = 1;
+    for (uint16_t i = 0; i < calls; i++) {
+      uint32_t callStart = micros();
+      relays += apiCall(i);
+      _samples[i % BENCH_SAMPLES] = micros() - callStart;
+    }
+
+    uint32_t elapsed = micros() - startTime;
+    if (_busBytes) bytes = _busBytes() - bytes;
+
+    uint16_t n = (calls < BENCH_SAMPLES) ? calls : BENCH_SAMPLES;
+    sortSamples(n);
+
+    row(name, calls
+        , (elapsed ? (float)calls  * 1000000.0 / elapsed : 0.0)
+        , (elapsed ? (float)relays * 1000000.0 / elapsed : 0.0)
+        , _samples[(n - 1) / 2]
+        , _samples[((uint32_t)(n - 1) * 99) / 100]
+        , _samples[n - 1]
+        , (_busBytes ? (float)bytes / calls : -1.0));
+
+  } // measure()
+
+  //----------------------------------------------------------------------
+  void sortSamples(uint16_t n)
+  {
+    for (uint16_t i = 1; i < n; i++) {
+      uint32_t s = _samples[i];
+      uint16_t j = i;
+      while (j > 0 && _samples[j - 1] > s) {
+        _samples[j] = _samples[j - 1];
+        j--;
+      }
+      _samples[j] = s;
+    }
+
+  } // sortSamples()
+
+  //----------------------------------------------------------------------
+  static uint8_t popCount(uint16_t v)
+  {
+    uint8_t c = 0;
+    for ( ; v; v &= (v - 1)) c++;
+    return c;
+  }
+
+  //----------------------------------------------------------------------
+  void header(uint8_t numRelays)
+  {
+    _rows = 0;
+    if (_format == BENCH_JSON) {
+      _out.print("{\"board\":\"0x");      _out.print(_relay.getWhoAmI(), HEX);
+      _out.print("\",\"release\":\"");    _out.print(_relay.getMajorRelease());
+      _out.print(".");                    _out.print(_relay.getMinorRelease());
+      _out.print("\",\"relays\":");       _out.print(numRelays);
+      _out.print(",\"samples\":");        _out.print(BENCH_SAMPLES);
+      _out.println(",\"results\":[");
+    } else {
+      _out.println("test,calls,ops_per_s,relays_per_s,p50_us,p99_us,max_us,bytes_per_op");
+    }
+
+  } // header()
+
+  //----------------------------------------------------------------------
+  void row(const char *name, uint16_t calls, float opsPerSec, float relaysPerSec
+          , uint32_t p50, uint32_t p99, uint32_t maxUs, float bytesPerOp)
+  {
+    if (_format == BENCH_JSON) {
+      if (_rows++ > 0) _out.println(",");
+      _out.print("  {\"test\":\"");         _out.print(name);
+      _out.print("\",\"calls\":");          _out.print(calls);
+      _out.print(",\"ops_per_s\":");        _out.print(opsPerSec, 1);
+      _out.print(",\"relays_per_s\":");     _out.print(relaysPerSec, 1);
+      _out.print(",\"p50_us\":");           _out.print(p50);
+      _out.print(",\"p99_us\":");           _out.print(p99);
+      _out.print(",\"max_us\":");           _out.print(maxUs);
+      _out.print(",\"bytes_per_op\":");     _out.print(bytesPerOp, 2);
+      _out.print("}");
+    } else {
+      _out.print(name);               _out.print(",");
+      _out.print(calls);              _out.print(",");
+      _out.print(opsPerSec, 1);       _out.print(",");
+      _out.print(relaysPerSec, 1);    _out.print(",");
+      _out.print(p50);                _out.print(",");
+      _out.print(p99);                _out.print(",");
+      _out.print(maxUs);              _out.print(",");
+      _out.println(bytesPerOp, 2);
+    }
+
+  } // row()
+
+  //----------------------------------------------------------------------
+  void footer()
+  {
+    if (_format == BENCH_JSON) {
+      _out.println("\n]}");
+    }
+
+  } // footer()
+
+};
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
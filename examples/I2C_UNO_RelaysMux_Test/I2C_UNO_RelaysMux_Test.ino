@@ -48,6 +48,7 @@
 //#define Debugf      Serial.printf
 
 #include <I2C_RelaysMux.h>
+#include <I2C_RelaysMuxCommand.h>
 
 
 I2CMUX        relay; //Create instance of the I2CMUX object
@@ -60,7 +61,7 @@ int           numRelays;
 uint32_t      loopTimer, inactiveTimer;
 bool          loopTestOn = false;
 uint16_t      loopRegister = 0;
-String        command;
+I2CMUXCommand console;       // reads the commands from Serial
 
 
 //===========================================================================================
@@ -99,13 +100,7 @@ byte findSlaveAddress(byte startAddress)
 //===========================================================================================
 void setLoopRegister()
 {
-  loopRegister = 0;  
-  for (int p=1; p<=numRelays; p++) {
-    if (relay.digitalRead(p) == 1)
-    {
-      loopRegister |= (1<< (p-1));
-    }
-  }
+  loopRegister = relay.readAll();
   
 } // setLoopRegister()
 
@@ -119,9 +114,10 @@ void displayPinState()
   }
   Serial.println();
 
+  uint16_t relayState = relay.readAll();
   Serial.print("State: ");
   for (int p=numRelays; p>=1; p--) {
-    int pState = relay.digitalRead(p);
+    int pState = (relayState >> (p-1)) & 1;
     if (pState == HIGH)
           Serial.print("H");
     else  Serial.print("L");
@@ -155,16 +151,11 @@ void loopRelays()
     if (loopRegister == 0) loopRegister = 7;
     loopRegister = rightRotate(loopRegister, 1, numRelays);
 
-    for (int i=0; i<numRelays; i++)
-    {
-      if (loopRegister & (1<<i)) relay.digitalWrite((i+1), HIGH);
-      else                       relay.digitalWrite((i+1), LOW);
-    }
     for (int i=(numRelays+1); i<=16; i++)
     {
       loopRegister &= ~(1<< (i-1));
-      relay.digitalWrite((i+1), LOW);
     }
+    relay.writeAll(loopRegister);
     relay.showRegister(sizeof(loopRegister), &loopRegister, &Serial);
 
 } // loopRelays()
@@ -173,25 +164,32 @@ void loopRelays()
 //===========================================================================================
 bool Mux_Status()
 {
-  whoAmI       = relay.getWhoAmI();
+  I2CMUX_Info info;
+
+  //-- one transaction for all board info (Slave firmware v1.9+) --
+  if (!relay.readInfo(info)) {
+    Serial.println("readInfo() failed .. (Slave firmware older than v1.9?)");
+    return false;
+  }
+  whoAmI       = info.whoAmI;
   Serial.print("whoAmI[0x"); Serial.print(whoAmI, HEX); Serial.println("]");
   if (whoAmI != I2C_MUX_ADDRESS && whoAmI != 0x24) {
     Serial.print("whoAmI returned [0x"); Serial.print(whoAmI, HEX); Serial.println("]");
     return false;
   }
   displayPinState();
-  //Serial.println("getMajorRelease() ..");
-  majorRelease = relay.getMajorRelease();
-  //Serial.println("getMinorRelease() ..");
-  minorRelease = relay.getMinorRelease();
+  majorRelease = info.majorRelease;
+  minorRelease = info.minorRelease;
     
   Serial.print("\nSlave say's he's [0x");Serial.print(whoAmI, HEX); 
   Serial.print("] Release[");            Serial.print(majorRelease);
   Serial.print(".");                     Serial.print(minorRelease);
   Serial.println("]");
-  numRelays = relay.getNumRelays();
+  numRelays = info.numberOfRelays;
+  console.setNumRelays(numRelays);
   Serial.print("Board has [");  Serial.print(numRelays);
   Serial.println("] relays\r\n"); 
+  return true;
 
 } // Mux_Status()
 
@@ -208,8 +206,11 @@ bool ScanI2Cbus(byte startAddress)
       Serial.println(F("]"));
       Serial.flush();
       if (relay.begin(Wire, actI2Caddress)) {
-        majorRelease = relay.getMajorRelease();
-        minorRelease = relay.getMinorRelease();
+        I2CMUX_Info info;
+        if (relay.readInfo(info)) {
+          majorRelease = info.majorRelease;
+          minorRelease = info.minorRelease;
+        }
         Serial.print(F(". connected with slave @[0x"));
         Serial.print(actI2Caddress, HEX);
         Serial.print(F("] Release[v"));
@@ -218,7 +219,6 @@ bool ScanI2Cbus(byte startAddress)
         Serial.print(minorRelease);
         Serial.println(F("]"));
         Serial.flush();
-        actI2Caddress = relay.getWhoAmI();
         I2C_MuxConnected = true;
         return true;
         
@@ -243,8 +243,13 @@ void help()
   Serial.println(F("  Commands are:"));
   Serial.println(F("    n=1;         -> sets relay n to 'closed'"));
   Serial.println(F("    n=0;         -> sets relay n to 'open'"));
+  Serial.println(F("    1-4,7=1;     -> sets relays 1 to 4 and 7 to 'closed'"));
   Serial.println(F("    all=1;       -> sets all relay's to 'closed'"));
   Serial.println(F("    all=0;       -> sets all relay's to 'open'"));
+  Serial.println(F("    mask=0x0F0F; -> sets all relay's (bit 0 is relay 1)"));
+  Serial.println(F("    @night;      -> sets the relay's of scene 'night'"));
+  Serial.println(F("    1-8=0 3=1;   -> items are combined in one write"));
+  Serial.println(F("                       (plus a read unless the cache is on)"));
   Serial.println(F("    address48;   -> sets I2C address to 0x48"));
   Serial.println(F("    address24;   -> sets I2C address to 0x24"));
   Serial.println(F("    board8;      -> set's board to 8 relay's"));
@@ -263,100 +268,49 @@ void help()
 
 
 //===========================================================================================
-void setAllToZero()
-{
-  relay.setNumRelays(16);
-  for (int i=1; i<=16; i++) relay.digitalWrite(i, LOW); 
-  relay.setNumRelays(numRelays);
-  
-} // setAllToZero()
-
-//===========================================================================================
-void executeCommand(String command)
+void executeCommand(const I2CMUX_Command &cmd)
 {
   inactiveTimer = millis();
   loopTestOn    = false;
 
-  if (command == "0=1")       relay.digitalWrite(0,  HIGH); 
-  if (command == "0=0")       relay.digitalWrite(0,  LOW); 
-  if (command == "1=1")       relay.digitalWrite(1,  HIGH); 
-  if (command == "1=0")       relay.digitalWrite(1,  LOW); 
-  if (command == "2=1")       relay.digitalWrite(2,  HIGH); 
-  if (command == "2=0")       relay.digitalWrite(2,  LOW); 
-  if (command == "3=1")       relay.digitalWrite(3,  HIGH); 
-  if (command == "3=0")       relay.digitalWrite(3,  LOW); 
-  if (command == "4=1")       relay.digitalWrite(4,  HIGH); 
-  if (command == "4=0")       relay.digitalWrite(4,  LOW); 
-  if (command == "5=1")       relay.digitalWrite(5,  HIGH); 
-  if (command == "5=0")       relay.digitalWrite(5,  LOW); 
-  if (command == "6=1")       relay.digitalWrite(6,  HIGH); 
-  if (command == "6=0")       relay.digitalWrite(6,  LOW); 
-  if (command == "7=1")       relay.digitalWrite(7,  HIGH); 
-  if (command == "7=0")       relay.digitalWrite(7,  LOW); 
-  if (command == "8=1")       relay.digitalWrite(8,  HIGH); 
-  if (command == "8=0")       relay.digitalWrite(8,  LOW); 
-  if (command == "9=1")       relay.digitalWrite(9,  HIGH); 
-  if (command == "9=0")       relay.digitalWrite(9,  LOW); 
-  if (command == "10=1")      relay.digitalWrite(10, HIGH); 
-  if (command == "10=0")      relay.digitalWrite(10, LOW); 
-  if (command == "11=1")      relay.digitalWrite(11, HIGH); 
-  if (command == "11=0")      relay.digitalWrite(11, LOW); 
-  if (command == "12=1")      relay.digitalWrite(12, HIGH); 
-  if (command == "12=0")      relay.digitalWrite(12, LOW); 
-  if (command == "13=1")      relay.digitalWrite(13, HIGH); 
-  if (command == "13=0")      relay.digitalWrite(13, LOW); 
-  if (command == "14=1")      relay.digitalWrite(14, HIGH); 
-  if (command == "14=0")      relay.digitalWrite(14, LOW); 
-  if (command == "15=1")      relay.digitalWrite(15, HIGH); 
-  if (command == "15=0")      relay.digitalWrite(15, LOW); 
-  if (command == "16=1")      relay.digitalWrite(16, HIGH); 
-  if (command == "16=0")      relay.digitalWrite(16, LOW); 
-  if (command == "all=1")
+  if (cmd.type == I2CMUX_CMD_ERROR)
   {
-    for (int i=1; i<=numRelays; i++) relay.digitalWrite(i, HIGH); 
+    Serial.print(F("error at position ")); Serial.println(cmd.errorPos + 1);
+    return;
+  }
+  if (cmd.type == I2CMUX_CMD_RELAYS)
+  {
+    if (!console.apply(relay)) Serial.println(F("error switching relays"));
+    return;
   }
-  if (command == "all=0")       setAllToZero();
-  if (command == "status")      Mux_Status();
-  if (command == "address48")   {actI2Caddress = 0x48; relay.setI2Caddress(actI2Caddress); }
-  if (command == "address24")   {actI2Caddress = 0x24; relay.setI2Caddress(actI2Caddress); }
-  if (command == "board8")      {numRelays = 8;  relay.setNumRelays(numRelays); command = "all=0"; }
-  if (command == "board16")     {numRelays = 16; relay.setNumRelays(numRelays); command = "all=0"; }
-  if (command == "pinstate")    displayPinState();
-  if (command == "looptest")    loopTestOn = true;
-  if (command == "muxtest")     relay.writeCommand(1<<CMD_TESTRELAYS);
-  if (command == "whoami")      { Serial.print("I am 0x"); 
-                                    Serial.println(relay.getWhoAmI(), HEX);
-                                }
-  if (command == "readconfig")  relay.writeCommand(1<<CMD_READCONF);
-  if (command == "writeconfig") relay.writeCommand(1<<CMD_WRITECONF);
-  if (command == "reboot")      relay.writeCommand(1<<CMD_REBOOT);
-  if (command == "help")        help();
-  if (command == "rescan")      ScanI2Cbus(1);
+
+  if (!strcmp(cmd.word, "status"))      Mux_Status();
+  if (!strcmp(cmd.word, "address48"))   {actI2Caddress = 0x48; relay.setI2Caddress(actI2Caddress); }
+  if (!strcmp(cmd.word, "address24"))   {actI2Caddress = 0x24; relay.setI2Caddress(actI2Caddress); }
+  if (!strcmp(cmd.word, "board8"))      {numRelays = 8;  relay.setNumRelays(numRelays); console.setNumRelays(numRelays); }
+  if (!strcmp(cmd.word, "board16"))     {numRelays = 16; relay.setNumRelays(numRelays); console.setNumRelays(numRelays); }
+  if (!strcmp(cmd.word, "pinstate"))    displayPinState();
+  if (!strcmp(cmd.word, "looptest"))    loopTestOn = true;
+  if (!strcmp(cmd.word, "muxtest"))     relay.writeCommand(1<<CMD_TESTRELAYS);
+  if (!strcmp(cmd.word, "whoami"))      { Serial.print("I am 0x"); 
+                                          Serial.println(relay.getWhoAmI(), HEX);
+                                        }
+  if (!strcmp(cmd.word, "readconfig"))  relay.writeCommand(1<<CMD_READCONF);
+  if (!strcmp(cmd.word, "writeconfig")) relay.writeCommand(1<<CMD_WRITECONF);
+  if (!strcmp(cmd.word, "reboot"))      relay.writeCommand(1<<CMD_REBOOT);
+  if (!strcmp(cmd.word, "help"))        help();
+  if (!strcmp(cmd.word, "rescan"))      ScanI2Cbus(1);
   
 } // executeCommand()
 
 
 //===========================================================================================
+//-- never waits: takes what Serial has and executes a command when it is complete --
 void readCommand()
 {
-  String command = "";
-  if (!Serial.available()) {
-    return;
-  }
-  Serial.setTimeout(100);  // ten seconds
-  command = Serial.readStringUntil(';');
-  command.toLowerCase();
-  command.trim();
-  for (int i = 0; i < command.length(); i++)
-  {
-    if (command[i] < ' ' || command[i] > '~') command[i] = 0;
-  }
-  
-  if (command.length() < 1) { help(); return; }
-
-  Serial.print("command["); Serial.print(command); Serial.println("]");
+  if (!console.poll(Serial)) return;
 
-  executeCommand(command);
+  executeCommand(console.command());
   
 } // readCommand()
 
@@ -389,6 +343,10 @@ void setup()
 
   if (I2C_MuxConnected) Mux_Status();
 
+  //-- "@night;" closes relay 1 and opens 2 to 8, "@day;" the other way around --
+  console.addScene("night", 0x0001, 0x00FE);
+  console.addScene("day",   0x00FE, 0x0001);
+
   Serial.println(F("setup() done .. \r\n"));
 
   help();
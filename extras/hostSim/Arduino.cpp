@@ -0,0 +1,298 @@
+/*
+***************************************************************************
+**
+**  File    : Arduino.cpp (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "SimBus.h"
+
+volatile uint8_t PORTB, DDRB;
+volatile uint8_t PORTC, DDRC;
+volatile uint8_t PORTD, DDRD;
+volatile uint8_t SREG, MCUSR = _BV(PORF), TWAR;
+
+HardwareSerial  Serial;
+EEPROMClass     EEPROM;
+
+static uint8_t  simEeprom[E2END + 1];
+static bool     simEepromErased = false;
+static uint64_t simEepromReady  = 0;    // the write in progress is done
+
+#define EEPROM_WRITE_TIME   3300    // usecs per byte
+
+
+//==========================================================================
+//== CPU and GPIO ==========================================================
+//==========================================================================
+
+//--------------------------------------------------------------------------
+void cli()
+{
+  SREG &= ~_BV(7);
+}
+
+//--------------------------------------------------------------------------
+void sei()
+{
+  SREG |= _BV(7);
+}
+
+// Arduino pin 0..7 is PORTD, 8..13 is PORTB and 14..19 is PORTC
+//--------------------------------------------------------------------------
+static volatile uint8_t *pinToPort(uint8_t pin, volatile uint8_t **ddr, uint8_t *bit)
+{
+  if (pin < 8)  { *ddr = &DDRD; *bit = pin;      return &PORTD; }
+  if (pin < 14) { *ddr = &DDRB; *bit = pin - 8;  return &PORTB; }
+  if (pin < 20) { *ddr = &DDRC; *bit = pin - 14; return &PORTC; }
+  return NULL;
+}
+
+//--------------------------------------------------------------------------
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  volatile uint8_t *ddr, *port;
+  uint8_t          bit;
+
+  if ((port = pinToPort(pin, &ddr, &bit)) == NULL) return;
+  if (mode == OUTPUT) {
+    *ddr |= _BV(bit);
+  } else {
+    *ddr &= ~_BV(bit);
+    if (mode == INPUT_PULLUP) *port |=  _BV(bit);
+    else                      *port &= ~_BV(bit);
+  }
+}
+
+//--------------------------------------------------------------------------
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  volatile uint8_t *ddr, *port;
+  uint8_t          bit;
+
+  if ((port = pinToPort(pin, &ddr, &bit)) == NULL) return;
+  if (val == LOW) *port &= ~_BV(bit);
+  else            *port |=  _BV(bit);
+}
+
+//--------------------------------------------------------------------------
+int digitalRead(uint8_t pin)
+{
+  volatile uint8_t *ddr, *port;
+  uint8_t          bit;
+
+  if ((port = pinToPort(pin, &ddr, &bit)) == NULL) return LOW;
+  return ((*port & _BV(bit)) ? HIGH : LOW);
+}
+
+
+//==========================================================================
+//== EEPROM (erased on first use) ==========================================
+//==========================================================================
+
+//--------------------------------------------------------------------------
+static uint8_t *eepromCell(const void *addr)
+{
+  if (!simEepromErased) {
+    memset(simEeprom, 0xFF, sizeof(simEeprom));
+    simEepromErased = true;
+  }
+  return &simEeprom[(uintptr_t)addr & E2END];
+}
+
+//--------------------------------------------------------------------------
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+  if (simMicros() < simEepromReady) simAdvance(simEepromReady - simMicros());
+  return *eepromCell(addr);
+}
+
+//--------------------------------------------------------------------------
+// Like the AVR: waits for the previous write, then starts this one and
+// returns while the EEPROM is still busy (see eeprom_is_ready())
+void eeprom_write_byte(uint8_t *addr, uint8_t val)
+{
+  if (simMicros() < simEepromReady) simAdvance(simEepromReady - simMicros());
+  *eepromCell(addr) = val;
+  simEepromReady = simMicros() + EEPROM_WRITE_TIME;
+}
+
+//--------------------------------------------------------------------------
+bool eeprom_is_ready()
+{
+  return (simMicros() >= simEepromReady);
+}
+
+//--------------------------------------------------------------------------
+void eeprom_update_byte(uint8_t *addr, uint8_t val)
+{
+  if (eeprom_read_byte(addr) != val) eeprom_write_byte(addr, val);
+}
+
+//--------------------------------------------------------------------------
+void eeprom_read_block(void *dst, const void *src, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+  }
+}
+
+//--------------------------------------------------------------------------
+void eeprom_write_block(const void *src, void *dst, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    eeprom_write_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+  }
+}
+
+//--------------------------------------------------------------------------
+void eeprom_update_block(const void *src, void *dst, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+  }
+}
+
+
+//==========================================================================
+//== Print and Serial ======================================================
+//==========================================================================
+
+//--------------------------------------------------------------------------
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(const char *str)
+{
+  return write(str);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(unsigned char n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(int n, int base)
+{
+  return print((long)n, base);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(unsigned int n, int base)
+{
+  return print((unsigned long)n, base);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(long n, int base)
+{
+  if (base == DEC) {
+    char buff[24];
+    snprintf(buff, sizeof(buff), "%ld", n);
+    return print(buff);
+  }
+  return print((unsigned long)n, base);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(unsigned long n, int base)
+{
+  char buff[72];
+  char *p = &buff[sizeof(buff) - 1];
+
+  if (base < 2) base = DEC;
+  *p = '\0';
+  do {
+    uint8_t digit = n % base;
+    *--p = (digit < 10 ? '0' + digit : 'A' + digit - 10);
+    n /= base;
+  } while (n > 0);
+  return print(p);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::print(double n, int digits)
+{
+  char buff[40];
+  snprintf(buff, sizeof(buff), "%.*f", digits, n);
+  return print(buff);
+}
+
+//--------------------------------------------------------------------------
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+//--------------------------------------------------------------------------
+size_t HardwareSerial::write(uint8_t c)
+{
+  return (fputc(c, stdout) == EOF ? 0 : 1);
+}
+
+//--------------------------------------------------------------------------
+int HardwareSerial::available()
+{
+  struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+  return (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------
+int HardwareSerial::read()
+{
+  if (!available()) return -1;
+  uint8_t c;
+  return (::read(STDIN_FILENO, &c, 1) == 1 ? c : -1);
+}
+
+//--------------------------------------------------------------------------
+int HardwareSerial::peek()
+{
+  return -1;    // not supported
+}
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
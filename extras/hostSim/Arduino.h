@@ -0,0 +1,148 @@
+/*
+***************************************************************************
+**
+**  File    : Arduino.h (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Host (Linux) stand-in for the Arduino core. Just enough to compile
+**  the I2C_RelaysMux library and the I2C_ATmega_RelaysMux firmware on
+**  a PC. Time is simulated (see SimBus.h): delay() does not sleep but
+**  moves the simulated clock forward.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _SIM_ARDUINO_H
+#define _SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary.h"
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH          0x1
+#define LOW           0x0
+
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+#define DEC           10
+#define HEX           16
+#define BIN           2
+
+#define _BV(bit)      (1 << (bit))
+#define F(string)     (string)
+#define PROGMEM
+
+//-- simulated ATmega328P registers (only one virtual Slave per process) --
+extern volatile uint8_t PORTB, DDRB;
+extern volatile uint8_t PORTC, DDRC;
+extern volatile uint8_t PORTD, DDRD;
+extern volatile uint8_t SREG, MCUSR, TWAR;
+
+#define PINB          PORTB   // outputs read back what is written
+#define PINC          PORTC
+#define PIND          PORTD
+#define TWGCE         0
+
+#define PORF          0
+#define EXTRF         1
+#define BORF          2
+#define WDRF          3
+
+void          cli();
+void          sei();
+
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long msecs);
+void          delayMicroseconds(unsigned int usecs);
+void          yield();
+
+void          pinMode(uint8_t pin, uint8_t mode);
+void          digitalWrite(uint8_t pin, uint8_t val);
+int           digitalRead(uint8_t pin);
+
+//--------------------------------------------------------------------------
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t  write(const char *str)  { return write((const uint8_t *)str, strlen(str)); }
+
+  size_t  print(const char *str);
+  size_t  print(char c);
+  size_t  print(unsigned char n, int base = DEC);
+  size_t  print(int n, int base = DEC);
+  size_t  print(unsigned int n, int base = DEC);
+  size_t  print(long n, int base = DEC);
+  size_t  print(unsigned long n, int base = DEC);
+  size_t  print(double n, int digits = 2);
+
+  size_t  println();
+  template <typename T> size_t println(T value)           { size_t n = print(value);       return n + println(); }
+  template <typename T> size_t println(T value, int fmt)  { size_t n = print(value, fmt);  return n + println(); }
+
+  virtual void flush() {}
+};
+
+//--------------------------------------------------------------------------
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+//--------------------------------------------------------------------------
+//-- Serial writes to stdout and reads from stdin (non blocking) ----------
+class HardwareSerial : public Stream
+{
+public:
+  void    begin(unsigned long baud) { (void)baud; }
+  size_t  write(uint8_t c);
+  using   Print::write;
+  int     available();
+  int     read();
+  int     peek();
+};
+
+extern HardwareSerial Serial;
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,61 @@
+/*
+***************************************************************************
+**
+**  File    : EEPROM.h (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Host stand-in for the AVR EEPROM (1024 bytes, erased to 0xFF).
+**  Every byte that is written costs 3.3 msec of simulated time.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _SIM_EEPROM_H
+#define _SIM_EEPROM_H
+
+#include "avr/eeprom.h"
+
+class EEPROMClass
+{
+public:
+  uint8_t read(int idx)                 { return eeprom_read_byte((const uint8_t *)(intptr_t)idx); }
+  void    write(int idx, uint8_t val)   { eeprom_write_byte((uint8_t *)(intptr_t)idx, val); }
+  void    update(int idx, uint8_t val)  { eeprom_update_byte((uint8_t *)(intptr_t)idx, val); }
+  uint16_t length()                     { return E2END + 1; }
+
+  template <typename T> T &get(int idx, T &t)
+  {
+    eeprom_read_block(&t, (const void *)(intptr_t)idx, sizeof(T));
+    return t;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
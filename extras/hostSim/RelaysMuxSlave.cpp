@@ -0,0 +1,118 @@
+/*
+***************************************************************************
+**
+**  File    : RelaysMuxSlave.cpp (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  The firmware sketch is compiled in its own namespace, with its own
+**  (Slave) Wire object, so it does not clash with the Master code.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "EEPROM.h"
+#include "avr/wdt.h"
+#include "SimBus.h"
+#include "RelaysMuxSlave.h"
+
+namespace RelaysMuxFirmware {
+
+  TwoWire Wire;     // the Slave side
+
+  //-- the Arduino IDE generates these for a sketch ----------------------
+  #include "firmwareProtos.h"
+
+  //-- the tabs in the order the Arduino IDE puts them together ----------
+  #include "../../examples/I2C_ATmega_RelaysMux/I2C_ATmega_RelaysMux.ino"
+  #include "../../examples/I2C_ATmega_RelaysMux/I2Cstuff.ino"
+  #include "../../examples/I2C_ATmega_RelaysMux/cycleStuff.ino"
+  #include "../../examples/I2C_ATmega_RelaysMux/eepromStuff.ino"
+  #include "../../examples/I2C_ATmega_RelaysMux/eventStuff.ino"
+  #include "../../examples/I2C_ATmega_RelaysMux/relayStuff.ino"
+  #include "../../examples/I2C_ATmega_RelaysMux/scheduleStuff.ino"
+
+} // namespace RelaysMuxFirmware
+
+
+//--------------------------------------------------------------------------
+static void slaveLoop()
+{
+  RelaysMuxFirmware::loop();
+}
+
+//--------------------------------------------------------------------------
+static void slaveReset(uint8_t resetFlags)
+{
+  //-- after a reset all GPIO's are INPUT without pull-up --
+  PORTB = 0; DDRB = 0;
+  PORTC = 0; DDRC = 0;
+  PORTD = 0; DDRD = 0;
+  SREG  = 0;
+  MCUSR |= resetFlags;
+  //-- a real reset also clears the RAM --
+  RelaysMuxFirmware::msgHead    = 0;
+  RelaysMuxFirmware::msgTail    = 0;
+  RelaysMuxFirmware::maskStaged = false;
+  RelaysMuxFirmware::maskLatched = false;
+  RelaysMuxFirmware::latchQueued = false;
+  memset(RelaysMuxFirmware::timers, 0, sizeof(RelaysMuxFirmware::timers));
+  RelaysMuxFirmware::seqRunning = false;
+  RelaysMuxFirmware::cyclesCounting = false;
+  RelaysMuxFirmware::cyclesChanged  = false;
+  RelaysMuxFirmware::configSavePos  = -1;
+  RelaysMuxFirmware::setup();
+}
+
+//--------------------------------------------------------------------------
+void simSlaveBegin()
+{
+  simBus.setSlaveHooks(slaveLoop, slaveReset);
+  simBus.resetSlave(_BV(PORF));
+}
+
+//--------------------------------------------------------------------------
+uint16_t simSlaveRelays()
+{
+  return RelaysMuxFirmware::readRelayMask();
+}
+
+//--------------------------------------------------------------------------
+uint8_t simSlaveAddress()
+{
+  return RelaysMuxFirmware::Wire.slaveAddress();
+}
+
+//--------------------------------------------------------------------------
+bool simSlaveChanged()
+{
+  //-- open-drain: LOW when PB4 (D12) is an output --
+  return (DDRB & _BV(_CHANGED_BIT)) != 0;
+}
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,51 @@
+/*
+***************************************************************************
+**
+**  File    : RelaysMuxSlave.h (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  A virtual I2C_RelaysMux board on the simulated bus. It runs the real
+**  firmware from examples/I2C_ATmega_RelaysMux (receiveEvent(), 
+**  requestEvent(), processCommand(), loop(), ..) against simulated 
+**  ports, EEPROM and watchdog.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _RELAYSMUX_SLAVE_H
+#define _RELAYSMUX_SLAVE_H
+
+#include "Arduino.h"
+
+void      simSlaveBegin();          // power on the virtual board
+uint16_t  simSlaveRelays();         // relay states as seen on the ports (bit 0 is relay 1)
+uint8_t   simSlaveAddress();        // the address the firmware is listening on
+bool      simSlaveChanged();        // the "changed" line is asserted (LOW)
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,635 @@
+/*
+***************************************************************************
+**
+**  File    : SimBus.cpp (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include "SimBus.h"
+#include "avr/wdt.h"
+
+SimBus  simBus;
+TwoWire Wire;     // the Master side
+
+//-- with -DI2CMUX_ENABLE_TASKS (taskSim) Master threads share the clock,
+//-- the bus and the Slave: one thread at a time may touch them ----------
+#ifdef I2CMUX_ENABLE_TASKS
+  #include <mutex>
+  static std::recursive_mutex simMutex;
+  #define SIM_LOCK()  std::lock_guard<std::recursive_mutex> simGuard(simMutex)
+#else
+  #define SIM_LOCK()
+#endif
+
+//-- thrown by delay() when the watchdog of the Slave expires -------------
+struct SimWatchdogReset { };
+
+static uint64_t simClock      = 0;
+static uint8_t  simSlaveDepth = 0;
+static bool     wdtEnabled    = false;
+static uint64_t wdtTimeout    = 0;
+static uint64_t wdtLastReset  = 0;
+
+//-- everything between SlaveContext's constructor and destructor is
+//-- executed "by the Slave" (no nested loop(), the watchdog is active)
+struct SlaveContext {
+  SlaveContext()  { simSlaveDepth++; }
+  ~SlaveContext() { simSlaveDepth--; }
+};
+
+
+//==========================================================================
+//== the simulated clock ===================================================
+//==========================================================================
+
+//--------------------------------------------------------------------------
+uint64_t simMicros()
+{
+  SIM_LOCK();
+  return simClock;
+}
+
+//--------------------------------------------------------------------------
+void simAdvance(uint64_t usecs)
+{
+  SIM_LOCK();
+  simClock += usecs;
+}
+
+//--------------------------------------------------------------------------
+void simSetMicros(uint64_t usecs)
+{
+  simClock = usecs;
+}
+
+//--------------------------------------------------------------------------
+bool simInSlave()
+{
+  return (simSlaveDepth > 0);
+}
+
+//--------------------------------------------------------------------------
+static void checkWatchdog()
+{
+  if (wdtEnabled && (simClock - wdtLastReset) > wdtTimeout) {
+    wdtEnabled = false;
+    throw SimWatchdogReset();
+  }
+}
+
+//--------------------------------------------------------------------------
+unsigned long millis()
+{
+  SIM_LOCK();
+  return (uint32_t)(simClock / 1000);   // wraps like a 32 bit Arduino
+}
+
+//--------------------------------------------------------------------------
+unsigned long micros()
+{
+  SIM_LOCK();
+  return (uint32_t)simClock;
+}
+
+//--------------------------------------------------------------------------
+void delay(unsigned long msecs)
+{
+  for (unsigned long ms = 0; ms < msecs; ms++) {
+    SIM_LOCK();                 // per msec, so other threads get a turn
+    simAdvance(1000);
+    if (simInSlave()) checkWatchdog();
+    else              simBus.runSlaveLoop();
+  }
+}
+
+//--------------------------------------------------------------------------
+void delayMicroseconds(unsigned int usecs)
+{
+  SIM_LOCK();
+  simAdvance(usecs);
+}
+
+//--------------------------------------------------------------------------
+void yield()
+{
+  SIM_LOCK();
+  if (!simInSlave()) simBus.runSlaveLoop();
+}
+
+//--------------------------------------------------------------------------
+void wdt_enable(uint8_t timeout)
+{
+  wdtEnabled   = true;
+  wdtTimeout   = (uint64_t)15000 << timeout;  // WDTO_15MS .. WDTO_8S
+  wdtLastReset = simClock;
+}
+
+//--------------------------------------------------------------------------
+void wdt_disable()
+{
+  wdtEnabled = false;
+}
+
+//--------------------------------------------------------------------------
+void wdt_reset()
+{
+  wdtLastReset = simClock;
+}
+
+
+//==========================================================================
+//== SimBus ================================================================
+//==========================================================================
+
+//--------------------------------------------------------------------------
+SimBus::SimBus()
+{
+  memset(_slaves, 0, sizeof(_slaves));
+  _clock          = 100000;
+  _stretchLimit   = 0;
+  _slaveBusyTime  = 0;
+  _busyNack       = false;
+  _nackNext       = 0;
+  _nackRate       = 0;
+  _random         = 1;
+  _isrBusyUntil   = 0;
+  _loopBusyUntil  = 0;
+  _bootUntil      = 0;
+  _loopHook       = NULL;
+  _resetHook      = NULL;
+  resetStats();
+}
+
+//--------------------------------------------------------------------------
+void SimBus::setClock(uint32_t clock)
+{
+  if (clock > 0) _clock = clock;
+}
+
+//--------------------------------------------------------------------------
+uint32_t SimBus::getClock()
+{
+  return _clock;
+}
+
+//--------------------------------------------------------------------------
+void SimBus::setStretchLimit(uint32_t usecs)
+{
+  _stretchLimit = usecs;
+}
+
+//--------------------------------------------------------------------------
+void SimBus::setSlaveBusyTime(uint32_t usecs)
+{
+  _slaveBusyTime = usecs;
+}
+
+//--------------------------------------------------------------------------
+void SimBus::setBusyNack(bool nack)
+{
+  _busyNack = nack;
+}
+
+//--------------------------------------------------------------------------
+void SimBus::nackNext(uint16_t count)
+{
+  _nackNext = count;
+}
+
+//--------------------------------------------------------------------------
+void SimBus::setNackRate(uint8_t percent, uint32_t seed)
+{
+  _nackRate = percent;
+  _random   = (seed == 0 ? 1 : seed);
+}
+
+//--------------------------------------------------------------------------
+void SimBus::attach(TwoWire *slave)
+{
+  detach(slave);
+  for (uint8_t s = 0; s < SIM_MAX_SLAVES; s++) {
+    if (_slaves[s] == NULL) {
+      _slaves[s] = slave;
+      return;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+void SimBus::detach(TwoWire *slave)
+{
+  for (uint8_t s = 0; s < SIM_MAX_SLAVES; s++) {
+    if (_slaves[s] == slave) _slaves[s] = NULL;
+  }
+}
+
+//--------------------------------------------------------------------------
+void SimBus::setSlaveHooks(void (*loopHook)(), void (*resetHook)(uint8_t resetFlags))
+{
+  _loopHook  = loopHook;
+  _resetHook = resetHook;
+}
+
+// (Re)boot the Slave: it does not respond for SIM_BOOT_TIME usecs and 
+// then runs its setup()
+//--------------------------------------------------------------------------
+void SimBus::resetSlave(uint8_t resetFlags)
+{
+  SlaveContext inSlave;
+
+  _stats.resets++;
+  wdtEnabled     = false;
+  _isrBusyUntil  = 0;
+  _loopBusyUntil = 0;
+  _bootUntil     = simClock + SIM_BOOT_TIME;
+  if (_resetHook == NULL) return;
+
+  uint64_t start = simClock;
+  simAdvance(SIM_BOOT_TIME);
+  try {
+    _resetHook(resetFlags);
+  }
+  catch (SimWatchdogReset &) {
+    _resetHook(_BV(WDRF));
+  }
+  _bootUntil = simClock;
+  simSetMicros(start);
+
+} // resetSlave()
+
+// Give the Slave's loop() a turn. The loop() runs next to the Master, so
+// the time it takes is not added to the Master's time; the Slave just 
+// skips turns until it has "caught up"
+//--------------------------------------------------------------------------
+void SimBus::runSlaveLoop()
+{
+  if (_loopHook == NULL || simInSlave()) return;
+  uint64_t start = simClock;
+  if (start < _bootUntil || start < _isrBusyUntil || start < _loopBusyUntil) return;
+
+  try {
+    SlaveContext inSlave;
+    _loopHook();
+  }
+  catch (SimWatchdogReset &) {
+    resetSlave(_BV(WDRF));
+  }
+  _loopBusyUntil = simClock;
+  simSetMicros(start);
+
+} // runSlaveLoop()
+
+// Master writes data[] to address (0 is the General Call)
+//--------------------------------------------------------------------------
+uint8_t SimBus::masterWrite(uint8_t address, const uint8_t *data, uint8_t len)
+{
+  SIM_LOCK();
+  TwoWire *slave;
+  uint8_t  result = startTransaction(address, &slave, 1 + len);
+  if (result != SIM_OK) return result;
+
+  //-- the Slave handles the message after the STOP, while it does the
+  //-- bus is "busy" for the next transaction ---------------------------
+  uint64_t start = simClock;
+  try {
+    SlaveContext inSlave;
+    for (uint8_t s = 0; s < SIM_MAX_SLAVES; s++) {
+      if (_slaves[s] == NULL) continue;
+      if (address == 0 && !(TWAR & _BV(TWGCE))) continue;
+      if (address != 0 && _slaves[s] != slave)  continue;
+      _slaves[s]->slaveReceive(data, len);
+    }
+  }
+  catch (SimWatchdogReset &) {
+    resetSlave(_BV(WDRF));
+  }
+  if ((simClock + _slaveBusyTime) > _isrBusyUntil) {
+    _isrBusyUntil = simClock + _slaveBusyTime;
+  }
+  simSetMicros(start);
+
+  return SIM_OK;
+
+} // masterWrite()
+
+// Master reads len bytes from address. Returns the number of bytes read
+//--------------------------------------------------------------------------
+uint8_t SimBus::masterRead(uint8_t address, uint8_t *data, uint8_t len)
+{
+  SIM_LOCK();
+  TwoWire *slave;
+  if (address == 0) return 0;   // there is no General Call read
+  if (startTransaction(address, &slave, 1 + len) != SIM_OK) return 0;
+
+  uint64_t start = simClock;
+  try {
+    SlaveContext inSlave;
+    slave->slaveRequest(data, len);
+  }
+  catch (SimWatchdogReset &) {
+    resetSlave(_BV(WDRF));
+  }
+  simSetMicros(start);
+
+  return len;   // the Master always clocks in len bytes
+
+} // masterRead()
+
+//--------------------------------------------------------------------------
+const SimBusStats &SimBus::getStats()
+{
+  return _stats;
+}
+
+//--------------------------------------------------------------------------
+void SimBus::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+//--------------------------------------------------------------------------
+void SimBus::countCollision()
+{
+  SIM_LOCK();
+  _stats.collisions++;
+}
+
+// usecs on the bus for 'bytes' bytes (9 bits each) plus start and stop
+//--------------------------------------------------------------------------
+uint32_t SimBus::byteTime(uint16_t bytes)
+{
+  return (uint32_t)(((uint64_t)bytes * 9 + 2) * 1000000 / _clock);
+}
+
+// Address phase: find the Slave, handle NACKs and clock stretching and
+// move the clock over the whole transaction
+//--------------------------------------------------------------------------
+uint8_t SimBus::startTransaction(uint8_t address, TwoWire **slave, uint16_t bytes)
+{
+  runSlaveLoop();
+
+  _stats.transactions++;
+  *slave = NULL;
+  for (uint8_t s = 0; s < SIM_MAX_SLAVES; s++) {
+    if (_slaves[s] == NULL) continue;
+    if (address == 0 && (TWAR & _BV(TWGCE)))      *slave = _slaves[s];
+    if (_slaves[s]->slaveAddress() == address)   *slave = _slaves[s];
+  }
+
+  bool nack = (*slave == NULL || simClock < _bootUntil || randomNack());
+  if (_nackNext > 0) {
+    _nackNext--;
+    nack = true;
+  }
+  if (!nack && simClock < _isrBusyUntil && _busyNack) nack = true;
+  if (nack) {
+    _stats.nacks++;
+    _stats.bytes     += 1;
+    _stats.busMicros += byteTime(1);
+    simAdvance(byteTime(1));
+    return SIM_NACK_ADDRESS;
+  }
+
+  if (simClock < _isrBusyUntil) {
+    uint64_t stretch = _isrBusyUntil - simClock;
+    _stats.stretches++;
+    if (_stretchLimit > 0 && stretch > _stretchLimit) {
+      _stats.busMicros += _stretchLimit;
+      simAdvance(_stretchLimit);
+      return SIM_TIMEOUT;
+    }
+    _stats.busMicros += stretch;
+    simAdvance(stretch);
+    runSlaveLoop();   // between the two interrupts
+    //-- the watchdog may have reset the Slave in that loop() --
+    if (simClock < _bootUntil) {
+      _stats.nacks++;
+      return SIM_NACK_ADDRESS;
+    }
+  }
+
+  _stats.bytes     += bytes;
+  _stats.busMicros += byteTime(bytes);
+  simAdvance(byteTime(bytes));
+  return SIM_OK;
+
+} // startTransaction()
+
+//--------------------------------------------------------------------------
+bool SimBus::randomNack()
+{
+  if (_nackRate == 0) return false;
+  _random = _random * 1103515245 + 12345;
+  return (((_random >> 16) % 100) < _nackRate);
+}
+
+
+//==========================================================================
+//== TwoWire ===============================================================
+//==========================================================================
+
+//--------------------------------------------------------------------------
+TwoWire::TwoWire()
+{
+  _txAddress    = 0;
+  _txLength     = 0;
+  _rxIndex      = 0;
+  _rxLength     = 0;
+  _isSlave      = false;
+  _slaveAddress = 0xFF;
+  _onReceive    = NULL;
+  _onRequest    = NULL;
+#ifdef I2CMUX_ENABLE_TASKS
+  _open         = false;
+#endif
+}
+
+#ifdef I2CMUX_ENABLE_TASKS
+// Counts a collision if another thread still has a transaction open,
+// then yields so the other threads get every chance to get in between
+//--------------------------------------------------------------------------
+void TwoWire::claim(bool open)
+{
+  if (_isSlave) return;
+  if (_open && _owner != std::this_thread::get_id()) simBus.countCollision();
+  _owner = std::this_thread::get_id();
+  _open  = open;
+  std::this_thread::yield();
+}
+  #define WIRE_CLAIM(open)  claim(open)
+#else
+  #define WIRE_CLAIM(open)  do { } while (0)
+#endif
+
+//--------------------------------------------------------------------------
+void TwoWire::begin()
+{
+  _isSlave = false;
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::begin(uint8_t address)
+{
+  _isSlave      = true;
+  _slaveAddress = address;
+  TWAR          = address << 1;
+  simBus.attach(this);
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::end()
+{
+  if (_isSlave) simBus.detach(this);
+  _isSlave      = false;
+  _slaveAddress = 0xFF;
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::setClock(uint32_t clock)
+{
+  if (!_isSlave) simBus.setClock(clock);
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::setClockStretchLimit(uint32_t limit)
+{
+  simBus.setStretchLimit(limit);
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::beginTransmission(uint8_t address)
+{
+  WIRE_CLAIM(true);
+  _txAddress = address;
+  _txLength  = 0;
+}
+
+//--------------------------------------------------------------------------
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+  (void)sendStop;
+  WIRE_CLAIM(false);
+  uint8_t result = simBus.masterWrite(_txAddress, _txBuffer, _txLength);
+  _txLength = 0;
+  return result;
+}
+
+//--------------------------------------------------------------------------
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+{
+  (void)sendStop;
+  if (quantity > BUFFER_LENGTH) quantity = BUFFER_LENGTH;
+  WIRE_CLAIM(true);
+  _rxIndex  = 0;
+  _rxLength = simBus.masterRead(address, _rxBuffer, quantity);
+  if (_rxLength == 0) WIRE_CLAIM(false);
+  return _rxLength;
+}
+
+//--------------------------------------------------------------------------
+size_t TwoWire::write(uint8_t data)
+{
+  WIRE_CLAIM(true);
+  if (_txLength >= BUFFER_LENGTH) return 0;
+  _txBuffer[_txLength++] = data;
+  return 1;
+}
+
+//--------------------------------------------------------------------------
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+  size_t written = 0;
+  while (quantity-- > 0 && write(*data++)) written++;
+  return written;
+}
+
+//--------------------------------------------------------------------------
+int TwoWire::available()
+{
+  return _rxLength - _rxIndex;
+}
+
+//--------------------------------------------------------------------------
+int TwoWire::read()
+{
+  if (_rxIndex >= _rxLength) return -1;
+  WIRE_CLAIM(_rxIndex + 1 < _rxLength);   // the last byte ends the transaction
+  return _rxBuffer[_rxIndex++];
+}
+
+//--------------------------------------------------------------------------
+int TwoWire::peek()
+{
+  if (_rxIndex >= _rxLength) return -1;
+  return _rxBuffer[_rxIndex];
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::onReceive(void (*function)(int))
+{
+  _onReceive = function;
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::onRequest(void (*function)(void))
+{
+  _onRequest = function;
+}
+
+//--------------------------------------------------------------------------
+uint8_t TwoWire::slaveAddress()
+{
+  return _slaveAddress;
+}
+
+//--------------------------------------------------------------------------
+void TwoWire::slaveReceive(const uint8_t *data, uint8_t len)
+{
+  memcpy(_rxBuffer, data, len);
+  _rxIndex  = 0;
+  _rxLength = len;
+  if (_onReceive) _onReceive(len);
+}
+
+// The Slave answers with whatever its onRequest() handler writes; the
+// bytes the Master clocks in after that read as 0xFF (nobody pulls SDA low)
+//--------------------------------------------------------------------------
+uint8_t TwoWire::slaveRequest(uint8_t *data, uint8_t len)
+{
+  _txLength  = 0;
+  if (_onRequest) _onRequest();
+  for (uint8_t i = 0; i < len; i++) {
+    data[i] = (i < _txLength ? _txBuffer[i] : 0xFF);
+  }
+  uint8_t written = _txLength;
+  _txLength = 0;
+  return written;
+}
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
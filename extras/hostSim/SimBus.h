@@ -0,0 +1,125 @@
+/*
+***************************************************************************
+**
+**  File    : SimBus.h (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  The simulated I2C bus and the simulated clock.
+**
+**  All time is simulated: a transaction costs 9 bits per byte (plus start
+**  and stop) at the bus clock, delay() moves the clock forward and the
+**  EEPROM costs 3.3 msec per byte. The virtual Slave (RelaysMuxSlave.h)
+**  works "next to" the Master: time it spends in its onReceive() handler
+**  makes the bus busy (clock stretching or NACK) for the transactions
+**  that follow, time it spends in loop() does not block the bus at all.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _SIM_BUS_H
+#define _SIM_BUS_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define SIM_MAX_SLAVES    4
+#define SIM_BOOT_TIME     65000   // usecs a (re)booting Slave does not respond
+
+//-- endTransmission() return codes -------------------------------------
+#define SIM_OK            0
+#define SIM_NACK_ADDRESS  2
+#define SIM_NACK_DATA     3
+#define SIM_TIMEOUT       5
+
+struct SimBusStats {
+  uint32_t  transactions;   // address phases on the bus
+  uint32_t  bytes;          // all bytes on the bus (address bytes included)
+  uint32_t  nacks;          // address phases that were not acknowledged
+  uint32_t  stretches;      // transactions delayed by a busy Slave
+  uint32_t  resets;         // Slave (watchdog) resets
+  uint32_t  collisions;     // (taskSim) another thread got into an open transaction
+  uint64_t  busMicros;      // time the bus was in use (stretching included)
+};
+
+class SimBus
+{
+public:
+  SimBus();
+
+  void      setClock(uint32_t clock);             // bits per second
+  uint32_t  getClock();
+  void      setStretchLimit(uint32_t usecs);      // 0 is: the Master waits forever
+  void      setSlaveBusyTime(uint32_t usecs);     // Slave processing time per message
+  void      setBusyNack(bool nack);               // a busy Slave NACKs instead of stretching
+  void      nackNext(uint16_t count);             // NACK the next 'count' address phases
+  void      setNackRate(uint8_t percent, uint32_t seed = 1);
+
+  void      attach(TwoWire *slave);
+  void      detach(TwoWire *slave);
+  void      setSlaveHooks(void (*loopHook)(), void (*resetHook)(uint8_t resetFlags));
+  void      resetSlave(uint8_t resetFlags);
+  void      runSlaveLoop();
+
+  uint8_t   masterWrite(uint8_t address, const uint8_t *data, uint8_t len);
+  uint8_t   masterRead(uint8_t address, uint8_t *data, uint8_t len);
+
+  const SimBusStats &getStats();
+  void      resetStats();
+  void      countCollision();
+
+private:
+  TwoWire     *_slaves[SIM_MAX_SLAVES];
+  uint32_t    _clock;
+  uint32_t    _stretchLimit;
+  uint32_t    _slaveBusyTime;
+  bool        _busyNack;
+  uint16_t    _nackNext;
+  uint8_t     _nackRate;
+  uint32_t    _random;
+  uint64_t    _isrBusyUntil;    // Slave is (still) in its onReceive() handler
+  uint64_t    _loopBusyUntil;   // Slave is (still) in its loop()
+  uint64_t    _bootUntil;       // Slave is (re)booting
+  SimBusStats _stats;
+  void        (*_loopHook)();
+  void        (*_resetHook)(uint8_t);
+
+  uint32_t    byteTime(uint16_t bytes);
+  uint8_t     startTransaction(uint8_t address, TwoWire **slave, uint16_t bytes);
+  bool        randomNack();
+};
+
+extern SimBus simBus;
+
+//-- the simulated clock -------------------------------------------------
+uint64_t  simMicros();
+void      simAdvance(uint64_t usecs);   // move the clock (no Slave loop())
+void      simSetMicros(uint64_t usecs);
+bool      simInSlave();
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,105 @@
+/*
+***************************************************************************
+**
+**  File    : Wire.h (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Host stand-in for the TwoWire class. A TwoWire instance can be a
+**  Master (beginTransmission() .. endTransmission(), requestFrom()) or,
+**  after begin(address), a Slave on the simulated bus (see SimBus.h).
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#ifndef _SIM_WIRE_H
+#define _SIM_WIRE_H
+
+#include "Arduino.h"
+#ifdef I2CMUX_ENABLE_TASKS
+  #include <thread>
+#endif
+
+#define BUFFER_LENGTH 32    // same as the AVR twi buffer
+
+class TwoWire : public Stream
+{
+public:
+  TwoWire();
+
+  void    begin();                      // Master
+  void    begin(uint8_t address);       // Slave
+  void    begin(int address)            { begin((uint8_t)address); }
+  void    end();
+  void    setClock(uint32_t clock);
+  void    setClockStretchLimit(uint32_t limit);
+
+  void    beginTransmission(uint8_t address);
+  void    beginTransmission(int address) { beginTransmission((uint8_t)address); }
+  uint8_t endTransmission(uint8_t sendStop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+  uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+
+  size_t  write(uint8_t data);
+  size_t  write(const uint8_t *data, size_t quantity);
+  using   Print::write;
+  int     available();
+  int     read();
+  int     peek();
+
+  void    onReceive(void (*function)(int));
+  void    onRequest(void (*function)(void));
+
+  //-- used by SimBus ----
+  uint8_t slaveAddress();
+  void    slaveReceive(const uint8_t *data, uint8_t len);
+  uint8_t slaveRequest(uint8_t *data, uint8_t len);
+
+private:
+  uint8_t _txAddress;
+  uint8_t _txBuffer[BUFFER_LENGTH];
+  uint8_t _txLength;
+  uint8_t _rxBuffer[BUFFER_LENGTH];
+  uint8_t _rxIndex, _rxLength;
+  bool    _isSlave;
+  uint8_t _slaveAddress;
+
+  void    (*_onReceive)(int);
+  void    (*_onRequest)(void);
+
+#ifdef I2CMUX_ENABLE_TASKS
+  //-- taskSim: who has a transaction open on the Master side ----
+  std::thread::id _owner;
+  bool            _open;
+  void    claim(bool open);
+#endif
+};
+
+extern TwoWire Wire;
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,109 @@
+/*
+***************************************************************************
+**
+**  Program     : benchmark (part of hostSim)
+**  Version     : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Runs the I2C_RelaysMux_Benchmark tests (see
+**  examples/I2C_RelaysMux_Benchmark/relaysMuxBench.h) against the
+**  virtual RelaysMux board. Time is simulated so the results only
+**  change when the library, the firmware or the wire protocol change.
+**
+**  Usage: benchmark [-c clock] [-b busyUs] [-s stretchUs] [-n nack%] 
+**                   [-i calls] [-f] [-j]
+**     -c  I2C clock in Hz (default 100000)
+**     -b  Slave processing time per message in usecs (default 0)
+**     -s  clock stretch limit in usecs (default 0 = no limit)
+**     -n  percentage of address phases that are NACK'ed (default 0)
+**     -i  calls per test (default 200)
+**     -f  use I2CMUX_PACING_FIXED (default I2CMUX_PACING_ADAPTIVE)
+**     -j  JSON output (default CSV)
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimBus.h"
+#include "RelaysMuxSlave.h"
+#include "../../src/I2C_RelaysMux.h"
+#include "../../examples/I2C_RelaysMux_Benchmark/relaysMuxBench.h"
+
+#define I2C_MUX_ADDRESS  0x48
+
+I2CMUX    relay;
+
+//--------------------------------------------------------------------------
+static uint32_t busBytes()
+{
+  return (simBus.getStats().bytes);
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  int       opt;
+  bool      fixedPacing = false;
+  uint8_t   format      = BENCH_CSV;
+  uint32_t  busClock    = 100000;
+  uint16_t  calls       = 200;
+
+  while ((opt = getopt(argc, argv, "c:b:s:n:i:fj")) != -1) {
+    switch(opt)
+    {
+      case 'c': busClock = atol(optarg);                break;
+      case 'b': simBus.setSlaveBusyTime(atol(optarg));  break;
+      case 's': simBus.setStretchLimit(atol(optarg));   break;
+      case 'n': simBus.setNackRate(atoi(optarg));       break;
+      case 'i': calls = atoi(optarg);                   break;
+      case 'f': fixedPacing = true;                     break;
+      case 'j': format = BENCH_JSON;                    break;
+      default:  fprintf(stderr, "usage: %s [-c clock] [-b busyUs] [-s stretchUs] [-n nack%%] [-i calls] [-f] [-j]\n", argv[0]);
+                return 2;
+    }
+  }
+
+  simSlaveBegin();
+  delay(100);
+
+  if (!relay.begin(Wire, I2C_MUX_ADDRESS)) {
+    fprintf(stderr, "no virtual board @[0x%02X]\n", I2C_MUX_ADDRESS);
+    return 1;
+  }
+  Wire.setClock(busClock);    // begin() always sets 100kHz
+  relay.setPacing(fixedPacing ? I2CMUX_PACING_FIXED : I2CMUX_PACING_ADAPTIVE);
+
+  RelaysMuxBench bench(relay, Serial, format, busBytes);
+  bench.runAll(calls);
+
+  return 0;
+
+} // main()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,108 @@
+/*
+***************************************************************************
+**
+**  File    : firmwareProtos.h (part of hostSim)
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  The prototypes the Arduino IDE adds to the I2C_ATmega_RelaysMux
+**  sketch. Keep this in sync with the functions in the sketch!
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+//-- I2C_ATmega_RelaysMux.ino ---
+void      oneLoop();
+void      testRelays();
+void      reBoot();
+void      setup();
+void      loop();
+
+//-- eventStuff.ino ---
+void      assertChangedLine(bool changed);
+void      startEventLog();
+void      logRelayChanges();
+void      sendEvents();
+
+//-- I2Cstuff.ino ---
+void      startI2C();
+boolean   isConnected();
+byte      readMessage();
+void      processExtCommand(byte xCommand);
+void      processCommand(byte command);
+byte      batchCommandLength(const byte *cmd, byte left);
+void      processBatch();
+void      sendBatchAck();
+bool      registerWritable(uint16_t regNr);
+void      processMessage(byte regNr);
+void      processMessages();
+void      receiveEvent(int numberOfBytesReceived);
+void      requestEvent();
+
+//-- cycleStuff.ino ---
+void      startCycleCounters();
+void      accrueOnTime();
+void      countRelayChanges(uint16_t relayMask);
+void      resetCycleCounters(byte relayNr);
+void      handleCycleCounters();
+void      flushCycleCounters();
+void      selectCyclePage(byte page);
+void      sendCycles();
+
+//-- eepromStuff.ino ---
+static byte crc8(byte crc, byte data);
+static bool readConfigSlot(byte slot, void *data, uint16_t *sequence);
+static void readConfig();
+static bool startConfigSave();
+static void continueConfigSave(bool now);
+bool      configSaveBusy();
+static void writeConfig();
+void      savePowerOnState();
+static byte cycleRecordByte(int16_t pos);
+void      loadCycleCounters();
+void      saveCycleCounters(bool now);
+
+//-- relayStuff.ino ---
+void      applyRelayMask(uint16_t relayMask);
+void      writeRelay(byte relayNr, byte HIGH_LOW);
+bool      readRelay(byte relayNr);
+int8_t    relayPin(byte relayNr);
+void      stageRelayMask(uint16_t relayMask);
+void      latchRelayMask();
+void      countLatchedRelays();
+uint16_t  readRelayMask();
+
+//-- scheduleStuff.ino ---
+void      updateScheduleStatus();
+void      delayRelay(byte relayNr, byte HIGH_LOW, uint32_t msecs);
+void      pulseRelay(byte relayNr, byte HIGH_LOW, uint32_t msecs);
+void      cancelTimer(byte relayNr);
+void      stopSchedule();
+void      loadSequence(byte offset, byte count);
+void      startSequence(uint16_t interval, byte passes, byte length);
+void      handleSchedule();
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
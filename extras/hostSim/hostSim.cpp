@@ -0,0 +1,685 @@
+/*
+***************************************************************************
+**
+**  Program     : hostSim
+**  Version     : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Runs the whole I2CMUX command set against the virtual RelaysMux
+**  board on the simulated bus and reports, per API call, how many
+**  calls per second it can do, the (simulated) latency and the bus
+**  transactions it needs. Every call that changes relays is checked 
+**  against the relay ports of the virtual board.
+**
+**  Usage: hostSim [-c clock] [-b busyUs] [-s stretchUs] [-n nack%] 
+**                 [-i iterations] [-f] [-t]
+**     -c  I2C clock in Hz (default 100000)
+**     -b  Slave processing time per message in usecs (default 0)
+**     -s  clock stretch limit in usecs (default 0 = no limit)
+**     -n  percentage of address phases that are NACK'ed (default 0)
+**     -i  calls per API function (default 100)
+**     -f  use I2CMUX_PACING_FIXED (default I2CMUX_PACING_ADAPTIVE)
+**     -t  dump the transaction trace after every API function (build
+**         with -DI2CMUX_ENABLE_TRACE), for traceTool
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimBus.h"
+#include "RelaysMuxSlave.h"
+#include "../../src/I2C_RelaysMux.h"
+#include "../../src/I2C_RelaysMuxGroup.h"
+#include "../../src/I2C_RelaysMuxCommand.h"
+
+#define I2C_MUX_ADDRESS  0x48
+
+I2CMUX    relay;
+uint32_t  iterations = 100;
+uint16_t  failures   = 0;
+uint64_t  checkMicros = 0;   // time spent in check(), not measured
+bool      traceDump   = false;
+
+//--------------------------------------------------------------------------
+//-- measure 'iterations' calls of apiCall(i) in simulated time -----------
+template <typename F>
+void measure(const char *apiName, F apiCall)
+{
+  uint32_t    minMicros = UINT32_MAX, maxMicros = 0;
+  uint64_t    startMicros = simMicros();
+  uint64_t    checkBefore = checkMicros;
+  SimBusStats before = simBus.getStats();
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint64_t callStart = simMicros();
+    uint64_t checkStart = checkMicros;
+    apiCall(i);
+    uint32_t callMicros = (uint32_t)(simMicros() - callStart - (checkMicros - checkStart));
+    if (callMicros < minMicros) minMicros = callMicros;
+    if (callMicros > maxMicros) maxMicros = callMicros;
+  }
+
+  uint64_t    totalMicros = simMicros() - startMicros - (checkMicros - checkBefore);
+  SimBusStats after       = simBus.getStats();
+
+  printf("%-22s %10.1f %10.1f %10u %10u %8.2f %8.2f\n"
+          , apiName
+          , (totalMicros ? (double)iterations * 1000000.0 / totalMicros : 0.0)
+          , (double)totalMicros / iterations
+          , minMicros, maxMicros
+          , (double)(after.transactions - before.transactions) / iterations
+          , (double)(after.bytes - before.bytes) / iterations);
+  if (traceDump) relay.dumpTrace(&Serial);
+
+} // measure()
+
+
+//--------------------------------------------------------------------------
+//-- let the Slave run for msecs without it counting as API time ---------
+void settle(uint32_t msecs)
+{
+  uint64_t start = simMicros();
+  delay(msecs);
+  checkMicros += simMicros() - start;
+
+} // settle()
+
+
+//--------------------------------------------------------------------------
+//-- compare what the library reported with what is on the relay ports ---
+//-- a call that succeeded must show 'expected', one that failed must   ---
+//-- have left the relays 'unchanged'. A failed call may have reached   ---
+//-- the Slave anyway (the ack got lost), so that is only noted         ---
+void check(const char *what, bool success, uint16_t expected, uint16_t unchanged)
+{
+  //-- the Slave executes commands in its loop(), give it a moment --
+  settle(1);
+
+  uint16_t actual = simSlaveRelays();
+  if (success && actual != expected) {
+    printf("FAIL %s: expected relays[0x%04X] found[0x%04X]\n", what, expected, actual);
+    failures++;
+  }
+  else if (!success && actual != unchanged) {
+    printf("# %s failed (error %u): expected relays[0x%04X] found[0x%04X]\n"
+            , what, relay.getLastError(), unchanged, actual);
+  }
+
+} // check()
+
+//-- a state that does not follow from one call (timers, reboots ..) ------
+void check(const char *what, uint16_t expected)
+{
+  check(what, true, expected, expected);
+
+} // check()
+
+
+//--------------------------------------------------------------------------
+//-- what a console sends, for I2CMUXCommand::poll() ----------------------
+class TextStream : public Stream
+{
+public:
+  TextStream(const char *text) : _text(text) {}
+  int     available()         { return (int)strlen(_text); }
+  int     read()              { return (*_text ? *_text++ : -1); }
+  int     peek()              { return (*_text ? *_text : -1); }
+  size_t  write(uint8_t)      { return 0; }
+  using   Print::write;
+private:
+  const char *_text;
+};
+
+
+//--------------------------------------------------------------------------
+//-- parse text and check the result --------------------------------------
+I2CMUXCommand console;
+
+bool parseCheck(const char *text, uint8_t type, uint16_t setMask, uint16_t clearMask)
+{
+  console.parse(text);
+  const I2CMUX_Command &cmd = console.command();
+  if (cmd.type != type || (type == I2CMUX_CMD_RELAYS && (cmd.setMask != setMask 
+                                                     || cmd.clearMask != clearMask))) {
+    printf("FAIL parse(\"%s\"): type[%u] set[0x%04X] clear[0x%04X] error @[%u]\n"
+            , text, cmd.type, cmd.setMask, cmd.clearMask, cmd.errorPos);
+    failures++;
+    return false;
+  }
+  return true;
+
+} // parseCheck()
+
+
+//--------------------------------------------------------------------------
+//-- reboot the Slave (or cut its power) and wait until it is back -------
+bool rebootSlave(bool powerFail = false)
+{
+  I2CMUX_Errors errors;
+  relay.getErrors(errors);
+  uint32_t restarts = errors.restarts;
+  uint32_t start    = millis();
+
+  if (powerFail) simSlaveBegin();
+  else           relay.writeCommand(1<<CMD_REBOOT);
+  //-- the Slave blinks a relay until the watchdog resets it, the --
+  //-- library notices the restart on the first status it reads   --
+  do {
+    delay(10);
+    relay.getStatus();
+    relay.getErrors(errors);
+  } while (errors.restarts == restarts && (millis() - start) < 10000);
+  return (errors.restarts != restarts);
+
+} // rebootSlave()
+
+
+//--------------------------------------------------------------------------
+bool queuedOk;                      // all queued operations succeeded
+
+static void onDone(uint8_t handle, bool success, uint16_t value)
+{
+  (void)handle; (void)value;
+  if (!success) queuedOk = false;
+}
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  int       opt;
+  bool      fixedPacing = false;
+  uint32_t  busClock    = 100000;
+
+  while ((opt = getopt(argc, argv, "c:b:s:n:i:ft")) != -1) {
+    switch(opt)
+    {
+      case 'c': busClock = atol(optarg);                break;
+      case 'b': simBus.setSlaveBusyTime(atol(optarg));  break;
+      case 's': simBus.setStretchLimit(atol(optarg));   break;
+      case 'n': simBus.setNackRate(atoi(optarg));       break;
+      case 'i': iterations = atol(optarg);              break;
+      case 'f': fixedPacing = true;                     break;
+      case 't': traceDump   = true;                     break;
+      default:  fprintf(stderr, "usage: %s [-c clock] [-b busyUs] [-s stretchUs] [-n nack%%] [-i iterations] [-f] [-t]\n", argv[0]);
+                return 2;
+    }
+  }
+  if (iterations == 0) iterations = 1;
+
+  simSlaveBegin();
+  delay(100);
+
+  if (!relay.begin(Wire, I2C_MUX_ADDRESS)) {
+    printf("FAIL begin(): no virtual board @[0x%02X]\n", I2C_MUX_ADDRESS);
+    return 1;
+  }
+  Wire.setClock(busClock);    // begin() always sets 100kHz
+  relay.setPacing(fixedPacing ? I2CMUX_PACING_FIXED : I2CMUX_PACING_ADAPTIVE);
+  if (relay.getWhoAmI() != I2C_MUX_ADDRESS) failures++;
+  if (relay.getNumRelays() != 16)           failures++;
+
+  //-- the releases and the boot reason are read-only --
+  uint8_t majorRelease = relay.getMajorRelease();
+  uint8_t readOnly[]   = { I2CMUX_MAJORRELEASE, 0x77, 0x77 };
+  Wire.beginTransmission(I2C_MUX_ADDRESS);
+  Wire.write(readOnly, sizeof(readOnly));
+  Wire.endTransmission();
+  readOnly[0] = I2CMUX_BOOTREASON;
+  Wire.beginTransmission(I2C_MUX_ADDRESS);
+  Wire.write(readOnly, 2);
+  Wire.endTransmission();
+  settle(1);
+  if (relay.getMajorRelease() != majorRelease || relay.getBootReason() == 0x77) {
+    printf("FAIL read-only registers were written\n");
+    failures++;
+  }
+
+#ifdef I2CMUX_ENABLE_TRACE
+  //-- the trace must hold exactly what went over the bus --
+  I2CMUX_TraceRecord trace[I2CMUX_TRACE_SIZE];
+  relay.readTrace(trace, I2CMUX_TRACE_SIZE);
+  relay.writeAll(0x1234);
+  uint16_t traced = relay.readTrace(trace, I2CMUX_TRACE_SIZE);
+  if (traced == 0 || trace[0].type != I2CMUX_TRACE_WRITE || trace[0].reg != I2CMUX_COMMAND
+                  || trace[0].length != 4 || trace[0].payload[1] != XCMD_WRITEALL
+                  || trace[0].payload[2] != 0x34 || trace[0].payload[3] != 0x12
+                  || trace[0].address != I2C_MUX_ADDRESS || trace[0].result != I2CMUX_OK) {
+    printf("FAIL trace: %u records, first type[%u] reg[0x%02X] len[%u]\n"
+            , traced, trace[0].type, trace[0].reg, trace[0].length);
+    failures++;
+  }
+#endif
+
+  printf("# bus clock [%u Hz], pacing [%s], %u calls per API function\n"
+          , busClock, (fixedPacing ? "fixed" : "adaptive"), iterations);
+  printf("%-22s %10s %10s %10s %10s %8s %8s\n"
+          , "api", "calls/s", "avg_us", "min_us", "max_us", "trans", "bytes");
+
+  measure("isConnected",      [](uint32_t)   { relay.isConnected(); });
+  measure("getMajorRelease",  [](uint32_t)   { relay.getMajorRelease(); });
+  measure("getMinorRelease",  [](uint32_t)   { relay.getMinorRelease(); });
+  measure("getWhoAmI",        [](uint32_t)   { relay.getWhoAmI(); });
+  measure("getNumRelays",     [](uint32_t)   { relay.getNumRelays(); });
+  measure("getStatus",        [](uint32_t)   { relay.getStatus(); });
+  measure("readInfo",         [](uint32_t)   { 
+      I2CMUX_Info info;
+      if (relay.readInfo(info) && (info.whoAmI != I2C_MUX_ADDRESS 
+                                || info.numberOfRelays != 16
+                                || info.relayState != simSlaveRelays())) failures++;
+    });
+  measure("pinMode",          [](uint32_t i) { relay.pinMode((i % 16) + 1, OUTPUT); });
+
+  measure("digitalWrite",     [](uint32_t i) { 
+      uint8_t r = (i % 16) + 1;
+      uint16_t before = simSlaveRelays();
+      bool     ok = relay.digitalWrite(r, ((i / 16) & 1) ? LOW : HIGH);
+      check("digitalWrite()", ok, ((i / 16) & 1) ? (before & ~_BV(r - 1)) : (before | _BV(r - 1)), before);
+    });
+  measure("digitalRead",      [](uint32_t i) { 
+      uint8_t r = (i % 16) + 1;
+      uint8_t state;
+      if (relay.digitalRead(r, state) == I2CMUX_OK 
+                                && state != ((simSlaveRelays() >> (r - 1)) & 1)) failures++;
+    });
+  measure("writeAll",         [](uint32_t i) { 
+      uint16_t before = simSlaveRelays();
+      check("writeAll()", relay.writeAll(0xA5A5 ^ i), 0xA5A5 ^ i, before);
+    });
+  measure("readAll",          [](uint32_t)   { 
+      uint16_t relayMask;
+      if (relay.readAll(relayMask) == I2CMUX_OK && relayMask != simSlaveRelays()) failures++;
+    });
+  measure("stageAll+latch",   [](uint32_t i) { 
+      uint16_t before = simSlaveRelays();
+      bool     ok = relay.stageAll(0x0F0F ^ i) && relay.latch();
+      check("latch()", ok, 0x0F0F ^ i, before);
+    });
+  measure("stageAll+broadcast", [](uint32_t i) { 
+      uint16_t before = simSlaveRelays();
+      bool     ok = relay.stageAll(0x3C3C ^ i) && I2CMUX::broadcastLatch(Wire);
+      check("broadcastLatch()", ok, 0x3C3C ^ i, before);
+    });
+  measure("queueWriteAll+tick", [](uint32_t i) { 
+      uint16_t before = simSlaveRelays();
+      queuedOk = (relay.queueWriteAll(0x1234 ^ i, onDone) != 0);
+      while (relay.tick() > 0) delayMicroseconds(50); // simulated time only moves on request
+      check("queueWriteAll()", queuedOk, 0x1234 ^ i, before);
+    });
+  measure("queueWriteMasks+tick", [](uint32_t i) { 
+      uint16_t before = simSlaveRelays();
+      queuedOk  = (relay.queueWriteMasks(_BV(i % 16), 0, onDone) != 0);        // queued one after the other ..
+      queuedOk &= (relay.queueWriteMasks(0, _BV((i + 8) % 16), onDone) != 0);  // .. neither undoes the other
+      while (relay.tick() > 0) delayMicroseconds(50);
+      check("queueWriteMasks()", queuedOk, (before | _BV(i % 16)) & ~_BV((i + 8) % 16), before);
+    });
+
+  //-- timed switching, the Slave does the timing --
+  measure("pulse",            [](uint32_t i) { 
+      uint8_t  r = (i % 16) + 1;
+      uint16_t start  = simSlaveRelays();
+      uint16_t before = start & ~_BV(r - 1);
+      bool     ok = relay.writeAll(before) && relay.pulse(r, HIGH, 20);
+      check("pulse() on", ok, before | _BV(r - 1), start);
+      settle(25);
+      check("pulse() off", ok, before, start);
+    });
+  measure("writeDelayed",     [](uint32_t i) { 
+      uint8_t  r = (i % 16) + 1;
+      uint16_t start  = simSlaveRelays();
+      uint16_t before = start | _BV(r - 1);
+      bool     ok = relay.writeAll(before) && relay.writeDelayed(r, LOW, 20);
+      check("writeDelayed() wait", ok, before, start);
+      settle(25);
+      check("writeDelayed() off", ok, before & ~_BV(r - 1), start);
+    });
+  measure("loadRotation+start", [](uint32_t i) { 
+      relay.writeAll(0);
+      relay.loadRotation(0x8001 ^ (i << 4), 16);
+      relay.startSequence(10, 1);
+    });
+  relay.stopSchedule();
+  uint16_t seqBefore = simSlaveRelays();
+  bool     seqOk = relay.loadRotation(0x0003, 16) && relay.startSequence(10, 1);
+  check("sequence step 0", seqOk, 0x0003, seqBefore);
+  delay(10);
+  check("sequence step 1", seqOk, 0x8001, seqBefore);
+  delay(150);
+  check("sequence end", seqOk, 0x0006, seqBefore);    // after one pass the last step stays
+  relay.startSequence(10);
+  delay(25);
+  seqOk = relay.digitalWrite(16, LOW);                // a direct write stops the sequence
+  delay(1);
+  uint16_t stopped = simSlaveRelays();
+  delay(50);
+  check("sequence stopped", seqOk, stopped, stopped);
+  //-- bits above numRelays are not part of the rotation --
+  relay.stopSchedule();
+  seqBefore = simSlaveRelays();
+  seqOk = relay.loadRotation(0x0201, 8) && relay.startSequence(10, 1);
+  delay(25);
+  check("rotation of 8 step 2", seqOk, 0x0040, seqBefore);
+  delay(100);
+  check("rotation of 8 end", seqOk, 0x0002, seqBefore);
+
+  //-- event log: drain it, then every change must show up once --
+  I2CMUX_EventBlock events;
+  do {
+    relay.readEvents(events);
+  } while (events.more || relay.getLastError() != I2CMUX_OK);
+  if (simSlaveChanged()) { printf("FAIL changed line still asserted\n"); failures++; }
+  measure("digitalWrite+readEvents", [](uint32_t i) { 
+      uint8_t r = (i % 16) + 1;
+      uint16_t before = simSlaveRelays();
+      uint8_t  state = !((before >> (r - 1)) & 1);
+      I2CMUX_EventBlock events;
+      bool     ok = relay.digitalWrite(r, state);
+      check("digitalWrite()", ok, before ^ _BV(r - 1), before);   // also lets the Slave log it
+      if (!ok) {                    //-- the Slave may have logged it anyway --
+        do { relay.readEvents(events); } while (events.more || relay.getLastError() != I2CMUX_OK);
+        return;
+      }
+      if (!simSlaveChanged()) failures++;
+      if (!relay.readEvents(events)) {
+        if (!events.lost) failures++;           // the caller must fall back to readAll()
+        do { relay.readEvents(events); } while (events.more || relay.getLastError() != I2CMUX_OK);
+        return;
+      }
+      if (events.count != 1 || events.lost || events.event[0].relay != r 
+                            || events.event[0].state != state) failures++;
+      if (simSlaveChanged()) failures++;
+    });
+  relay.writeAll(0x0000);
+  relay.writeAll(0xFFFF);           // 32 changes overflow the log
+  delay(1);
+  if (relay.readEvents(events) && (!events.lost || events.count != I2CMUX_MAX_EVENTS || !events.more)) {
+    printf("FAIL readEvents() overflow: count[%u] more[%d] lost[%d]\n", events.count, events.more, events.lost);
+    failures++;
+  }
+  do {
+    relay.readEvents(events);
+  } while (events.more || relay.getLastError() != I2CMUX_OK);
+  if (events.lost || simSlaveChanged()) failures++;
+
+  //-- batch: several commands and their readback in one verified transfer --
+  measure("sendBatch",        [](uint32_t i) { 
+      I2CMUX_Batch    batch;
+      I2CMUX_BatchAck ack;
+      uint16_t mask = 0x0FF0 ^ i;
+      I2CMUX::batchBegin(batch);
+      I2CMUX::batchWriteAll(batch, mask);
+      I2CMUX::batchDigitalWrite(batch, 16, HIGH);
+      I2CMUX::batchDigitalWrite(batch, 1, LOW);
+      I2CMUX::batchDigitalRead(batch, 16);
+      I2CMUX::batchDigitalRead(batch, 1);
+      mask = (mask | 0x8000) & ~0x0001;
+      uint16_t before = simSlaveRelays();
+      bool     ok = relay.sendBatch(batch, ack);
+      if (ok && (ack.commands != 5 || ack.readStates != 0x01 || ack.relayState != mask)) failures++;
+      check("sendBatch()", ok, mask, before);
+    });
+  //-- a damaged frame is not executed --
+  relay.writeAll(0x0000);
+  uint8_t badFrame[] = { I2CMUX_BATCH, 0x55, 4, _BV(CMD_EXTENDED), XCMD_WRITEALL, 0xFF, 0xFF, 0x00 };
+  uint8_t batchAck[I2CMUX_BATCHACK_SIZE] = { 0 };
+  for (uint8_t t = 0; t < 5; t++) {
+    Wire.beginTransmission(I2C_MUX_ADDRESS);
+    Wire.write(badFrame, sizeof(badFrame));
+    if (Wire.endTransmission() == 0) break;
+  }
+  settle(1);
+  for (uint8_t t = 0; t < 5 && batchAck[1] != 0x55; t++) {
+    Wire.beginTransmission(I2C_MUX_ADDRESS);
+    Wire.write(I2CMUX_BATCH);
+    if (Wire.endTransmission() != 0) continue;
+    Wire.requestFrom((uint8_t)I2C_MUX_ADDRESS, (uint8_t)I2CMUX_BATCHACK_SIZE);
+    for (uint8_t b = 0; b < I2CMUX_BATCHACK_SIZE && Wire.available(); b++) batchAck[b] = Wire.read();
+  }
+  if (batchAck[1] != 0x55 || batchAck[2] != I2CMUX_BATCH_BADCRC) {
+    printf("FAIL damaged batch: seq[0x%02X] result[%u]\n", batchAck[1], batchAck[2]);
+    failures++;
+  }
+  check("damaged batch", 0x0000);
+
+  //-- a group: a second discover() (after a bus recovery) adds nothing --
+  I2CMUXGroup group;
+  group.discover(Wire, 0x40, 0x4F);
+  if (group.discover(Wire, 0x40, 0x4F) != 1 || group.addBoard(Wire, I2C_MUX_ADDRESS)
+                                            || group.getNumRelays() != 16) {
+    printf("FAIL group: boards[%u] relays[%u]\n", group.getNumBoards(), group.getNumRelays());
+    failures++;
+  }
+
+  //-- console commands: parsed without String's, one write each --
+  console.addScene("night", 0x8000, 0x00FF);
+  parseCheck("3=1",             I2CMUX_CMD_RELAYS, 0x0004, 0x0000);
+  parseCheck(" All=0  1-4,7=1", I2CMUX_CMD_RELAYS, 0x004F, 0xFFB0);
+  parseCheck("mask=0x0F0F",     I2CMUX_CMD_RELAYS, 0x0F0F, 0xF0F0);
+  parseCheck("@night 2=1",      I2CMUX_CMD_RELAYS, 0x8002, 0x00FD);
+  parseCheck("17=1",            I2CMUX_CMD_ERROR,  0, 0);
+  parseCheck("4-2=1",           I2CMUX_CMD_ERROR,  0, 0);
+  parseCheck("3=2",             I2CMUX_CMD_ERROR,  0, 0);
+  parseCheck("1,=1",            I2CMUX_CMD_ERROR,  0, 0);
+  parseCheck("@day",            I2CMUX_CMD_ERROR,  0, 0);
+  parseCheck("1=1 status",      I2CMUX_CMD_ERROR,  0, 0);
+  parseCheck("1=1;\r\n",         I2CMUX_CMD_RELAYS, 0x0001, 0x0000);
+  if (parseCheck("1=1;2=1",     I2CMUX_CMD_ERROR,  0, 0) && console.command().errorPos != 4) failures++;
+  parseCheck("0123456789012345678901234567890123456789012345678901234567890123456789=1"
+                              , I2CMUX_CMD_ERROR,  0, 0);
+  if (parseCheck("Pulse=2000",  I2CMUX_CMD_WORD,   0, 0) 
+      && (strcmp(console.command().word, "pulse") != 0 || console.command().value != 2000)) {
+    printf("FAIL parse(\"Pulse=2000\"): word[%s] value[%d]\n", console.command().word, console.command().value);
+    failures++;
+  }
+  if (parseCheck("status",      I2CMUX_CMD_WORD,   0, 0) && console.command().value != -1) failures++;
+
+  TextStream typed("1-2,5=1;\r\nstatus;\n\n16=1");
+  uint16_t pollBefore = simSlaveRelays();
+  if (!console.poll(typed)) failures++;
+  check("poll() 1-2,5=1", console.apply(relay), 0x0013, pollBefore);
+  if (!console.poll(typed) || console.command().type != I2CMUX_CMD_WORD) failures++;
+  if (console.poll(typed) || !console.feed('\n')) failures++;
+  pollBefore = simSlaveRelays();
+  check("poll() 16=1", console.apply(relay), pollBefore | 0x8000, pollBefore);
+
+  relay.writeAll(0x0F0F);
+  measure("command 1 relay",  [](uint32_t i)  { 
+      uint16_t before = simSlaveRelays();
+      console.parse((i & 1) ? "9=0" : "9=1");
+      check("command 1 relay", console.apply(relay), (i & 1) ? 0x0E0F : 0x0F0F, before);
+    });
+  measure("command all",      [](uint32_t i)  { 
+      uint16_t before = simSlaveRelays();
+      console.parse((i & 1) ? "@night 2=1" : "mask=0x0F0F");
+      check("command all", console.apply(relay), (i & 1) ? 0x8F02 : 0x0F0F, before);
+    });
+  relay.writeAll(0x0F0F);
+  measure("command some",     [](uint32_t i)  { 
+      uint16_t before = simSlaveRelays();
+      console.parse((i & 1) ? "1-4=1 8-9=0" : "1-4=0 8-9=1");
+      check("command some", console.apply(relay), (i & 1) ? 0x0E0F : 0x0F80, before);
+    });
+
+  relay.enableCache(1000);
+  measure("readAll (cached)", [](uint32_t)   { relay.readAll(); });
+  uint16_t cachedMask = simSlaveRelays();
+  measure("digitalWrite (cached)", [&cachedMask](uint32_t i) { 
+      relay.digitalWrite((i % 16) + 1, HIGH); 
+      cachedMask |= _BV(i % 16);
+    });
+  relay.disableCache();
+  check("cache", cachedMask);
+
+  //-- a coalesced write goes out before a timed command, not after it --
+  relay.writeAll(0x0000);
+  relay.enableCache(1000, true);
+  bool coalesceOk = relay.digitalWrite(1, HIGH) && relay.pulse(2, HIGH, 20);
+  check("coalesced write + pulse() on", coalesceOk, 0x0003, 0x0000);
+  settle(25);
+  relay.readAll();
+  check("coalesced write + pulse() off", coalesceOk, 0x0001, 0x0000);
+  relay.disableCache();
+
+  //-- commands the Slave had no room for are sent again, not lost --
+  I2CMUX_Errors errors;
+  uint8_t writeConf[] = { I2CMUX_COMMAND, 1<<CMD_WRITECONF };   // the library does not know ..
+  relay.writeAll(0x0000);
+  relay.setNumRelays(8);            // so the config in EEPROM changes
+  relay.getStatus();
+  relay.setNumRelays(16);
+  relay.getStatus();
+  relay.resetErrors();
+  Wire.beginTransmission(I2C_MUX_ADDRESS);
+  Wire.write(writeConf, sizeof(writeConf));
+  Wire.endTransmission();
+  uint16_t overrunBefore = simSlaveRelays();
+  bool     overrunOk     = true;
+  for (uint8_t r = 1; r <= 8; r++) {                            // .. that the Slave is busy
+    overrunOk &= relay.digitalWrite(r, HIGH);
+  }
+  check("queue overrun", overrunOk, overrunBefore | 0x00FF, overrunBefore);
+  relay.getErrors(errors);
+  //-- fixed pacing is slow enough for the Slave to keep up --
+  if (errors.overruns == 0 && !fixedPacing) { printf("FAIL no overrun seen\n"); failures++; }
+
+  //-- a General Call latch needs no room in the queue of a busy Slave --
+  relay.setNumRelays(8);
+  relay.getStatus();
+  relay.setNumRelays(16);
+  bool latchOk = relay.stageAll(0xA5A5);
+  relay.getStatus();
+  for (uint8_t m = 0; m < 3; m++) {
+    Wire.beginTransmission(I2C_MUX_ADDRESS);
+    Wire.write(writeConf, sizeof(writeConf));
+    Wire.endTransmission();
+  }
+  uint16_t latchBefore = simSlaveRelays();
+  latchOk &= I2CMUX::broadcastLatch(Wire);
+  settle(100);
+  check("latch on a full queue", latchOk, 0xA5A5, latchBefore);
+
+  uint32_t saveIterations = iterations;
+  iterations = 1;
+  measure("writeConfig",      [](uint32_t)   { relay.writeCommand(1<<CMD_WRITECONF); relay.getStatus(); });
+  measure("setNumRelays",     [](uint32_t)   { relay.setNumRelays(16); relay.getStatus(); });
+  measure("writeConfig (same)", [](uint32_t)  { relay.writeCommand(1<<CMD_WRITECONF); relay.getStatus(); });
+  relay.setNumRelays(8);            // must survive the reboot
+  relay.getStatus();
+  relay.setPowerOnState(I2CMUX_POWERON_MASK, 0x00A5);
+  relay.writeAll(0x000F);
+  relay.resetErrors();
+  measure("reboot",           [](uint32_t)   { if (!rebootSlave()) failures++; });
+  if (relay.getNumRelays() != 8) { printf("FAIL config lost after reboot\n"); failures++; }
+  check("power-on mask", 0x00A5);
+  if (!(relay.getBootReason() & I2CMUX_BOOT_WATCHDOG)) { printf("FAIL boot reason\n"); failures++; }
+  relay.setNumRelays(16);
+  relay.getStatus();
+
+  //-- the last relay state is saved once it lasts, every 10 minutes at most --
+  uint8_t  powerOnMode;
+  uint16_t powerOnMask;
+  relay.setPowerOnState(I2CMUX_POWERON_LAST);
+  relay.writeAll(0x4321);
+  settle(6000);
+  relay.writeAll(0x1234);           // a state that does not last is not saved
+  settle(6000);
+  if (!relay.getPowerOnState(powerOnMode, powerOnMask) || powerOnMask == 0x4321
+                                                       || powerOnMask == 0x1234) failures++;
+  settle(5000);
+  if (!relay.getPowerOnState(powerOnMode, powerOnMask) || powerOnMode != I2CMUX_POWERON_LAST
+                                                       || powerOnMask != 0x1234) failures++;
+  rebootSlave();
+  check("power-on last state", 0x1234);
+  relay.setPowerOnState(I2CMUX_POWERON_OFF);
+
+  //-- relay wear: counted in RAM, saved to EEPROM now and then --
+  I2CMUX_CycleCounters counters;
+  relay.resetCycleCounters();
+  relay.writeAll(0x0000);
+  for (uint8_t n = 0; n < 3; n++) {
+    relay.digitalWrite(5, HIGH);
+    settle(2000);
+    relay.digitalWrite(5, LOW);
+  }
+  relay.pulse(7, HIGH, 1500);
+  settle(2000);
+  measure("readCycleCounters", [&counters](uint32_t) { 
+      if (!relay.readCycleCounters(counters)) failures++; 
+    });
+  if (counters.numRelays != 16 || counters.cycles[4] != 3 || counters.cycles[6] != 1
+                               || counters.cycles[0] != 0 || counters.onSeconds[4] < 5 
+                               || counters.onSeconds[4] > 6 || counters.onSeconds[6] != 1) {
+    printf("FAIL cycle counters: relay 5 [%u, %us] relay 7 [%u, %us]\n"
+          , counters.cycles[4], counters.onSeconds[4], counters.cycles[6], counters.onSeconds[6]);
+    failures++;
+  }
+  rebootSlave();                    // the Slave saves them before it reboots
+  if (relay.readCycleCounters(counters) && (counters.cycles[4] != 3 || counters.cycles[6] != 1)) {
+    printf("FAIL cycle counters lost after reboot\n");
+    failures++;
+  }
+  relay.digitalWrite(5, HIGH);
+  relay.digitalWrite(5, LOW);
+  settle(905000);                   // saved in the background
+  relay.digitalWrite(5, HIGH);      // not yet saved ..
+  relay.digitalWrite(5, LOW);
+  settle(10);
+  rebootSlave(true);                // .. when the power fails
+  if (!relay.readCycleCounters(counters) || counters.cycles[4] != 4 || counters.cycles[6] != 1) {
+    printf("FAIL cycle counters after power fail: relay 5 [%u]\n", counters.cycles[4]);
+    failures++;
+  }
+  relay.resetCycleCounters(5);
+  if (!relay.readCycleCounters(counters) || counters.cycles[4] != 0 || counters.onSeconds[4] != 0
+                                         || counters.cycles[6] != 1) {
+    printf("FAIL resetCycleCounters()\n");
+    failures++;
+  }
+  iterations = saveIterations;
+
+  relay.getErrors(errors);
+  if (errors.restarts != 4) { printf("FAIL %u restarts seen\n", errors.restarts); failures++; }
+  printf("# errors: %u nacks, %u bus, %u short reads, %u busy, %u overruns, %u retries, %u failures, %u restarts\n"
+          , errors.nacks, errors.busErrors, errors.shortReads, errors.busyTimeouts, errors.overruns
+          , errors.retries, errors.failures, errors.restarts);
+
+  const SimBusStats &stats = simBus.getStats();
+  printf("# bus: %u transactions, %u bytes, %u nacks, %u stretches, %u resets, %.1f%% busy\n"
+          , stats.transactions, stats.bytes, stats.nacks, stats.stretches, stats.resets
+          , (simMicros() ? 100.0 * stats.busMicros / simMicros() : 0.0));
+
+  if (failures > 0) {
+    printf("# %u FAILURES\n", failures);
+    return 1;
+  }
+  return 0;
+
+} // main()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
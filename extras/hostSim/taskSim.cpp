@@ -0,0 +1,258 @@
+/*
+***************************************************************************
+**
+**  Program     : taskSim
+**  Version     : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Drives the virtual RelaysMux board from several threads at once, like
+**  the web, MQTT and scheduler tasks of an ESP32 would:
+**   - producer threads submit digitalWrite()'s (and readAll()'s) for
+**     their own relays to one I2CMUXWorker,
+**   - the worker thread does all their bus I/O,
+**   - a "direct" thread uses a second I2CMUX on the same bus, kept apart
+**     from the worker by the bus lock.
+**  Afterwards every relay must be in the state its owner wrote last,
+**  every request must have been served (and called back) exactly once
+**  and no thread may ever have got into another thread's transaction.
+**
+**  Build with -DI2CMUX_ENABLE_TASKS -pthread (see README.md)
+**
+**  Usage: taskSim [-p producers] [-i requests] [-n nack%] [-q]
+**     -p  producer threads, 1..4 (default 4): they own 3 relays each
+**     -i  requests per producer (default 200)
+**     -n  percentage of address phases that are NACK'ed (default 0)
+**     -q  start the worker late: producers must wait for free slots
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimBus.h"
+#include "RelaysMuxSlave.h"
+#include "../../src/I2C_RelaysMux.h"
+#include "../../src/I2C_RelaysMuxWorker.h"
+
+#ifndef I2CMUX_ENABLE_TASKS
+  #error "build taskSim with -DI2CMUX_ENABLE_TASKS -pthread"
+#endif
+
+#define I2C_MUX_ADDRESS   0x48
+#define RELAYS_PER_TASK   3         // producer p owns relay 3p+1 .. 3p+3
+#define DIRECT_FIRST      13        // the direct thread owns relay 13 .. 16
+#define DIRECT_RELAYS     4
+#define MAX_PRODUCERS     ((DIRECT_FIRST - 1) / RELAYS_PER_TASK)
+
+I2CMUX        workerBoard;          // only used by the worker thread
+I2CMUX        directBoard;          // only used by the direct thread
+I2CMUXWorker  worker;
+
+uint8_t       producers  = 4;
+uint32_t      requests   = 200;
+uint8_t       nackRate   = 0;
+uint16_t      failures   = 0;
+
+std::atomic<uint32_t> callbacks(0), failed(0), waited(0), directFailed(0);
+std::atomic<bool>     lastFailed[17];     // the last write of relay 1 .. 16
+
+//--------------------------------------------------------------------------
+//-- the value owner writes to its n-th request (alternating per relay) ---
+static byte writeValue(uint32_t n, uint8_t relays)
+{
+  return (((n / relays) & 1) ? LOW : HIGH);
+}
+
+//--------------------------------------------------------------------------
+//-- called from the worker thread ----------------------------------------
+static void onDone(uint8_t handle, bool success, uint16_t value)
+{
+  (void)handle; (void)value;
+  callbacks++;
+  if (!success) failed++;
+}
+
+//-- the worker serves the writes of a relay in order, so the last --
+//-- call back of relay R is for the last write to it ---------------
+template <uint8_t R>
+static void onRelayDone(uint8_t handle, bool success, uint16_t value)
+{
+  onDone(handle, success, value);
+  lastFailed[R] = !success;
+}
+
+static const I2CMUX_callback relayDone[17] = { NULL
+      , onRelayDone<1>,  onRelayDone<2>,  onRelayDone<3>,  onRelayDone<4>
+      , onRelayDone<5>,  onRelayDone<6>,  onRelayDone<7>,  onRelayDone<8>
+      , onRelayDone<9>,  onRelayDone<10>, onRelayDone<11>, onRelayDone<12>
+      , onRelayDone<13>, onRelayDone<14>, onRelayDone<15>, onRelayDone<16> };
+
+//--------------------------------------------------------------------------
+static void producerTask(uint8_t p)
+{
+  for (uint32_t n = 0; n < requests; n++) {
+    uint8_t relayNr = (p * RELAYS_PER_TASK) + (n % RELAYS_PER_TASK) + 1;
+    if (worker.submitDigitalWrite(workerBoard, relayNr
+                                 , writeValue(n, RELAYS_PER_TASK), relayDone[relayNr]) == 0) {
+      waited++;
+      while (worker.submitDigitalWrite(workerBoard, relayNr
+                                      , writeValue(n, RELAYS_PER_TASK), relayDone[relayNr]) == 0) {
+        std::this_thread::yield();
+      }
+    }
+    if ((n % 16) == 15) {
+      if (worker.submitReadAll(workerBoard, onDone) == 0) {
+        waited++;
+        while (worker.submitReadAll(workerBoard, onDone) == 0) std::this_thread::yield();
+      }
+    }
+  }
+
+} // producerTask()
+
+//--------------------------------------------------------------------------
+static void directTask()
+{
+  for (uint32_t n = 0; n < requests; n++) {
+    uint8_t relayNr = DIRECT_FIRST + (n % DIRECT_RELAYS);
+    bool    success = directBoard.digitalWrite(relayNr, writeValue(n, DIRECT_RELAYS));
+    if (!success) directFailed++;
+    lastFailed[relayNr] = !success;
+  }
+
+} // directTask()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  int       opt;
+  bool      smallQueue = false;
+
+  while ((opt = getopt(argc, argv, "p:i:n:q")) != -1) {
+    switch(opt)
+    {
+      case 'p': producers = atoi(optarg);               break;
+      case 'i': requests  = atol(optarg);               break;
+      case 'n': nackRate  = atoi(optarg);               break;
+      case 'q': smallQueue = true;                      break;
+      default:  fprintf(stderr, "usage: %s [-p producers] [-i requests] [-n nack%%] [-q]\n", argv[0]);
+                return 2;
+    }
+  }
+  if (producers < 1 || producers > MAX_PRODUCERS) {
+    fprintf(stderr, "-p: 1 .. %u producers (there are 16 relays)\n", MAX_PRODUCERS);
+    return 2;
+  }
+  if (requests  < 1) requests  = 1;
+
+  simSlaveBegin();
+  delay(100);
+  simBus.setNackRate(nackRate);
+
+  if (!workerBoard.begin(Wire, I2C_MUX_ADDRESS) || !directBoard.begin(Wire, I2C_MUX_ADDRESS)) {
+    printf("FAIL begin(): no virtual board @[0x%02X]\n", I2C_MUX_ADDRESS);
+    return 1;
+  }
+  for (uint8_t r = 1; r <= 16; r++) workerBoard.pinMode(r, OUTPUT);
+  workerBoard.writeAll(0);
+
+  //-- with -q the worker only starts when the queue has been full --
+  if (!smallQueue) worker.begin();
+
+  std::thread threads[MAX_PRODUCERS + 1];
+  for (uint8_t p = 0; p < producers; p++) threads[p] = std::thread(producerTask, p);
+  threads[producers] = std::thread(directTask);
+
+  if (smallQueue) {
+    while (waited.load() == 0) std::this_thread::yield();
+    worker.begin();
+  }
+  for (uint8_t t = 0; t <= producers; t++) threads[t].join();
+  while (worker.pending() > 0) delay(1);
+  worker.end();
+  delay(10);    // the Slave switches the last relays in its loop()
+
+  //-- every relay must be in the state its owner wrote last --
+  uint16_t expected = 0;
+  for (uint8_t p = 0; p < producers; p++) {
+    for (uint8_t r = 0; r < RELAYS_PER_TASK && r < requests; r++) {
+      uint32_t last = requests - 1 - ((requests - 1 - r) % RELAYS_PER_TASK);
+      if (writeValue(last, RELAYS_PER_TASK) == HIGH) expected |= _BV((p * RELAYS_PER_TASK) + r);
+    }
+  }
+  for (uint8_t r = 0; r < DIRECT_RELAYS && r < requests; r++) {
+    uint32_t last = requests - 1 - ((requests - 1 - r) % DIRECT_RELAYS);
+    if (writeValue(last, DIRECT_RELAYS) == HIGH) expected |= _BV(DIRECT_FIRST - 1 + r);
+  }
+  //-- with NACKs a request may fail after all retries, its owner  --
+  //-- would have to try again, so its relay can be in either state --
+  uint16_t checked = 0;
+  for (uint8_t r = 1; r <= 16; r++) {
+    if (!lastFailed[r]) checked |= _BV(r - 1);
+  }
+  bool     anyFailed = (failed.load() > 0 || directFailed.load() > 0);
+  uint16_t actual    = simSlaveRelays();
+  if ((actual & checked) != (expected & checked)) {
+    printf("FAIL relays: expected[0x%04X] found[0x%04X] (checked[0x%04X])\n", expected, actual, checked);
+    failures++;
+  }
+
+  I2CMUX_WorkerStats stats;
+  worker.getStats(stats);
+  SimBusStats        bus = simBus.getStats();
+  printf("# %u producers x %u requests, 1 direct thread, %u%% NACK\n", producers, requests, nackRate);
+  printf("submitted[%u] served[%u] failed[%u] refused[%u] waited[%u] callbacks[%u] directFailed[%u]\n"
+          , stats.submitted, stats.served, stats.failed, stats.refused, waited.load()
+          , callbacks.load(), directFailed.load());
+  printf("transactions[%u] nacks[%u] collisions[%u]\n", bus.transactions, bus.nacks, bus.collisions);
+  if (bus.collisions > 0) {
+    printf("FAIL bus: %u transactions were mixed up\n", bus.collisions);
+    failures++;
+  }
+  if (stats.served != stats.submitted || callbacks.load() != stats.submitted) {
+    printf("FAIL worker: not every request was served once\n");
+    failures++;
+  }
+  if (anyFailed && nackRate == 0) {
+    printf("FAIL %u worker and %u direct requests failed\n", failed.load(), directFailed.load());
+    failures++;
+  }
+  if (smallQueue && waited.load() == 0) {
+    printf("FAIL queue: never full\n");
+    failures++;
+  }
+
+  printf("%s\n", (failures == 0 ? "OK" : "FAILED"));
+  return (failures == 0 ? 0 : 1);
+
+} // main()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,434 @@
+/*
+***************************************************************************
+**
+**  Program     : traceTool (part of hostSim)
+**  Version     : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Decodes the transaction trace that I2CMUX::dumpTrace() prints (the
+**  "#T" lines, everything else in the file is skipped, so a whole
+**  Serial log will do), reports latency histograms, per register
+**  figures and the bus utilization, and can replay the trace against
+**  the virtual RelaysMux board with the recorded timing to reproduce
+**  a problem offline.
+**
+**  Usage: traceTool [-d] [-r] [-c clock] [-b busyUs] [-s stretchUs] file
+**     -d  print every transaction (and, with -r, every mismatch)
+**     -r  replay the trace against the virtual board
+**     -c  I2C clock in Hz for the replay (default: from the trace)
+**     -b  Slave processing time per message in usecs (default 0)
+**     -s  clock stretch limit in usecs (default 0 = no limit)
+**  All transactions are replayed to the one virtual board, whatever
+**  address they were recorded for.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimBus.h"
+#include "RelaysMuxSlave.h"
+#include "../../src/I2C_RelaysMux.h"
+
+#define MAX_RECORDS     65536
+#define HIST_BUCKETS    16        // < 8us, < 16us .. < 256ms
+
+static I2CMUX_TraceRecord trace[MAX_RECORDS];
+static uint32_t           numRecords = 0;
+static uint32_t           lostRecords = 0;
+static uint32_t           traceClock = 100000;
+static bool               verbose    = false;
+
+//--------------------------------------------------------------------------
+static const char *regName(uint8_t reg)
+{
+  switch(reg)
+  {
+    case I2CMUX_STATUS:          return "STATUS";
+    case I2CMUX_MAJORRELEASE:    return "MAJORRELEASE";
+    case I2CMUX_MINORRELEASE:    return "MINORRELEASE";
+    case I2CMUX_LASTGPIOSTATE:   return "LASTGPIOSTATE";
+    case I2CMUX_WHOAMI:          return "WHOAMI";
+    case I2CMUX_NUMBEROFRELAYS:  return "NUMBEROFRELAYS";
+    case I2CMUX_RELAYSTATE:      return "RELAYSTATE";
+    case I2CMUX_BOOTREASON:      return "BOOTREASON";
+    case I2CMUX_POWERONMODE:     return "POWERONMODE";
+    case I2CMUX_POWERONMASK:     return "POWERONMASK";
+    case I2CMUX_COMMAND:         return "COMMAND";
+    case I2CMUX_LATCH:           return "LATCH";
+    case I2CMUX_EVENTS:          return "EVENTS";
+    case I2CMUX_BATCH:           return "BATCH";
+    case I2CMUX_CYCLES:          return "CYCLES";
+  }
+  return "?";
+}
+
+//--------------------------------------------------------------------------
+static const char *resultName(uint8_t result)
+{
+  switch(result)
+  {
+    case I2CMUX_OK:              return "ok";
+    case I2CMUX_ERR_NACK_ADDR:   return "nack-addr";
+    case I2CMUX_ERR_NACK_DATA:   return "nack-data";
+    case I2CMUX_ERR_BUS:         return "bus-error";
+    case I2CMUX_ERR_SHORT_READ:  return "short-read";
+  }
+  return "?";
+}
+
+//--------------------------------------------------------------------------
+static uint8_t hexNibble(char c)
+{
+  if (c >= '0' && c <= '9') return (c - '0');
+  if (c >= 'a' && c <= 'f') return (c - 'a' + 10);
+  if (c >= 'A' && c <= 'F') return (c - 'A' + 10);
+  return 0xFF;
+}
+
+
+//==========================================================================
+//== read the trace ========================================================
+//==========================================================================
+
+// "#T " followed by 40 hex digits, little endian in I2CMUX_TraceRecord order
+//--------------------------------------------------------------------------
+static bool decodeLine(const char *hex, I2CMUX_TraceRecord &rec)
+{
+  uint8_t raw[12 + I2CMUX_TRACE_PAYLOAD];
+
+  for (uint8_t i = 0; i < sizeof(raw); i++) {
+    uint8_t hi = hexNibble(hex[2 * i]);
+    uint8_t lo = (hi == 0xFF ? 0xFF : hexNibble(hex[(2 * i) + 1]));
+    if (lo == 0xFF) return false;
+    raw[i] = (hi << 4) | lo;
+  }
+  rec.timestamp = (uint32_t)raw[0] | (uint32_t)raw[1] << 8 | (uint32_t)raw[2] << 16 | (uint32_t)raw[3] << 24;
+  rec.duration  = (uint16_t)raw[4] | (uint16_t)raw[5] << 8;
+  rec.address   = raw[6];
+  rec.type      = raw[7];
+  rec.reg       = raw[8];
+  rec.result    = raw[9];
+  rec.length    = raw[10];
+  rec.attempt   = raw[11];
+  memcpy(rec.payload, &raw[12], I2CMUX_TRACE_PAYLOAD);
+  return (rec.type <= I2CMUX_TRACE_PROBE);
+
+} // decodeLine()
+
+//--------------------------------------------------------------------------
+static bool readTraceFile(const char *fileName)
+{
+  char      line[256];
+  uint32_t  badLines = 0;
+  FILE      *fp = fopen(fileName, "r");
+
+  if (fp == NULL) {
+    perror(fileName);
+    return false;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    unsigned  records, lost, clock;
+    if (sscanf(line, "#TRACE v1 records[%u] lost[%u] clock[%u]", &records, &lost, &clock) == 3) {
+      lostRecords += lost;
+      traceClock   = clock;
+      continue;
+    }
+    if (strncmp(line, "#T ", 3) != 0) continue;
+    if (numRecords >= MAX_RECORDS) {
+      lostRecords++;
+      continue;
+    }
+    if (decodeLine(&line[3], trace[numRecords])) numRecords++;
+    else                                         badLines++;
+  }
+  fclose(fp);
+  if (badLines > 0) printf("# %u damaged trace lines skipped\n", badLines);
+  return true;
+
+} // readTraceFile()
+
+
+//==========================================================================
+//== analysis ==============================================================
+//==========================================================================
+
+struct Histogram {
+  uint32_t  bucket[HIST_BUCKETS];
+  uint32_t  count;
+  uint64_t  total;
+  uint32_t  maxMicros;
+};
+
+//--------------------------------------------------------------------------
+static void histAdd(Histogram &hist, uint32_t micros)
+{
+  uint8_t b = 0;
+  while (b < (HIST_BUCKETS - 1) && micros >= ((uint32_t)8 << b)) b++;
+  hist.bucket[b]++;
+  hist.count++;
+  hist.total += micros;
+  if (micros > hist.maxMicros) hist.maxMicros = micros;
+}
+
+//--------------------------------------------------------------------------
+static void histPrint(const char *title, const Histogram &hist)
+{
+  uint32_t most = 1;
+
+  printf("# %s: %u transactions, avg %.1f us, max %u us\n"
+          , title, hist.count, (hist.count ? (double)hist.total / hist.count : 0.0), hist.maxMicros);
+  for (uint8_t b = 0; b < HIST_BUCKETS; b++) {
+    if (hist.bucket[b] > most) most = hist.bucket[b];
+  }
+  for (uint8_t b = 0; b < HIST_BUCKETS; b++) {
+    if (hist.bucket[b] == 0) continue;
+    char bar[41];
+    uint8_t len = (uint8_t)((hist.bucket[b] * 40ULL + most - 1) / most);
+    memset(bar, '#', len);
+    bar[len] = '\0';
+    if (b < (HIST_BUCKETS - 1)) printf("  < %6u us %8u %s\n", (8u << b), hist.bucket[b], bar);
+    else                        printf("  >=%6u us %8u %s\n", (8u << (b - 1)), hist.bucket[b], bar);
+  }
+
+} // histPrint()
+
+//--------------------------------------------------------------------------
+static void printRecord(uint32_t i, const I2CMUX_TraceRecord &rec)
+{
+  static const char typeChar[] = "WRP";
+
+  printf("%6u +%10u us 0x%02X %c %-14s len[%2u]"
+          , i, rec.timestamp - trace[0].timestamp, rec.address
+          , typeChar[rec.type], (rec.type == I2CMUX_TRACE_PROBE ? "-" : regName(rec.reg)), rec.length);
+  for (uint8_t b = 0; b < I2CMUX_TRACE_PAYLOAD; b++) {
+    if (b < rec.length) printf(" %02x", rec.payload[b]);
+    else                printf("   ");
+  }
+  printf(" %-10s %5u us", resultName(rec.result), rec.duration);
+  if (rec.attempt > 0) printf(" retry %u", rec.attempt);
+  printf("\n");
+
+} // printRecord()
+
+//--------------------------------------------------------------------------
+static void analyze()
+{
+  Histogram all, perType[3];
+  uint32_t  regCount[256], regFail[256], regMax[256];
+  uint64_t  regTotal[256];
+  uint32_t  results[8], retries = 0;
+  uint64_t  busy = 0;
+  uint32_t  longestGap = 0, gapAt = 0;
+
+  memset(&all, 0, sizeof(all));
+  memset(perType, 0, sizeof(perType));
+  memset(regCount, 0, sizeof(regCount));
+  memset(regFail, 0, sizeof(regFail));
+  memset(regMax, 0, sizeof(regMax));
+  memset(regTotal, 0, sizeof(regTotal));
+  memset(results, 0, sizeof(results));
+
+  for (uint32_t i = 0; i < numRecords; i++) {
+    const I2CMUX_TraceRecord &rec = trace[i];
+    if (verbose) printRecord(i, rec);
+    histAdd(all, rec.duration);
+    histAdd(perType[rec.type], rec.duration);
+    uint8_t reg = (rec.type == I2CMUX_TRACE_PROBE ? 0xFF : rec.reg);
+    regCount[reg]++;
+    regTotal[reg] += rec.duration;
+    if (rec.duration > regMax[reg]) regMax[reg] = rec.duration;
+    if (rec.result != I2CMUX_OK) regFail[reg]++;
+    results[rec.result < 7 ? rec.result : 7]++;
+    if (rec.attempt > 0) retries++;
+    busy += rec.duration;
+    if (i > 0) {
+      uint32_t gap = rec.timestamp - (trace[i - 1].timestamp + trace[i - 1].duration);
+      if ((int32_t)gap > (int32_t)longestGap) {
+        longestGap = gap;
+        gapAt      = i;
+      }
+    }
+  }
+
+  uint32_t span = trace[numRecords - 1].timestamp + trace[numRecords - 1].duration - trace[0].timestamp;
+  printf("# trace: %u transactions (%u lost), %u us, recorded at %u Hz\n"
+          , numRecords, lostRecords, span, traceClock);
+  printf("# bus utilization: %llu us busy, %.1f%%, longest idle %u us (before #%u)\n"
+          , (unsigned long long)busy, (span ? 100.0 * busy / span : 0.0), longestGap, gapAt);
+  printf("# results: %u ok, %u nack-addr, %u nack-data, %u bus-error, %u short-read, %u retries\n"
+          , results[I2CMUX_OK], results[I2CMUX_ERR_NACK_ADDR], results[I2CMUX_ERR_NACK_DATA]
+          , results[I2CMUX_ERR_BUS], results[I2CMUX_ERR_SHORT_READ], retries);
+
+  histPrint("all", all);
+  histPrint("writes", perType[I2CMUX_TRACE_WRITE]);
+  histPrint("reads", perType[I2CMUX_TRACE_READ]);
+  if (perType[I2CMUX_TRACE_PROBE].count > 0) histPrint("probes", perType[I2CMUX_TRACE_PROBE]);
+
+  printf("# %-14s %8s %8s %8s %8s\n", "register", "count", "avg_us", "max_us", "failed");
+  for (uint16_t reg = 0; reg < 256; reg++) {
+    if (regCount[reg] == 0) continue;
+    printf("  %-14s %8u %8.1f %8u %8u\n"
+            , (reg == 0xFF ? "(probe)" : regName(reg)), regCount[reg]
+            , (double)regTotal[reg] / regCount[reg], regMax[reg], regFail[reg]);
+  }
+
+} // analyze()
+
+
+//==========================================================================
+//== replay ================================================================
+//==========================================================================
+
+// Do rec again on the simulated bus, returns the I2CMUX result
+//--------------------------------------------------------------------------
+static uint8_t replayOne(const I2CMUX_TraceRecord &rec, uint8_t address, uint8_t *data, uint8_t &received)
+{
+  uint8_t wireResult;
+
+  received = 0;
+  Wire.beginTransmission(address);
+  if (rec.type != I2CMUX_TRACE_PROBE) Wire.write(rec.reg);
+  if (rec.type == I2CMUX_TRACE_WRITE) Wire.write(rec.payload, rec.length);
+  wireResult = Wire.endTransmission();
+  if (wireResult == 2) return (I2CMUX_ERR_NACK_ADDR);
+  if (wireResult == 3) return (I2CMUX_ERR_NACK_DATA);
+  if (wireResult != 0) return (I2CMUX_ERR_BUS);
+  if (rec.type != I2CMUX_TRACE_READ) return (I2CMUX_OK);
+
+  uint8_t want = (rec.length > 0 ? rec.length : 1);
+  Wire.requestFrom(address, want);
+  while (Wire.available() && received < want) {
+    data[received++] = Wire.read();
+  }
+  return (received < want ? I2CMUX_ERR_SHORT_READ : I2CMUX_OK);
+
+} // replayOne()
+
+// Replays every transaction at the same offset from the first one as it
+// was recorded. The virtual board runs its loop() while we wait, so a
+// Master that polls too fast (or too slow) does so here too
+//--------------------------------------------------------------------------
+static void replay(uint32_t busClock)
+{
+  Histogram played;
+  uint32_t  mismatches = 0, dataDiffers = 0, truncated = 0;
+  uint8_t   data[BUFFER_LENGTH];
+  uint8_t   received;
+
+  memset(&played, 0, sizeof(played));
+  simSlaveBegin();
+  delay(100);
+  Wire.begin();
+  Wire.setClock(busClock);
+  uint8_t   address = simSlaveAddress();
+  uint64_t  start   = simMicros();
+  uint64_t  busy    = simBus.getStats().busMicros;
+
+  for (uint32_t i = 0; i < numRecords; i++) {
+    const I2CMUX_TraceRecord &rec = trace[i];
+    if (rec.type == I2CMUX_TRACE_WRITE && rec.length > I2CMUX_TRACE_PAYLOAD) {
+      truncated++;      // only the first bytes were traced
+      continue;
+    }
+    uint64_t due = start + (uint32_t)(rec.timestamp - trace[0].timestamp);
+    if (simMicros() < due) {
+      uint64_t wait = due - simMicros();
+      delay(wait / 1000);
+      delayMicroseconds(wait % 1000);
+    }
+
+    uint64_t callStart = simMicros();
+    uint8_t  result    = replayOne(rec, address, data, received);
+    histAdd(played, (uint32_t)(simMicros() - callStart));
+
+    if ((result == I2CMUX_OK) != (rec.result == I2CMUX_OK)) {
+      mismatches++;
+      if (verbose) printf("replay #%u %s: recorded[%s] replayed[%s]\n"
+                          , i, regName(rec.reg), resultName(rec.result), resultName(result));
+    }
+    else if (rec.type == I2CMUX_TRACE_READ && result == I2CMUX_OK
+                                           && memcmp(data, rec.payload, (received < I2CMUX_TRACE_PAYLOAD ? received : I2CMUX_TRACE_PAYLOAD)) != 0) {
+      dataDiffers++;
+      if (verbose) {
+        printf("replay #%u %s: recorded", i, regName(rec.reg));
+        for (uint8_t b = 0; b < received && b < I2CMUX_TRACE_PAYLOAD; b++) printf(" %02x", rec.payload[b]);
+        printf(", replayed");
+        for (uint8_t b = 0; b < received && b < I2CMUX_TRACE_PAYLOAD; b++) printf(" %02x", data[b]);
+        printf("\n");
+      }
+    }
+  }
+
+  uint64_t span = simMicros() - start;
+  busy = simBus.getStats().busMicros - busy;
+  printf("# replay at %u Hz: %u transactions, %u skipped (payload not traced), %u us\n"
+          , busClock, played.count, truncated, (uint32_t)span);
+  printf("# replay bus utilization: %.1f%%, %u result mismatches, %u reads with other data\n"
+          , (span ? 100.0 * busy / span : 0.0), mismatches, dataDiffers);
+  histPrint("replayed", played);
+
+} // replay()
+
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  int       opt;
+  bool      doReplay = false;
+  uint32_t  busClock = 0;
+
+  while ((opt = getopt(argc, argv, "drc:b:s:")) != -1) {
+    switch(opt)
+    {
+      case 'd': verbose  = true;                        break;
+      case 'r': doReplay = true;                        break;
+      case 'c': busClock = atol(optarg);                break;
+      case 'b': simBus.setSlaveBusyTime(atol(optarg));  break;
+      case 's': simBus.setStretchLimit(atol(optarg));   break;
+      default:  fprintf(stderr, "usage: %s [-d] [-r] [-c clock] [-b busyUs] [-s stretchUs] file\n", argv[0]);
+                return 2;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-d] [-r] [-c clock] [-b busyUs] [-s stretchUs] file\n", argv[0]);
+    return 2;
+  }
+  if (!readTraceFile(argv[optind])) return 1;
+  if (numRecords == 0) {
+    printf("# no \"#T\" trace lines in %s\n", argv[optind]);
+    return 1;
+  }
+
+  analyze();
+  if (doReplay) replay(busClock ? busClock : traceClock);
+  return 0;
+
+} // main()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
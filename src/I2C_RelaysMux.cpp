@@ -13,21 +13,83 @@
 #include "I2C_RelaysMux.h"
 
 // Constructor
-I2CMUX::I2CMUX() { }
+I2CMUX::I2CMUX() 
+{ 
+  _pacing       = I2CMUX_PACING_ADAPTIVE;
+  _slaveBusy    = false;
+  _cmdPending   = false;
+  _unconfirmed  = 0;
+  _slaveRelease = 0;
+  _statusTimer  = 0;
+  _lastLatency  = 0;
+  _lastError    = I2CMUX_OK;
+  _retries      = _RETRIES;
+  _retryBackoff = _RETRYBACKOFF;
+#if defined(PIN_WIRE_SDA) && defined(PIN_WIRE_SCL)
+  _sdaPin       = PIN_WIRE_SDA;
+  _sclPin       = PIN_WIRE_SCL;
+#else
+  _sdaPin       = -1;           // no bus recovery, see setRecoveryPins()
+  _sclPin       = -1;
+#endif
+  _busClock     = 100000L;
+  _slaveAway    = false;
+  memset(&_errors, 0, sizeof(_errors));
+  _qHead        = 0;
+  _qTail        = 0;
+  _qCount       = 0;
+  _nextHandle   = 1;
+  memset(_queue, 0, sizeof(_queue));
+  _cacheOn      = false;
+  _coalesce     = false;
+  _shadowValid  = false;
+  _dirty        = false;
+  _shadow       = 0;
+  _cacheTimer   = 0;
+  _verifyInterval = 0;
+  _staged       = false;
+  _stagedMask   = 0;
+  _batchSeq     = 0;
+  _seqRunning   = false;
+  _seqLength    = 0;
+  _timerStart   = 0;
+  _timerLength  = 0;
+  I2CMUX_STAT(memset(&_stats, 0, sizeof(_stats)));
+#ifdef I2CMUX_ENABLE_TRACE
+  _traceHead    = 0;
+  _traceCount   = 0;
+  _traceLost    = 0;
+  _traceOn      = true;
+#endif
+}
 
 // Initializes the I2C_Multiplexer
 // Returns false if I2C_Multiplexer is not detected
 //-------------------------------------------------------------------------------------
 bool I2CMUX::begin(TwoWire &wireBus, uint8_t deviceAddress)
 {
-  _I2Cbus = &wireBus;
+  _I2Cbus      = &wireBus;
+  _slaveBusy   = false;
+  _shadowValid = false;
+  _statusTimer = millis();
+  _cmdPending  = false;
+  _unconfirmed = 0;
+  _slaveAway   = false;
+  _busClock    = 100000L;     // <-- every Slave firmware can do this. See setBusClock()
   _I2Cbus->begin(); 
-  _I2Cbus->setClock(100000L); // <-- don't be smart! This is the max you can get
+  _I2Cbus->setClock(_busClock);
 
   _I2Caddress = deviceAddress;
 
   if (isConnected() == false)
     return (false); // Check for I2C_Relay_Multiplexer presence
+
+  //-- what the Slave can do depends on its firmware release --
+  uint8_t val[3];
+  _slaveRelease = 0;
+  if (readRegNBytes(I2CMUX_STATUS, val, 3) == 3) {
+    _slaveRelease = (uint16_t)val[I2CMUX_MAJORRELEASE] << 8 | val[I2CMUX_MINORRELEASE];
+  }
   
   return (true); // Everything is OK!
 
@@ -36,68 +98,91 @@ bool I2CMUX::begin(TwoWire &wireBus, uint8_t deviceAddress)
 //-------------------------------------------------------------------------------------
 bool I2CMUX::isConnected()
 {
+  I2CMUX_BUSLOCK(_I2Cbus);
+  I2CMUX_TRACE(uint32_t traceStart = micros());
   _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  if (_I2Cbus->endTransmission() != 0)
-    return (false); // I2C Slave did not ACK
-  return (true);
+  bool ack = (_I2Cbus->endTransmission() == 0);
+  I2CMUX_STAT(countTransaction(0, ack));
+  I2CMUX_TRACE(traceTransaction(I2CMUX_TRACE_PROBE, 0, NULL, 0
+                              , (ack ? I2CMUX_OK : I2CMUX_ERR_NACK_ADDR), traceStart, 0));
+  return (ack); // false if I2C Slave did not ACK
 } // isConnected()
 
 //-------------------------------------------------------------------------------------
 byte I2CMUX::getMajorRelease()
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
   return (readReg1Byte(I2CMUX_MAJORRELEASE));
 }
 //-------------------------------------------------------------------------------------
 byte I2CMUX::getMinorRelease()
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
   return (readReg1Byte(I2CMUX_MINORRELEASE));
 }
 
 //-------------------------------------------------------------------------------------
 byte I2CMUX::getWhoAmI()
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
   return (readReg1Byte(I2CMUX_WHOAMI));
 }
 
 //-------------------------------------------------------------------------------------
 byte I2CMUX::getNumRelays()
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
   return (readReg1Byte(I2CMUX_NUMBEROFRELAYS));
 }
 
 //-------------------------------------------------------------------------------------
 byte I2CMUX::getStatus()
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
   uint8_t tmpStatus = (byte)readReg1Byte(I2CMUX_STATUS);
-  _status |= (byte)tmpStatus;
+  checkStatus(tmpStatus);
+  //-- an overrun or restart may have been seen (and cleared) by an internal poll --
+  tmpStatus |= (_status & (I2CMUX_STATUS_OVERRUN | I2CMUX_STATUS_RESTARTED));
+  _status    = 0;
   return (tmpStatus);
 }
 
+// Read status, releases, last GPIO state, address, number of relays and
+// the relay state in one burst (needs Slave firmware v1.9 or later)
+//-------------------------------------------------------------------------------------
+bool I2CMUX::readInfo(I2CMUX_Info &info)
+{
+  uint8_t val[I2CMUX_INFO_SIZE];
+
+  if (readRegNBytes(I2CMUX_STATUS, val, I2CMUX_INFO_SIZE) != I2CMUX_INFO_SIZE) {
+    return (false);
+  }
+  info.status         = val[I2CMUX_STATUS];
+  info.majorRelease   = val[I2CMUX_MAJORRELEASE];
+  info.minorRelease   = val[I2CMUX_MINORRELEASE];
+  info.lastGpioState  = val[I2CMUX_LASTGPIOSTATE];
+  info.whoAmI         = val[I2CMUX_WHOAMI];
+  info.numberOfRelays = val[I2CMUX_NUMBEROFRELAYS];
+  info.relayState     = (uint16_t)val[I2CMUX_RELAYSTATE + 1] << 8 | val[I2CMUX_RELAYSTATE];
+  checkStatus(info.status);
+  if (info.status & I2CMUX_STATUS_BUSY) return (true);
+
+  //-- the Slave is idle: everything is up-to-date, also the relay state cache --
+  _cmdPending = false;
+  if (_cacheOn && !_dirty) {
+    _shadow      = info.relayState;
+    _shadowValid = true;
+    _cacheTimer  = millis();
+  }
+  return (true);
+
+} // readInfo()
+
 //-------------------------------------------------------------------------------------
 bool I2CMUX::writeCommand(byte command)
 {
-  Serial.print("Command ["); Serial.print(command); Serial.println("]");
-  return (writeReg1Byte(I2CMUX_COMMAND, command));
+  bool ack = writeReg1Byte(I2CMUX_COMMAND, command);
+  //-- these commands keep the Slave busy for a while ---
+  if (command & (_BV(CMD_TESTRELAYS) | _BV(CMD_READCONF) | _BV(CMD_WRITECONF) | _BV(CMD_REBOOT))) {
+    _slaveBusy   = true;
+    _shadowValid = false;
+  }
+  return (ack);
 }
 
 //-------------------------------------------------------------------------------------
@@ -109,28 +194,190 @@ bool I2CMUX::pinMode(byte GPIO_PIN, byte PINMODE)
 //-------------------------------------------------------------------------------------
 bool I2CMUX::digitalRead(byte GPIO_PIN)
 {
+  if (_cacheOn && GPIO_PIN >= 1 && GPIO_PIN <= 16) {
+    if (!refreshShadow()) return (false);
+    return ((_shadow >> (GPIO_PIN - 1)) & 1);
+  }
   if (writeCommand2Bytes(_BV(CMD_DIGITALREAD), GPIO_PIN)) {
-    delay(2);
+    if (_pacing == I2CMUX_PACING_FIXED) delay(2);
     return (readReg1Byte(I2CMUX_LASTGPIOSTATE));
   }
+  return (false);
+}
+
+// Same as digitalRead(GPIO_PIN) but tells 'open' from a failure
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::digitalRead(byte GPIO_PIN, uint8_t &state)
+{
+  _lastError = I2CMUX_OK;
+  state      = digitalRead(GPIO_PIN);
+  return (_lastError);
 }
 
 //-------------------------------------------------------------------------------------
 bool I2CMUX::digitalWrite(byte GPIO_PIN, byte HIGH_LOW)
 {
+  if (_cacheOn && GPIO_PIN >= 1 && GPIO_PIN <= 16) {
+    if (!refreshShadow()) return (false);
+    uint16_t newShadow;
+    if (HIGH_LOW) newShadow = _shadow |  ((uint16_t)1 << (GPIO_PIN - 1));
+    else          newShadow = _shadow & ~((uint16_t)1 << (GPIO_PIN - 1));
+    //-- a write to a relay also cancels its timer on the Slave --
+    bool scheduled = scheduleRunning();
+    if (newShadow == _shadow && !scheduled) return (true);  // nothing changes
+    if (_coalesce && !scheduled) {
+      _shadow = newShadow;
+      _dirty  = true;                           // send by flush()
+      return (true);
+    }
+    _seqRunning = false;                        // the Slave stops the sequence
+    if (writeCommand3Bytes(_BV(CMD_DIGITALWRITE), GPIO_PIN, HIGH_LOW)) {
+      _shadow = newShadow;
+      return (true);
+    }
+    _shadowValid = false;
+    return (false);
+  }
+  _seqRunning = false;
   return(writeCommand3Bytes(_BV(CMD_DIGITALWRITE), GPIO_PIN, HIGH_LOW));
 }
 
+// Set all relays at once. Bit 0 of relayMask is relay 1, a '1' is 'closed'
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeAll(uint16_t relayMask)
+{
+  if (_cacheOn) {
+    if (_shadowValid && !_dirty && relayMask == _shadow
+                     && !scheduleRunning()) return (true);  // nothing changes
+    _shadow      = relayMask;
+    _shadowValid = true;
+    _dirty       = true;
+    if (_coalesce) return (true);              // send by flush()
+    return (flush());
+  }
+  return (writeRelayMask(relayMask));
+}
+
+// Read all relays at once. Bit 0 is relay 1, a '1' is 'closed'
+//-------------------------------------------------------------------------------------
+uint16_t I2CMUX::readAll()
+{
+  if (_cacheOn) {
+    if (!refreshShadow()) return (0);
+    return (_shadow);
+  }
+  return ((uint16_t)readReg2Byte(I2CMUX_RELAYSTATE));
+}
+
+// Same as readAll() but tells 'all open' from a failure
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::readAll(uint16_t &relayMask)
+{
+  _lastError = I2CMUX_OK;
+  relayMask  = readAll();
+  return (_lastError);
+}
+
+// Send relayMask to the Slave but don't switch the relays until latch()
+// or broadcastLatch(). Use this to switch relays on many boards at once
+//-------------------------------------------------------------------------------------
+bool I2CMUX::stageAll(uint16_t relayMask)
+{
+  byte data[2];
+  data[0] = relayMask & 0xFF;   // LSB relay 1 .. 8
+  data[1] = relayMask >> 8;     // MSB relay 9 .. 16
+  if (!writeExtCommand(XCMD_STAGEALL, data, 2)) return (false);
+  _staged     = true;
+  _stagedMask = relayMask;
+  return (true);
+}
+
+// Switch the staged relays on this board only
+//-------------------------------------------------------------------------------------
+bool I2CMUX::latch()
+{
+  if (!writeRegNBytes(I2CMUX_LATCH, NULL, 0)) return (false);
+  if (_staged) {
+    _seqRunning  = false;       // the Slave stops all timers and the sequence
+    _timerLength = 0;
+  }
+  stagedLatched();
+  return (true);
+}
+
+// Switch the staged relays on all boards on wireBus with one General Call.
+// The library instances don't know about this, so call invalidateCache()
+// if the cache is used (I2CMUXGroup::commit() takes care of this).
+// A latch without staged relays does nothing, so a NACK is simply retried
+//-------------------------------------------------------------------------------------
+bool I2CMUX::broadcastLatch(TwoWire &wireBus)
+{
+  for (uint8_t attempt = 0; attempt <= _RETRIES; attempt++) {
+    if (attempt > 0) delayMicroseconds(_RETRYBACKOFF << attempt);
+    I2CMUX_BUSLOCK(&wireBus);
+    wireBus.beginTransmission((uint8_t)0);  // General Call
+    wireBus.write(I2CMUX_LATCH);
+    if (wireBus.endTransmission() == 0) return (true);
+  }
+  return (false);
+}
+
+// Keep a copy of the relay states in the library. Reads are served from
+// this copy (re-read from the Slave every verifyInterval msecs, 0 is never)
+// and writes that do not change a relay are dropped.
+// With coalesce writes are only kept in the copy until flush() (or tick())
+// sends them all in one writeAll()
+//-------------------------------------------------------------------------------------
+void I2CMUX::enableCache(uint32_t verifyInterval, bool coalesce)
+{
+  _cacheOn        = true;
+  _coalesce       = coalesce;
+  _verifyInterval = verifyInterval;
+  _shadowValid    = false;
+  _dirty          = false;
+
+} // enableCache()
+
+//-------------------------------------------------------------------------------------
+void I2CMUX::disableCache()
+{
+  flush();
+  _cacheOn = false;
+
+} // disableCache()
+
+// Forget the cached relay states (f.i. after the Slave has been reset)
+//-------------------------------------------------------------------------------------
+void I2CMUX::invalidateCache()
+{
+  _shadowValid = false;
+
+} // invalidateCache()
+
+// Send all coalesced writes in one transaction
+//-------------------------------------------------------------------------------------
+bool I2CMUX::flush()
+{
+  if (!_dirty) return (true);
+  _dirty = false;
+  if (writeRelayMask(_shadow)) {
+    _cacheTimer = millis();
+    return (true);
+  }
+  _shadowValid = false; // we don't know what the relays are now
+  return (false);
+
+} // flush()
+
 // Change the I2C address of this I2C Slave address to newAddress
 //-------------------------------------------------------------------------------------
 bool I2CMUX::setI2Caddress(uint8_t newAddress)
 {
-  Serial.print("setI2Caddress(): register[0x"); 
-  Serial.print(I2CMUX_WHOAMI, HEX); 
-  Serial.println("]");
   if (writeReg1Byte(I2CMUX_WHOAMI, newAddress)) {
     // Once the address is changed, we need to change it in the library
+    // the Slave saves the new address and reboots
     _I2Caddress = newAddress;
+    _slaveBusy  = true;
     writeCommand(1<<CMD_WRITECONF);
     return true;
   }
@@ -144,10 +391,8 @@ bool I2CMUX::setNumRelays(uint8_t numRelays)
 {
   if (numRelays == 8 || numRelays == 16) 
   {
-    Serial.print("setNumRelays(): register[0x"); 
-    Serial.print(I2CMUX_NUMBEROFRELAYS, HEX); 
-    Serial.println("]");
     _I2CnumRelays = numRelays;
+    _shadowValid  = false;
     if (writeReg1Byte(I2CMUX_NUMBEROFRELAYS, numRelays)) {
       writeCommand(1<<CMD_WRITECONF);
       return true;
@@ -157,231 +402,1418 @@ bool I2CMUX::setNumRelays(uint8_t numRelays)
 
 } // setNumRelays()
 
-
-//-------------------------------------------------------------------------------------
-//-------------------------- READ FROM REGISTERS --------------------------------------
+// What the relays do after a reset of the Slave (I2CMUX_POWERON_OFF, 
+// I2CMUX_POWERON_MASK with relayMask or I2CMUX_POWERON_LAST). Saved in EEPROM
 //-------------------------------------------------------------------------------------
+bool I2CMUX::setPowerOnState(uint8_t mode, uint16_t relayMask)
+{
+  uint8_t data[3];
 
-// Reads a uint8_t from a register @addr
-//-------------------------------------------------------------------------------------
-uint8_t I2CMUX::readReg1Byte(uint8_t addr)
-{  
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
+  if (mode > I2CMUX_POWERON_LAST) return (false);
+  if (_slaveRelease < _POWERONRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (false);
   }
-  _statusTimer = millis();
+  data[0] = mode;
+  data[1] = relayMask & 0xFF;   // LSB
+  data[2] = relayMask >> 8;     // MSB
+  if (!writeRegNBytes(I2CMUX_POWERONMODE, data, 3)) return (false);
+  return (writeCommand(1<<CMD_WRITECONF));
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  if (_I2Cbus->endTransmission() != 0) {
-    return (0); // Slave did not ack
-  }
+} // setPowerOnState()
+
+// With I2CMUX_POWERON_LAST relayMask is the last saved relay state
+//-------------------------------------------------------------------------------------
+bool I2CMUX::getPowerOnState(uint8_t &mode, uint16_t &relayMask)
+{
+  uint8_t val[3];
 
-  _I2Cbus->requestFrom((uint8_t)_I2Caddress, (uint8_t) 1);
-  delay(2);
-  if (_I2Cbus->available()) {
-    return (_I2Cbus->read());
+  if (_slaveRelease < _POWERONRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (false);
   }
+  if (readRegNBytes(I2CMUX_POWERONMODE, val, 3) != 3) return (false);
+  mode      = val[0];
+  relayMask = (uint16_t)val[2] << 8 | val[1];
+  return (true);
 
-  return (0); // Slave did not respond
-}
+} // getPowerOnState()
 
-// Reads an int16_t from a register @addr
+// Why the Slave (re)started: I2CMUX_BOOT_.. bits, 0 if unknown
 //-------------------------------------------------------------------------------------
-int16_t I2CMUX::readReg2Byte(uint8_t addr)
+byte I2CMUX::getBootReason()
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
+  if (_slaveRelease < _POWERONRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (0);
   }
-  _statusTimer = millis();
+  return (readReg1Byte(I2CMUX_BOOTREASON));
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  if (_I2Cbus->endTransmission() != 0) {
-    return (0); // Slave did not ack
-  }
+} // getBootReason()
+
+// Switch the bus to 'clock' Hz and check the Slave keeps up. Fast mode 
+// (400kHz) needs Slave firmware v1.10 or later; older firmware does all
+// the work in the TWI interrupt and can not keep up.
+// Falls back to 100kHz (and returns false) if the Slave fails.
+// Mind: this sets the clock for ALL devices on this bus!
+//-------------------------------------------------------------------------------------
+bool I2CMUX::setBusClock(uint32_t clock)
+{
+  if (clock > 100000L && _slaveRelease < _QUEUEDRELEASE) return (false);
 
-  _I2Cbus->requestFrom((uint8_t)_I2Caddress, (uint8_t) 2);
-  delay(2);
-  if (_I2Cbus->available()) {
-    uint8_t LSB = _I2Cbus->read();
-    uint8_t MSB = _I2Cbus->read();
-    return ((int16_t)MSB << 8 | LSB);
+  I2CMUX_BUSLOCK(_I2Cbus);    // no other transactions at a clock the Slave may not take
+  _I2Cbus->setClock(clock);
+  for (uint8_t i = 0; i < 4; i++) {
+    I2CMUX_Info info;
+    if (!readInfo(info) || info.whoAmI != _I2Caddress) {
+      _busClock = 100000L;
+      _I2Cbus->setClock(_busClock);
+      return (false);
+    }
   }
+  _busClock = clock;          // recoverBus() restarts Wire with it
+  return (true);
 
-  return (0); // Slave did not respond
-}
+} // setBusClock()
 
-// Reads an int32_t from a register @addr
+// Select how transactions are spaced (I2CMUX_PACING_FIXED or I2CMUX_PACING_ADAPTIVE)
 //-------------------------------------------------------------------------------------
-int32_t I2CMUX::readReg4Byte(uint8_t addr)
+void I2CMUX::setPacing(uint8_t pacingMode)
 {
-  while ((int32_t)(millis() - _statusTimer) < _READDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
+  _pacing = pacingMode;
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  if (_I2Cbus->endTransmission() != 0) {
-    return (0); // Slave did not ack
-  }
+} // setPacing()
 
-  _I2Cbus->requestFrom((uint8_t)_I2Caddress, (uint8_t) 4);
-  delay(2);
-  if (_I2Cbus->available()) {
-    uint8_t LSB   = _I2Cbus->read();
-    uint8_t mLSB  = _I2Cbus->read();
-    uint8_t mMSB  = _I2Cbus->read();
-    uint8_t MSB   = _I2Cbus->read();
-    uint32_t comb = (uint32_t)MSB << 24 | (uint32_t)mMSB << 16 | (uint32_t)mLSB << 8 | LSB;
-    return (comb);
-  }
+// Duration (in micro seconds) of the last transaction, pacing not included
+//-------------------------------------------------------------------------------------
+uint32_t I2CMUX::getLastLatency()
+{
+  return (_lastLatency);
 
-  return (0); // Slave did not respond
-}
+} // getLastLatency()
 
+// I2CMUX_OK or the I2CMUX_ERR_.. of the last transaction (after all retries)
 //-------------------------------------------------------------------------------------
-//-------------------------- WRITE TO REGISTERS ---------------------------------------
+uint8_t I2CMUX::getLastError()
+{
+  return (_lastError);
+
+} // getLastError()
+
+// A failed transaction is tried 'retries' more times. The first retry comes
+// after backoffMicros, every next one waits twice as long. Keep it short: 
+// the caller is blocked while retrying
 //-------------------------------------------------------------------------------------
+void I2CMUX::setRetries(uint8_t retries, uint16_t backoffMicros)
+{
+  if (retries > 7) retries = 7;
+  _retries      = retries;
+  _retryBackoff = backoffMicros;
 
-// Write a 1 byte value to a register
+} // setRetries()
+
+// The pins recoverBus() toggles (default the Wire pins of the board)
 //-------------------------------------------------------------------------------------
-bool I2CMUX::writeReg1Byte(uint8_t addr, uint8_t val)
+void I2CMUX::setRecoveryPins(int8_t sdaPin, int8_t sclPin)
 {
-  while ((int32_t)(millis() - _statusTimer) < _WRITEDELAY) {
-    delay(1);
-  }
-  _statusTimer = millis();
+  _sdaPin = sdaPin;
+  _sclPin = sclPin;
 
-  Serial.print("writeReg1Byte(");
-  Serial.print(addr);
-  Serial.print(", ");
-  Serial.print(val);
-  Serial.println(")");
+} // setRecoveryPins()
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  _I2Cbus->write(val);
-  if (_I2Cbus->endTransmission() != 0) {
-    return (false); // Slave did not ack
+// A Slave that was reset (or missed clock pulses) in the middle of a byte
+// can hold SDA LOW forever. Clock the byte out with up to 9 SCL pulses, 
+// make a STOP and restart Wire. Takes well under a millisecond.
+// Done by the retry engine, returns false if the bus was not stuck
+//-------------------------------------------------------------------------------------
+bool I2CMUX::recoverBus()
+{
+  if (_sdaPin < 0 || _sclPin < 0) return (false);
+  I2CMUX_BUSLOCK(_I2Cbus);
+  if (::digitalRead(_sdaPin) == HIGH && ::digitalRead(_sclPin) == HIGH) return (false);
+
+#if defined(ARDUINO_ARCH_AVR)
+  _I2Cbus->end();             // the TWI hardware owns the pins
+#endif
+  ::pinMode(_sdaPin, INPUT_PULLUP);
+  ::pinMode(_sclPin, INPUT_PULLUP);
+  for (uint8_t i = 0; i < 9 && ::digitalRead(_sdaPin) == LOW; i++) {
+    ::pinMode(_sclPin, OUTPUT);       // open-drain: only pull LOW
+    ::digitalWrite(_sclPin, LOW);
+    delayMicroseconds(5);
+    ::pinMode(_sclPin, INPUT_PULLUP);
+    delayMicroseconds(5);
   }
+  //-- STOP: SDA goes HIGH while SCL is HIGH --
+  ::pinMode(_sdaPin, OUTPUT);
+  ::digitalWrite(_sdaPin, LOW);
+  delayMicroseconds(5);
+  ::pinMode(_sdaPin, INPUT_PULLUP);
+  delayMicroseconds(5);
+  bool freed = (::digitalRead(_sdaPin) == HIGH);
 
-  return (true);
+#if defined(ARDUINO_ARCH_ESP8266)
+  _I2Cbus->begin(_sdaPin, _sclPin);
+#else
+  _I2Cbus->begin();
+#endif
+  _I2Cbus->setClock(_busClock);
+  _errors.recoveries++;
+  return (freed);
+
+} // recoverBus()
+
+// Copy the failure counters into errors
+//-------------------------------------------------------------------------------------
+void I2CMUX::getErrors(I2CMUX_Errors &errors)
+{
+  errors = _errors;
+
+} // getErrors()
+
+//-------------------------------------------------------------------------------------
+void I2CMUX::resetErrors()
+{
+  memset(&_errors, 0, sizeof(_errors));
+
+} // resetErrors()
+
+// Copy the bus traffic counters into stats
+//-------------------------------------------------------------------------------------
+void I2CMUX::getStats(I2CMUX_Stats &stats)
+{
+#ifdef I2CMUX_ENABLE_STATS
+  stats = _stats;
+#else
+  memset(&stats, 0, sizeof(stats));
+#endif
+
+} // getStats()
+
+//-------------------------------------------------------------------------------------
+void I2CMUX::resetStats()
+{
+  I2CMUX_STAT(memset(&_stats, 0, sizeof(_stats)));
+
+} // resetStats()
+
+// (Re)start recording transactions in the trace ring
+//-------------------------------------------------------------------------------------
+void I2CMUX::enableTrace()
+{
+  I2CMUX_TRACE(_traceOn = true);
 }
 
-// Write a 2 byte value to a register
 //-------------------------------------------------------------------------------------
-bool I2CMUX::writeReg2Byte(uint8_t addr, int16_t val)
+void I2CMUX::disableTrace()
+{
+  I2CMUX_TRACE(_traceOn = false);
+}
+
+// Move up to maxRecords of the oldest traced transactions to records[]
+// Returns the number of records moved (always 0 without I2CMUX_ENABLE_TRACE)
+//-------------------------------------------------------------------------------------
+uint16_t I2CMUX::readTrace(I2CMUX_TraceRecord *records, uint16_t maxRecords)
 {
-  while ((int32_t)(millis() - _statusTimer) < _WRITEDELAY) {
-    delay(1);
+  uint16_t n = 0;
+
+#ifdef I2CMUX_ENABLE_TRACE
+  while (n < maxRecords && _traceCount > 0) {
+    uint16_t oldest = (_traceHead + I2CMUX_TRACE_SIZE - _traceCount) % I2CMUX_TRACE_SIZE;
+    records[n++] = _trace[oldest];
+    _traceCount--;
   }
-  _statusTimer = millis();
+#else
+  (void)records; (void)maxRecords;
+#endif
+  return (n);
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  _I2Cbus->write(val & 0xFF); // LSB
-  _I2Cbus->write(val >> 8);   // MSB
-  if (_I2Cbus->endTransmission() != 0) {
-    return (false); // Slave did not ack
+} // readTrace()
+
+// Print (and remove) the whole trace as text that survives a Serial
+// monitor: a "#TRACE" header and one "#T" line of 40 hex digits per
+// transaction (all fields little endian, in I2CMUX_TraceRecord order).
+// Save the output and feed it to extras/hostSim/traceTool
+//-------------------------------------------------------------------------------------
+void I2CMUX::dumpTrace(Stream *outp)
+{
+#ifdef I2CMUX_ENABLE_TRACE
+  static const char   hexDigit[] = "0123456789abcdef";
+  I2CMUX_TraceRecord  rec;
+  uint8_t             raw[12 + I2CMUX_TRACE_PAYLOAD];
+  char                line[3 + (2 * sizeof(raw)) + 1];
+
+  outp->print("#TRACE v1 records[");
+  outp->print(_traceCount);
+  outp->print("] lost[");
+  outp->print(_traceLost);
+  outp->print("] clock[");
+  outp->print(_busClock);
+  outp->println("]");
+
+  while (readTrace(&rec, 1) == 1) {
+    raw[0]  = rec.timestamp;
+    raw[1]  = rec.timestamp >> 8;
+    raw[2]  = rec.timestamp >> 16;
+    raw[3]  = rec.timestamp >> 24;
+    raw[4]  = rec.duration;
+    raw[5]  = rec.duration >> 8;
+    raw[6]  = rec.address;
+    raw[7]  = rec.type;
+    raw[8]  = rec.reg;
+    raw[9]  = rec.result;
+    raw[10] = rec.length;
+    raw[11] = rec.attempt;
+    memcpy(&raw[12], rec.payload, I2CMUX_TRACE_PAYLOAD);
+
+    line[0] = '#';
+    line[1] = 'T';
+    line[2] = ' ';
+    for (uint8_t i = 0; i < sizeof(raw); i++) {
+      line[3 + (2 * i)] = hexDigit[raw[i] >> 4];
+      line[4 + (2 * i)] = hexDigit[raw[i] & 0x0F];
+    }
+    line[sizeof(line) - 1] = '\0';
+    outp->println(line);
   }
+  _traceLost = 0;
+#else
+  (void)outp;
+#endif
 
-  return (true);
+} // dumpTrace()
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- TIMED SWITCHING ------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Switch relay GPIO_PIN to HIGH_LOW now and back after msecs. The Slave 
+// does the timing, so it does not depend on the master (or the bus)
+//-------------------------------------------------------------------------------------
+bool I2CMUX::pulse(byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs)
+{
+  return (writeTimedCommand(XCMD_PULSE, GPIO_PIN, HIGH_LOW, msecs));
 }
 
+// Switch relay GPIO_PIN to HIGH_LOW after msecs
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeDelayed(byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs)
+{
+  return (writeTimedCommand(XCMD_DELAYED, GPIO_PIN, HIGH_LOW, msecs));
+}
 
-// Write a 3 byte value to a register
+// Upload a table of relayMasks to the Slave. Start it with startSequence()
 //-------------------------------------------------------------------------------------
-bool I2CMUX::writeReg3Byte(uint8_t addr, int32_t val)
+bool I2CMUX::loadSequence(const uint16_t *relayMasks, uint8_t numSteps)
 {
-  while ((int32_t)(millis() - _statusTimer) < _WRITEDELAY) {
-    delay(1);
+  uint8_t data[_MAXEXTDATA];
+
+  if (numSteps == 0 || numSteps > I2CMUX_MAX_STEPS) return (false);
+
+  //-- as many steps per transaction as fit in the Wire buffer --
+  for (uint8_t offset = 0; offset < numSteps; ) {
+    uint8_t count = (_MAXEXTDATA - 2) / 2;
+    if (count > (numSteps - offset)) count = numSteps - offset;
+    data[0] = offset;
+    data[1] = count;
+    for (uint8_t s = 0; s < count; s++) {
+      data[2 + (s * 2)] = relayMasks[offset + s] & 0xFF;   // LSB
+      data[3 + (s * 2)] = relayMasks[offset + s] >> 8;     // MSB
+    }
+    if (!writeExtCommand(XCMD_SEQLOAD, data, 2 + (count * 2))) return (false);
+    offset += count;
   }
-  _statusTimer = millis();
+  _seqLength = numSteps;
+  return (true);
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  _I2Cbus->write(val &0xFF);     // LSB
-  _I2Cbus->write(val >> 8);       // mLSB
-  _I2Cbus->write(val >> 16);      // mMSB
-  //_I2Cbus->write(val >> 24);    // MSB
-  if (_I2Cbus->endTransmission() != 0) {
-    return (false); // Slave did not ack
+} // loadSequence()
+
+// Upload numRelays steps of relayMask rotating one relay to the right
+// (like the "looptest" in the examples)
+//-------------------------------------------------------------------------------------
+bool I2CMUX::loadRotation(uint16_t relayMask, uint8_t numRelays)
+{
+  uint16_t steps[I2CMUX_MAX_STEPS];
+  uint16_t allRelays = (numRelays >= 16) ? 0xFFFF : (((uint16_t)1 << numRelays) - 1);
+
+  if (numRelays == 0 || numRelays > I2CMUX_MAX_STEPS) return (false);
+  relayMask &= allRelays;             // bits above numRelays would rotate into range
+  for (uint8_t s = 0; s < numRelays; s++) {
+    steps[s]  = relayMask;
+    relayMask = ((relayMask >> 1) | (relayMask << (numRelays - 1))) & allRelays;
   }
+  return (loadSequence(steps, numRelays));
 
-  return (true);
-}
+} // loadRotation()
 
-// Write a 4 byte value to a register
+// Start the loaded sequence: one step every interval msecs. After 'passes'
+// times through the table the last step stays (0 is forever)
 //-------------------------------------------------------------------------------------
-bool I2CMUX::writeReg4Byte(uint8_t addr, int32_t val)
+bool I2CMUX::startSequence(uint16_t interval, uint8_t passes)
+{
+  uint8_t data[4];
+
+  if (_seqLength == 0) return (false);
+  data[0] = interval & 0xFF;    // LSB
+  data[1] = interval >> 8;      // MSB
+  data[2] = passes;
+  data[3] = _seqLength;
+  flush();                      // coalesced writes go first
+  _shadowValid = false;
+  _seqRunning  = writeExtCommand(XCMD_SEQSTART, data, 4);
+  return (_seqRunning);
+
+} // startSequence()
+
+// Stop all relay timers and the sequence. The relays stay as they are
+//-------------------------------------------------------------------------------------
+bool I2CMUX::stopSchedule()
+{
+  flush();                      // coalesced writes go first
+  _seqRunning  = false;
+  _timerLength = 0;
+  _shadowValid = false;
+  return (writeExtCommand(XCMD_STOP, NULL, 0));
+
+} // stopSchedule()
+
+// While the Slave switches relays on its own the cache can't be trusted
+//-------------------------------------------------------------------------------------
+bool I2CMUX::scheduleRunning()
+{
+  if (_seqRunning) return (true);
+  return ((millis() - _timerStart) < _timerLength);
+
+} // scheduleRunning()
+
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeTimedCommand(byte XCMD, byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs)
 {
-  while ((int32_t)(millis() - _statusTimer) < _WRITEDELAY) {
-    delay(1);
+  uint8_t data[6];
+  data[0] = GPIO_PIN;
+  data[1] = HIGH_LOW;
+  data[2] = msecs & 0xFF;       // LSB
+  data[3] = msecs >> 8;
+  data[4] = msecs >> 16;
+  data[5] = msecs >> 24;        // MSB
+
+  //-- coalesced writes go first, they would cancel the timer if sent later --
+  flush();
+  //-- the cache is bypassed until the (last) timer has expired --
+  uint32_t left = _timerLength - (millis() - _timerStart);
+  if (!scheduleRunning() || msecs > left) {
+    _timerStart  = millis();
+    _timerLength = msecs + 1;
   }
-  _statusTimer = millis();
+  _shadowValid = false;
+  return (writeExtCommand(XCMD, data, 6));
 
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(addr);
-  _I2Cbus->write(val & 0xFF); // LSB
-  _I2Cbus->write(val >> 8);   // mLSB
-  _I2Cbus->write(val >> 16);  // mMSB
-  _I2Cbus->write(val >> 24);  // MSB
-  if (_I2Cbus->endTransmission() != 0) {
-    return (false); // Slave did not ack
+} // writeTimedCommand()
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- EVENT LOG ------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Read up to I2CMUX_MAX_EVENTS relay changes from the log of the Slave. 
+// The events read are removed from the log. Instead of polling the relays
+// a master can call this when the "changed" line goes LOW (or the
+// I2CMUX_STATUS_EVENTS bit is set) until events.more is false. 
+// If the read fails events.lost is set: read the relays with readAll()
+//-------------------------------------------------------------------------------------
+bool I2CMUX::readEvents(I2CMUX_EventBlock &events)
+{
+  uint8_t val[I2CMUX_EVENTS_SIZE];
+  uint8_t retries = _retries;
+
+  events.count = 0;
+  events.more  = false;
+  events.lost  = false;
+  if (_slaveRelease < _EVENTRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (false);
   }
 
+  //-- the Slave removes what it sends, so always read the whole block. --
+  //-- A retry would get the next block, the failed one is gone         --
+  _retries = 0;
+  uint8_t received = readRegNBytes(I2CMUX_EVENTS, val, I2CMUX_EVENTS_SIZE);
+  _retries = retries;
+  if (received != I2CMUX_EVENTS_SIZE) {
+    events.lost  = true;
+    _shadowValid = false;
+    return (false);
+  }
+  events.count = val[0] & 0x0F;
+  events.more  = (val[0] & _BV(6));
+  events.lost  = (val[0] & _BV(7));
+  if (events.count > I2CMUX_MAX_EVENTS) events.count = I2CMUX_MAX_EVENTS;
+  for (uint8_t e = 0; e < events.count; e++) {
+    uint8_t *p = &val[1 + (e * 4)];
+    events.event[e].relay = p[0];
+    events.event[e].state = p[1];
+    events.event[e].tick  = (uint16_t)p[3] << 8 | p[2];
+  }
+  //-- some changes are gone, what we have in the cache may be one of them --
+  if (events.lost) _shadowValid = false;
   return (true);
-}
 
-// Write a 2 byte's command I2C_Mux Slave
+} // readEvents()
+
+
 //-------------------------------------------------------------------------------------
-bool I2CMUX::writeCommand2Bytes(byte CMD, byte GPIO_PIN)
+//-------------------------- RELAY CYCLE COUNTERS -------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Read how often every relay closed and how long it was closed. The
+// counters don't fit in one Wire buffer, so they are read as CRC checked
+// pages of I2CMUX_CYCLES_PER_PAGE relays: [I2CMUX_CYCLES, page] selects
+// a page (the Slave does that in its interrupt), then the page is read.
+// A damaged page is read again (setRetries())
+//-------------------------------------------------------------------------------------
+bool I2CMUX::readCycleCounters(I2CMUX_CycleCounters &counters)
 {
-  while ((int32_t)(millis() - _statusTimer) < _WRITEDELAY) {
-    delay(1);
+  uint8_t block[I2CMUX_CYCLES_SIZE];
+
+  memset(&counters, 0, sizeof(counters));
+  if (_slaveRelease < _CYCLESRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (false);
+  }
+  //-- a command the Slave did not yet execute (a reset?) goes first --
+  if (_cmdPending) {
+    uint8_t status;
+    if (readAfterCommand(I2CMUX_STATUS, &status, 1) != 1) return (false);
   }
-  _statusTimer = millis();
 
-  //Serial.printf("\nwriteCommand2Bytes: CMD[%d], GPIO[%d] \n", CMD, GPIO_PIN);
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(I2CMUX_COMMAND);
-  // val is [-------- cccccccc pppppppp]
-  _I2Cbus->write(CMD &0xFF);          // Command
-  _I2Cbus->write(GPIO_PIN &0xFF);     // GPIO_PIN
-  if (_I2Cbus->endTransmission() != 0) {
-    return (false); // Slave did not ack
+  for (uint8_t page = 0; (page * I2CMUX_CYCLES_PER_PAGE) < 16; page++) {
+    for (uint8_t attempt = 0; ; attempt++) {
+      if (!writeRegNBytes(I2CMUX_CYCLES, &page, 1)) return (false);
+      _cmdPending = false;                    // selecting a page is no command
+      if (readRegNBytes(I2CMUX_CYCLES, block, I2CMUX_CYCLES_SIZE) != I2CMUX_CYCLES_SIZE) {
+        return (false);
+      }
+      if (crc8(block, I2CMUX_CYCLES_SIZE - 1) == block[I2CMUX_CYCLES_SIZE - 1]
+          && block[0] == page) break;
+      _errors.shortReads++;                   // damaged on the way back
+      if (attempt >= _retries) {
+        _lastError = I2CMUX_ERR_SHORT_READ;
+        return (false);
+      }
+      _errors.retries++;
+    }
+    counters.numRelays = block[1];
+    for (uint8_t i = 0; i < I2CMUX_CYCLES_PER_PAGE; i++) {
+      uint8_t  r = (page * I2CMUX_CYCLES_PER_PAGE) + i;
+      uint8_t *p = &block[2 + (i * 8)];
+      if (r >= 16) break;
+      counters.cycles[r]    = (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16
+                            | (uint32_t)p[1] << 8  | p[0];
+      counters.onSeconds[r] = (uint32_t)p[7] << 24 | (uint32_t)p[6] << 16
+                            | (uint32_t)p[5] << 8  | p[4];
+    }
   }
   return (true);
-}
 
-// Write a 3 byte's command I2C_Mux Slave
+} // readCycleCounters()
+
+// Start counting again for GPIO_PIN (1 .. 16), or for all relays with 0
+// (after a relay or the whole board was replaced)
 //-------------------------------------------------------------------------------------
-bool I2CMUX::writeCommand3Bytes(byte CMD, byte GPIO_PIN, byte HIGH_LOW)
+bool I2CMUX::resetCycleCounters(uint8_t GPIO_PIN)
 {
-  while ((int32_t)(millis() - _statusTimer) < _WRITEDELAY) {
-    delay(1);
+  if (_slaveRelease < _CYCLESRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (false);
   }
-  _statusTimer = millis();
+  return (writeExtCommand(XCMD_RESETCYCLES, &GPIO_PIN, 1));
 
-  //Serial.printf("\nwriteCommand3Bytes: CMD[%d], GPIO[%d], HL[%d] \n", CMD, GPIO_PIN, HIGH_LOW);
-  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
-  _I2Cbus->write(I2CMUX_COMMAND);
-  // val is [-------- cccccccc pppppppp vvvvvvvv]
-  _I2Cbus->write(CMD &0xFF);          // Command
-  _I2Cbus->write(GPIO_PIN &0xFF);     // GPIO_PIN
-  _I2Cbus->write(HIGH_LOW &0xFF);     // HIGH_LOW
-  if (_I2Cbus->endTransmission() != 0) {
-    return (false); // Slave did not ack
-  }
+} // resetCycleCounters()
 
-  return (true);
+
+//-------------------------------------------------------------------------------------
+//-------------------------- BATCHED COMMANDS -----------------------------------------
+//-------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------
+void I2CMUX::batchBegin(I2CMUX_Batch &batch)
+{
+  batch.length = 0;
+  batch.reads  = 0;
+  batch.writes = false;
+  batch.timer  = 0;
 }
 
 //-------------------------------------------------------------------------------------
-//-------------------------- HELPERS --------------------------------------------------
+bool I2CMUX::batchPinMode(I2CMUX_Batch &batch, byte GPIO_PIN, byte PINMODE)
+{
+  byte command[3] = { _BV(CMD_PINMODE), GPIO_PIN, PINMODE };
+  return (batchAdd(batch, command, 3));
+}
+
 //-------------------------------------------------------------------------------------
+bool I2CMUX::batchDigitalWrite(I2CMUX_Batch &batch, byte GPIO_PIN, byte HIGH_LOW)
+{
+  byte command[3] = { _BV(CMD_DIGITALWRITE), GPIO_PIN, HIGH_LOW };
+  if (!batchAdd(batch, command, 3)) return (false);
+  batch.writes = true;
+  return (true);
+}
+
+// The state is in I2CMUX_BatchAck.readStates, in the order of the reads
+//-------------------------------------------------------------------------------------
+bool I2CMUX::batchDigitalRead(I2CMUX_Batch &batch, byte GPIO_PIN)
+{
+  byte command[2] = { _BV(CMD_DIGITALREAD), GPIO_PIN };
+  if (batch.reads >= I2CMUX_BATCH_READS) return (false);
+  if (!batchAdd(batch, command, 2))      return (false);
+  batch.reads++;
+  return (true);
+}
+
+//-------------------------------------------------------------------------------------
+bool I2CMUX::batchWriteAll(I2CMUX_Batch &batch, uint16_t relayMask)
+{
+  byte command[4] = { _BV(CMD_EXTENDED), XCMD_WRITEALL
+                    , (byte)(relayMask & 0xFF), (byte)(relayMask >> 8) };
+  if (!batchAdd(batch, command, 4)) return (false);
+  batch.writes = true;
+  return (true);
+}
+
+//-------------------------------------------------------------------------------------
+bool I2CMUX::batchPulse(I2CMUX_Batch &batch, byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs)
+{
+  byte command[8] = { _BV(CMD_EXTENDED), XCMD_PULSE, GPIO_PIN, HIGH_LOW
+                    , (byte)(msecs & 0xFF), (byte)(msecs >> 8)
+                    , (byte)(msecs >> 16),  (byte)(msecs >> 24) };
+  if (!batchAdd(batch, command, 8)) return (false);
+  if (msecs > batch.timer) batch.timer = msecs;
+  return (true);
+}
+
+// Send batch as one frame and wait for the Slave to acknowledge it.
+// A frame the Slave did not get (queue full) or got damaged is sent again
+// (setRetries()). The commands change relays behind the back of the cache,
+// so the cache takes the relay state from the acknowledgement
+//-------------------------------------------------------------------------------------
+bool I2CMUX::sendBatch(const I2CMUX_Batch &batch, I2CMUX_BatchAck &ack)
+{
+  uint8_t frame[I2CMUX_BATCH_SIZE + 3];
+  uint8_t block[I2CMUX_BATCHACK_SIZE];
+
+  if (_slaveRelease < _BATCHRELEASE) {
+    _lastError = I2CMUX_ERR_UNSUPPORTED;
+    return (false);
+  }
+  memset(&ack, 0, sizeof(ack));
+  ack.result = I2CMUX_BATCH_BADCRC;           // until the Slave tells otherwise
+  if (batch.length == 0 || batch.length > I2CMUX_BATCH_SIZE) return (false);
+  flush();                                    // coalesced writes go first
+
+  for (uint8_t attempt = 0; attempt <= _retries; attempt++) {
+    if (++_batchSeq == 0) _batchSeq = 1;      // 0 is "no batch yet" on the Slave
+    frame[0] = _batchSeq;
+    frame[1] = batch.length;
+    memcpy(&frame[2], batch.data, batch.length);
+    frame[batch.length + 2] = crc8(frame, batch.length + 2);
+    if (!writeRegNBytes(I2CMUX_BATCH, frame, batch.length + 3)) return (false);
+    _cmdPending  = false;                     // the acknowledgement tells when it is done
+    _shadowValid = false;
+    if (batch.writes) _seqRunning = false;    // the Slave stops the sequence
+
+    //-- poll the acknowledgement until the Slave has executed this frame --
+    uint32_t busyStart = millis();
+    bool     done      = false;
+    while (!done && (millis() - busyStart) <= _BUSYTIMEOUT) {
+      if (readRegNBytes(I2CMUX_BATCH, block, I2CMUX_BATCHACK_SIZE) != I2CMUX_BATCHACK_SIZE) {
+        return (false);
+      }
+      if (crc8(block, I2CMUX_BATCHACK_SIZE - 1) != block[I2CMUX_BATCHACK_SIZE - 1]) {
+        _errors.shortReads++;                 // damaged on the way back, read it again
+        continue;
+      }
+      checkStatus(block[0]);
+      if (block[1] == _batchSeq) {
+        done = true;
+      }
+      else if (!(block[0] & I2CMUX_STATUS_BUSY)) {
+        break;                                // frame lost (or its seq damaged)
+      }
+      else delayMicroseconds(100);
+    }
+    if (!done) {
+      if ((millis() - busyStart) > _BUSYTIMEOUT) {
+        _lastError = I2CMUX_ERR_BUSY;
+        _errors.busyTimeouts++;
+        return (false);
+      }
+      _errors.retries++;
+      continue;
+    }
+
+    ack.seq        = block[1];
+    ack.result     = block[2];
+    ack.commands   = block[3];
+    ack.readStates = block[4];
+    ack.relayState = (uint16_t)block[6] << 8 | block[5];
+    if (ack.result == I2CMUX_BATCH_BADCRC && attempt < _retries) {
+      _errors.retries++;
+      continue;
+    }
+    //-- the cache is bypassed until the (last) timer has expired --
+    uint32_t left = _timerLength - (millis() - _timerStart);
+    if (batch.timer > 0 && (!scheduleRunning() || batch.timer > left)) {
+      _timerStart  = millis();
+      _timerLength = batch.timer + 1;
+    }
+    if (ack.result == I2CMUX_BATCH_OK && !scheduleRunning()) {
+      _shadow      = ack.relayState;
+      _shadowValid = true;
+      _dirty       = false;
+      _cacheTimer  = millis();
+    }
+    return (ack.result == I2CMUX_BATCH_OK);
+  }
+  _errors.failures++;
+  return (false);
+
+} // sendBatch()
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- ASYNCHRONOUS OPERATIONS ----------------------------------
+//-------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::queuePinMode(byte GPIO_PIN, byte PINMODE, I2CMUX_callback callback)
+{
+  return (queueOp(I2CMUX_OP_PINMODE, GPIO_PIN, PINMODE, 0, callback));
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::queueDigitalWrite(byte GPIO_PIN, byte HIGH_LOW, I2CMUX_callback callback)
+{
+  return (queueOp(I2CMUX_OP_DIGITALWRITE, GPIO_PIN, HIGH_LOW, 0, callback));
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::queueWriteAll(uint16_t relayMask, I2CMUX_callback callback)
+{
+  return (queueOp(I2CMUX_OP_WRITEALL, 0, relayMask, 0, callback));
+}
+
+// Close the relays in setMask and open the ones in clearMask, the others
+// stay as they are when the operation runs (not as they were when it was
+// queued), so operations queued one after the other don't undo each other
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::queueWriteMasks(uint16_t setMask, uint16_t clearMask, I2CMUX_callback callback)
+{
+  return (queueOp(I2CMUX_OP_WRITEMASKS, 0, setMask, clearMask, callback));
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::queueReadAll(I2CMUX_callback callback)
+{
+  return (queueOp(I2CMUX_OP_READALL, 0, 0, 0, callback));
+}
+
+// Returns the state of the operation with this handle. Finished operations
+// are remembered until their slot in the queue is reused
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::getOpState(uint8_t handle)
+{
+  if (handle == 0) return (I2CMUX_OPSTATE_UNKNOWN);
+  for (uint8_t i = 0; i < I2CMUX_QUEUE_SIZE; i++) {
+    if (_queue[i].handle == handle) return (_queue[i].state);
+  }
+  return (I2CMUX_OPSTATE_UNKNOWN);
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::pending()
+{
+  return (_qCount);
+}
+
+// Execute the next queued operation, but only if the Slave is ready for it.
+// Never waits for the Slave, so it is safe to call this every loop()
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::tick()
+{
+  if (_qCount == 0 && !_dirty)  return (0);
+  if (!slaveReady())            return (_qCount);
+
+  //-- coalesced writes are send when the queue is empty --
+  if (_qCount == 0) {
+    flush();
+    return (0);
+  }
+
+  I2CMUX_Op *op     = &_queue[_qTail];
+  bool      success = false;
+  uint16_t  value   = op->value;
+  uint8_t   val[2]  = {0, 0};
+
+  switch(op->type)
+  {
+    case I2CMUX_OP_PINMODE:       success = pinMode(op->relay, op->value);
+                                  break;
+    case I2CMUX_OP_DIGITALWRITE:  success = digitalWrite(op->relay, op->value);
+                                  break;
+    case I2CMUX_OP_WRITEALL:      success = writeAll(op->value);
+                                  break;
+    case I2CMUX_OP_READALL:       if (_cacheOn) {
+                                    success = refreshShadow();
+                                    value   = _shadow;
+                                    break;
+                                  }
+                                  success = (readRegNBytes(I2CMUX_RELAYSTATE, val, 2) == 2);
+                                  value   = (uint16_t)val[1] << 8 | val[0];
+                                  break;
+    case I2CMUX_OP_WRITEMASKS:    if (_cacheOn) {
+                                    if (!refreshShadow()) break;
+                                    value = _shadow;
+                                  } else {
+                                    if (readRegNBytes(I2CMUX_RELAYSTATE, val, 2) != 2) break;
+                                    value = (uint16_t)val[1] << 8 | val[0];
+                                  }
+                                  value   = (value | op->value) & ~op->clearMask;
+                                  success = writeAll(value);
+                                  break;
+  }
+  op->state = (success ? I2CMUX_OPSTATE_DONE : I2CMUX_OPSTATE_FAILED);
+  _qTail    = (_qTail + 1) % I2CMUX_QUEUE_SIZE;
+  _qCount--;
+
+  if (op->callback) op->callback(op->handle, success, value);
+
+  return (_qCount);
+
+} // tick()
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::queueOp(uint8_t type, uint8_t relay, uint16_t value, uint16_t clearMask, I2CMUX_callback callback)
+{
+  if (_qCount >= I2CMUX_QUEUE_SIZE) return (0); // queue is full
+
+  I2CMUX_Op *op = &_queue[_qHead];
+  op->handle    = _nextHandle;
+  op->type      = type;
+  op->state     = I2CMUX_OPSTATE_PENDING;
+  op->relay     = relay;
+  op->value     = value;
+  op->clearMask = clearMask;
+  op->callback  = callback;
+  _qHead        = (_qHead + 1) % I2CMUX_QUEUE_SIZE;
+  _qCount++;
+
+  if (++_nextHandle == 0) _nextHandle = 1;  // 0 is not a valid handle
+
+  return (op->handle);
+
+} // queueOp()
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- RELAY STATE CACHE ----------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Make sure the cached relay states are valid and not older than _verifyInterval
+//-------------------------------------------------------------------------------------
+bool I2CMUX::refreshShadow()
+{
+  if (_shadowValid && scheduleRunning()) {
+    _shadowValid = false;   // the Slave switches relays on its own
+  }
+  if (_shadowValid) {
+    if (_verifyInterval == 0 || (millis() - _cacheTimer) < _verifyInterval) {
+      return (true);
+    }
+    flush();  // pending writes first
+  }
+
+  uint8_t val[2];
+  if (readRegNBytes(I2CMUX_RELAYSTATE, val, 2) != 2) {
+    _shadowValid = false;
+    return (false);
+  }
+  _shadow      = (uint16_t)val[1] << 8 | val[0];
+  _shadowValid = true;
+  _dirty       = false;
+  _cacheTimer  = millis();
+  return (true);
+
+} // refreshShadow()
+
+// The staged relayMask is now the relay state
+//-------------------------------------------------------------------------------------
+void I2CMUX::stagedLatched()
+{
+  if (!_staged) return;
+  _staged = false;
+  if (_cacheOn) {
+    _shadow      = _stagedMask;
+    _shadowValid = true;
+    _dirty       = false;
+    _cacheTimer  = millis();
+  }
+}
+
+// Send relayMask to the Slave (bypassing the cache)
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeRelayMask(uint16_t relayMask)
+{
+  byte data[2];
+  data[0] = relayMask & 0xFF;   // LSB relay 1 .. 8
+  data[1] = relayMask >> 8;     // MSB relay 9 .. 16
+  _seqRunning  = false;         // the Slave stops all timers and the sequence
+  _timerLength = 0;
+  return(writeExtCommand(XCMD_WRITEALL, data, 2));
+}
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- READ FROM REGISTERS --------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Reads a uint8_t from a register @addr
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::readReg1Byte(uint8_t addr)
+{  
+  uint8_t val[1] = {0};
+
+  readRegNBytes(addr, val, 1);
+  return (val[0]);
+}
+
+// Reads an int16_t from a register @addr
+//-------------------------------------------------------------------------------------
+int16_t I2CMUX::readReg2Byte(uint8_t addr)
+{
+  uint8_t val[2] = {0, 0};
+
+  readRegNBytes(addr, val, 2);
+  // val is [LSB MSB]
+  return ((int16_t)val[1] << 8 | val[0]);
+}
+
+// Reads an int32_t from a register @addr
+//-------------------------------------------------------------------------------------
+int32_t I2CMUX::readReg4Byte(uint8_t addr)
+{
+  uint8_t val[4] = {0, 0, 0, 0};
+
+  readRegNBytes(addr, val, 4);
+  // val is [LSB mLSB mMSB MSB]
+  uint32_t comb = (uint32_t)val[3] << 24 | (uint32_t)val[2] << 16 | (uint32_t)val[1] << 8 | val[0];
+  return (comb);
+}
+
+// Reads len bytes starting at register @addr into val[]
+// Returns the number of bytes received (0 if the Slave did not respond)
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::readRegNBytes(uint8_t addr, uint8_t *val, uint8_t len)
+{
+  uint8_t received = 0;
+
+  if (_cmdPending && addr != I2CMUX_STATUS && (addr + len) <= I2CMUX_REGISTERS_SIZE) {
+    return (readAfterCommand(addr, val, len));
+  }
+
+  for (uint8_t attempt = 0; ; attempt++) {
+    waitForSlave(_READDELAY);
+
+    received = 0;
+    uint8_t wireResult;
+    { //-- the bus is only locked for the transaction, not for the backoff --
+      I2CMUX_BUSLOCK(_I2Cbus);
+      _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
+      _I2Cbus->write(addr);
+      wireResult = _I2Cbus->endTransmission();
+      if (wireResult == 0) {
+        _I2Cbus->requestFrom((uint8_t)_I2Caddress, len);
+        while (_I2Cbus->available() && received < len) {
+          val[received++] = _I2Cbus->read();
+        }
+      }
+    }
+
+    _lastLatency = micros() - _transactionStart;
+#ifdef I2CMUX_ENABLE_STATS
+    countTransaction(1, (wireResult == 0));
+    if (wireResult == 0) {
+      countTransaction(received, (received > 0));
+      if (received < len) _stats.emptyReads++;
+    }
+#endif
+    if (wireResult != 0)      _lastError = wireError(wireResult);
+    else if (received < len)  _lastError = I2CMUX_ERR_SHORT_READ;
+    else                      _lastError = I2CMUX_OK;
+    I2CMUX_TRACE(traceTransaction(I2CMUX_TRACE_READ, addr, val, received, _lastError
+                                , _transactionStart, attempt));
+    if (!retryAfter(attempt)) break;
+  }
+  return (received);
+}
+
+// Slave firmware v1.10+ executes commands in loop(), a moment after it
+// received them. Read STATUS together with the wanted registers and
+// retry until the BUSY bit is cleared, so what we read is up-to-date
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::readAfterCommand(uint8_t addr, uint8_t *val, uint8_t len)
+{
+  uint8_t  block[I2CMUX_REGISTERS_SIZE];
+  uint8_t  blockLen  = addr + len;
+  uint32_t busyStart = millis();
+
+  _cmdPending = false;
+  do {
+    if (readRegNBytes(I2CMUX_STATUS, block, blockLen) != blockLen) {
+      return (0);
+    }
+    checkStatus(block[I2CMUX_STATUS]);
+    if (!(block[I2CMUX_STATUS] & I2CMUX_STATUS_BUSY)) {
+      memcpy(val, &block[addr], len);
+      return (len);
+    }
+    delayMicroseconds(100);
+  } while ((millis() - busyStart) <= _BUSYTIMEOUT);
+
+  _lastError = I2CMUX_ERR_BUSY;
+  _errors.busyTimeouts++;
+  return (0);
+
+} // readAfterCommand()
+
+//-------------------------------------------------------------------------------------
+//-------------------------- WRITE TO REGISTERS ---------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Write a 1 byte value to a register
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeReg1Byte(uint8_t addr, uint8_t val)
+{
+  return (writeRegNBytes(addr, &val, 1));
+}
+
+// Write a 2 byte value to a register
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeReg2Byte(uint8_t addr, int16_t val)
+{
+  uint8_t data[2];
+  data[0] = val & 0xFF;   // LSB
+  data[1] = val >> 8;     // MSB
+
+  return (writeRegNBytes(addr, data, 2));
+}
+
+
+// Write a 3 byte value to a register
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeReg3Byte(uint8_t addr, int32_t val)
+{
+  uint8_t data[3];
+  data[0] = val & 0xFF;   // LSB
+  data[1] = val >> 8;     // mLSB
+  data[2] = val >> 16;    // mMSB
+
+  return (writeRegNBytes(addr, data, 3));
+}
+
+// Write a 4 byte value to a register
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeReg4Byte(uint8_t addr, int32_t val)
+{
+  uint8_t data[4];
+  data[0] = val & 0xFF;   // LSB
+  data[1] = val >> 8;     // mLSB
+  data[2] = val >> 16;    // mMSB
+  data[3] = val >> 24;    // MSB
+
+  return (writeRegNBytes(addr, data, 4));
+}
+
+// Write a 2 byte's command I2C_Mux Slave
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeCommand2Bytes(byte CMD, byte GPIO_PIN)
+{
+  // val is [-------- cccccccc pppppppp]
+  uint8_t data[2];
+  data[0] = CMD &0xFF;          // Command
+  data[1] = GPIO_PIN &0xFF;     // GPIO_PIN
+
+  return (writeRegNBytes(I2CMUX_COMMAND, data, 2));
+}
+
+// Write a 3 byte's command I2C_Mux Slave
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeCommand3Bytes(byte CMD, byte GPIO_PIN, byte HIGH_LOW)
+{
+  // val is [-------- cccccccc pppppppp vvvvvvvv]
+  uint8_t data[3];
+  data[0] = CMD &0xFF;          // Command
+  data[1] = GPIO_PIN &0xFF;     // GPIO_PIN
+  data[2] = HIGH_LOW &0xFF;     // HIGH_LOW
+
+  return (writeRegNBytes(I2CMUX_COMMAND, data, 3));
+}
+
+// Write an extended command plus 'len' data bytes to the I2C_Mux Slave
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeExtCommand(byte XCMD, const byte *data, uint8_t len)
+{
+  // val is [-------- cccccccc xxxxxxxx dddddddd ..]
+  uint8_t frame[_MAXEXTDATA + 2];
+
+  if (len > _MAXEXTDATA) return (false);
+  frame[0] = _BV(CMD_EXTENDED);       // Command
+  frame[1] = XCMD &0xFF;              // Extended Command
+  if (len > 0) memcpy(&frame[2], data, len);  // Data
+
+  return (writeRegNBytes(I2CMUX_COMMAND, frame, len + 2));
+}
+
+// Append one command to batch
+//-------------------------------------------------------------------------------------
+bool I2CMUX::batchAdd(I2CMUX_Batch &batch, const byte *command, uint8_t len)
+{
+  if ((batch.length + len) > I2CMUX_BATCH_SIZE) return (false);
+  memcpy(&batch.data[batch.length], command, len);
+  batch.length += len;
+  return (true);
+}
+
+// CRC-8 (Dallas/Maxim, reflected 0x8C) the Slave also uses for its EEPROM
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::crc8(const uint8_t *data, uint8_t len)
+{
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t b = 0; b < 8; b++) {
+      if (crc & 0x01) crc = (crc >> 1) ^ 0x8C;
+      else            crc = (crc >> 1);
+    }
+  }
+  return (crc);
+}
+
+// Write len bytes from val[] starting at register @addr
+//-------------------------------------------------------------------------------------
+bool I2CMUX::writeRegNBytes(uint8_t addr, const uint8_t *val, uint8_t len)
+{
+  uint8_t wireResult;
+  bool    statusUnknown = false;      // sent, but STATUS could not tell if it was dropped
+
+  for (uint8_t attempt = 0; ; attempt++) {
+    if (statusUnknown) {
+      //-- find out before sending it again; this STATUS read is the attempt --
+      int16_t slaveStatus = readStatusNoWait();
+      if (slaveStatus >= 0) {
+        statusUnknown = false;
+        if (!(slaveStatus & I2CMUX_STATUS_OVERRUN)) {
+          _lastError = I2CMUX_OK;     // the Slave has it
+          break;
+        }
+        _lastError = I2CMUX_ERR_OVERRUN;
+      }
+    }
+    else {
+      waitForSlave(_WRITEDELAY);
+
+      { //-- the bus is only locked for the transaction, not for the backoff --
+        I2CMUX_BUSLOCK(_I2Cbus);
+        _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
+        _I2Cbus->write(addr);
+        for (uint8_t i = 0; i < len; i++) {
+          _I2Cbus->write(val[i]);
+        }
+        wireResult = _I2Cbus->endTransmission();
+      }
+
+      _lastLatency = micros() - _transactionStart;
+      I2CMUX_STAT(countTransaction(len + 1, (wireResult == 0)));
+      _lastError = wireError(wireResult);
+      I2CMUX_TRACE(traceTransaction(I2CMUX_TRACE_WRITE, addr, val, len, _lastError
+                                  , _transactionStart, attempt));
+      if (wireResult == 0 && _slaveRelease >= _QUEUEDRELEASE) {
+        _cmdPending = true;
+        switch (droppedBySlave())
+        {
+          case 1:   _lastError = I2CMUX_ERR_OVERRUN;  break;
+          case -1:  statusUnknown = true;             break;
+        }
+      }
+    }
+    if (statusUnknown) {
+      if (attempt >= _retries) break;
+      _errors.retries++;
+      delayMicroseconds(_retryBackoff << attempt);
+      continue;
+    }
+    if (!retryAfter(attempt)) break;
+  }
+  if (statusUnknown) {
+    //-- no retries left to find out; the relays may or may not have it --
+    _lastError   = I2CMUX_ERR_OVERRUN;
+    _shadowValid = false;
+    _errors.failures++;
+  }
+  return (_lastError == I2CMUX_OK); // false if Slave did not ack (or dropped it)
+}
+
+//-------------------------------------------------------------------------------------
+//-------------------------- PACING ---------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Wait until the Slave is ready to accept the next transaction.
+// _PACING_FIXED keeps the old behaviour of at least minDelay msecs between
+// transactions. _PACING_ADAPTIVE only waits when the last command is known
+// to keep the Slave busy (EEPROM, testRelays, reboot) and then polls the
+// STATUS register until the BUSY bit is cleared (or _BUSYTIMEOUT expires).
+//-------------------------------------------------------------------------------------
+void I2CMUX::waitForSlave(uint16_t minDelay)
+{
+  I2CMUX_STAT(uint32_t waitStart = micros());
+
+  if (_pacing == I2CMUX_PACING_FIXED) {
+    while ((int32_t)(millis() - _statusTimer) < minDelay) {
+      delay(1);
+    }
+  }
+  else if (_slaveBusy) {
+    uint32_t busyStart = millis();
+    //-- a NACK also means busy: the Slave stretches or ignores us --
+    int16_t  slaveStatus = readStatusNoWait();
+    while (slaveStatus < 0 || (slaveStatus & I2CMUX_STATUS_BUSY)) {
+      if ((millis() - busyStart) > _BUSYTIMEOUT) break;
+      delay(1);
+      slaveStatus = readStatusNoWait();
+    }
+    if (slaveStatus < 0 || (slaveStatus & I2CMUX_STATUS_BUSY)) _errors.busyTimeouts++;
+    _slaveBusy = false;
+  }
+  _statusTimer      = millis();
+  _transactionStart = micros();
+  I2CMUX_STAT(_stats.pacingMicros += (_transactionStart - waitStart));
+
+} // waitForSlave()
+
+// Same as waitForSlave() but never waits: returns false if the Slave
+// (probably) can not handle a new transaction yet
+//-------------------------------------------------------------------------------------
+bool I2CMUX::slaveReady()
+{
+  if (_pacing == I2CMUX_PACING_FIXED) {
+    return ((int32_t)(millis() - _statusTimer) >= _WRITEDELAY);
+  }
+  if (_slaveBusy) {
+    int16_t slaveStatus = readStatusNoWait();
+    if (slaveStatus < 0 || (slaveStatus & I2CMUX_STATUS_BUSY)) {
+      if ((millis() - _statusTimer) <= _BUSYTIMEOUT) return (false);
+      //-- give up waiting --
+    }
+    _slaveBusy = false;
+  }
+  return (true);
+
+} // slaveReady()
+
+// Read the STATUS register without any pacing
+// Returns -1 if the Slave did not respond
+//-------------------------------------------------------------------------------------
+int16_t I2CMUX::readStatusNoWait()
+{
+  I2CMUX_BUSLOCK(_I2Cbus);
+  I2CMUX_TRACE(uint32_t traceStart = micros());
+  _I2Cbus->beginTransmission((uint8_t)_I2Caddress);
+  _I2Cbus->write(I2CMUX_STATUS);
+  uint8_t wireResult = _I2Cbus->endTransmission();
+  if (wireResult != 0) {
+    I2CMUX_STAT(countTransaction(1, false));
+    I2CMUX_TRACE(traceTransaction(I2CMUX_TRACE_READ, I2CMUX_STATUS, NULL, 0
+                                , wireError(wireResult), traceStart, 0));
+    return (-1); // Slave did not ack
+  }
+  I2CMUX_STAT(countTransaction(1, true));
+  if (_I2Cbus->requestFrom((uint8_t)_I2Caddress, (uint8_t) 1) != 1) {
+    I2CMUX_STAT(countTransaction(0, false));
+    I2CMUX_STAT(_stats.emptyReads++);
+    I2CMUX_TRACE(traceTransaction(I2CMUX_TRACE_READ, I2CMUX_STATUS, NULL, 0
+                                , I2CMUX_ERR_SHORT_READ, traceStart, 0));
+    return (-1); // Slave did not respond
+  }
+  I2CMUX_STAT(countTransaction(1, true));
+  uint8_t slaveStatus = _I2Cbus->read();
+  I2CMUX_TRACE(traceTransaction(I2CMUX_TRACE_READ, I2CMUX_STATUS, &slaveStatus, 1
+                              , I2CMUX_OK, traceStart, 0));
+  checkStatus(slaveStatus);
+  return (slaveStatus);
+
+} // readStatusNoWait()
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- ERROR RECOVERY -------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Translate the result of endTransmission() 
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUX::wireError(uint8_t wireResult)
+{
+  switch(wireResult)
+  {
+    case 0:   return (I2CMUX_OK);
+    case 2:   return (I2CMUX_ERR_NACK_ADDR);
+    case 3:   return (I2CMUX_ERR_NACK_DATA);
+    default:  return (I2CMUX_ERR_BUS);        // 1 (too long), 4 (other), 5 (timeout)
+  }
+
+} // wireError()
+
+// Called after every try of a transaction with _lastError set. Counts the
+// failure and tells if it is worth another try (after a short backoff).
+// A Slave that answers again after it stopped answering may have been
+// reset, its STATUS tells
+//-------------------------------------------------------------------------------------
+bool I2CMUX::retryAfter(uint8_t attempt)
+{
+  if (_lastError == I2CMUX_OK) {
+    if (_slaveAway) {
+      _slaveAway   = false;
+      _shadowValid = false;
+      readStatusNoWait();
+    }
+    return (false);
+  }
+
+  switch(_lastError)
+  {
+    case I2CMUX_ERR_NACK_ADDR:
+    case I2CMUX_ERR_NACK_DATA:  _errors.nacks++;       break;
+    case I2CMUX_ERR_SHORT_READ: _errors.shortReads++;  break;
+    case I2CMUX_ERR_OVERRUN:    _errors.overruns++;
+                                _slaveBusy = true;     // send it again when the queue is empty
+                                break;
+    default:                    _errors.busErrors++;   break;
+  }
+  if (attempt >= _retries) {
+    _errors.failures++;
+    if (_lastError == I2CMUX_ERR_NACK_ADDR) _slaveAway = true;
+    return (false);
+  }
+  _errors.retries++;
+  //-- a Slave holding SDA LOW looks like a bus error or a NACK --
+  if (_lastError == I2CMUX_ERR_BUS || _lastError == I2CMUX_ERR_NACK_ADDR) recoverBus();
+  delayMicroseconds(_retryBackoff << attempt);
+  return (true);
+
+} // retryAfter()
+
+// The Slave holds _SLAVEQUEUE messages and drops the ones that do not fit
+// (it sets OVERRUN). Writes that can not overflow it, because the Slave
+// was idle a few writes ago, are not checked; the others are followed by
+// a read of STATUS. Returns 1 if the last write was dropped, 0 if it was
+// not and -1 if STATUS could not be read. writeRegNBytes() then reads it
+// again on its next attempt, instead of sending the write blindly
+//-------------------------------------------------------------------------------------
+int8_t I2CMUX::droppedBySlave()
+{
+  if (++_unconfirmed < _SLAVEQUEUE) return (0);
+
+  int16_t slaveStatus = readStatusNoWait();   // reading STATUS clears OVERRUN
+  if (slaveStatus < 0) return (-1);
+  return ((slaveStatus & I2CMUX_STATUS_OVERRUN) ? 1 : 0);
+
+} // droppedBySlave()
+
+// Every STATUS byte read from the Slave passes here
+//-------------------------------------------------------------------------------------
+void I2CMUX::checkStatus(uint8_t slaveStatus)
+{
+  _status |= slaveStatus;
+  if (!(slaveStatus & I2CMUX_STATUS_BUSY)) _unconfirmed = 0;  // its queue is empty
+  if (slaveStatus & I2CMUX_STATUS_RESTARTED) slaveRestarted();
+
+} // checkStatus()
+
+// The Slave was reset (watchdog, brown-out, reboot command) and lost all
+// it had in RAM (staged mask, timers, sequence). Forget what we know about
+// it and read its release again, like begin() does
+//-------------------------------------------------------------------------------------
+void I2CMUX::slaveRestarted()
+{
+  uint8_t val[3];
+
+  _errors.restarts++;
+  _slaveBusy    = false;
+  _cmdPending   = false;
+  _unconfirmed  = 0;
+  _shadowValid  = false;
+  _staged       = false;
+  _seqRunning   = false;
+  _seqLength    = 0;
+  _timerLength  = 0;
+  if (readRegNBytes(I2CMUX_STATUS, val, 3) == 3) {
+    _slaveRelease = (uint16_t)val[I2CMUX_MAJORRELEASE] << 8 | val[I2CMUX_MINORRELEASE];
+  }
+
+} // slaveRestarted()
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- HELPERS --------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Update the bus traffic counters after a transaction of 'bytes' bytes
+//-------------------------------------------------------------------------------------
+void I2CMUX::countTransaction(uint8_t bytes, bool ack)
+{
+#ifdef I2CMUX_ENABLE_STATS
+  _stats.transactions++;
+  if (ack) _stats.bytes += bytes;
+  else     _stats.nacks++;
+  if (_lastLatency > _stats.maxTransactionMicros) _stats.maxTransactionMicros = _lastLatency;
+#else
+  (void)bytes; (void)ack;
+#endif
+
+} // countTransaction()
+
+// Record one transaction in the trace ring, the oldest record is
+// overwritten when it is full
+//-------------------------------------------------------------------------------------
+void I2CMUX::traceTransaction(uint8_t type, uint8_t reg, const uint8_t *payload, uint8_t len
+                            , uint8_t result, uint32_t start, uint8_t attempt)
+{
+#ifdef I2CMUX_ENABLE_TRACE
+  if (!_traceOn) return;
+
+  uint32_t           duration = micros() - start;
+  I2CMUX_TraceRecord *rec     = &_trace[_traceHead];
+
+  rec->timestamp = start;
+  rec->duration  = (duration > 0xFFFF ? 0xFFFF : duration);
+  rec->address   = _I2Caddress;
+  rec->type      = type;
+  rec->reg       = reg;
+  rec->result    = result;
+  rec->length    = len;
+  rec->attempt   = attempt;
+  memset(rec->payload, 0, I2CMUX_TRACE_PAYLOAD);
+  if (payload != NULL) memcpy(rec->payload, payload, (len < I2CMUX_TRACE_PAYLOAD ? len : I2CMUX_TRACE_PAYLOAD));
+
+  _traceHead = (_traceHead + 1) % I2CMUX_TRACE_SIZE;
+  if (_traceCount < I2CMUX_TRACE_SIZE) _traceCount++;
+  else                                 _traceLost++;
+#else
+  (void)type; (void)reg; (void)payload; (void)len;
+  (void)result; (void)start; (void)attempt;
+#endif
+
+} // traceTransaction()
 
 //===========================================================================================
 //assumes little endian
@@ -19,12 +19,33 @@
 
 #define I2C_SLAVE_ADDRESS 0x48
 
+// Uncomment (or add -DI2CMUX_ENABLE_STATS to the build flags) to count 
+// bus traffic. See getStats()
+//#define I2CMUX_ENABLE_STATS
+
+// Uncomment (or add -DI2CMUX_ENABLE_TRACE to the build flags) to keep the
+// last I2CMUX_TRACE_SIZE transactions in a ring buffer. See dumpTrace()
+//#define I2CMUX_ENABLE_TRACE
+
+// Uncomment (or add -DI2CMUX_ENABLE_TASKS to the build flags) when more
+// than one task uses the bus (ESP32). See I2C_RelaysMuxBus.h and
+// I2C_RelaysMuxWorker.h
+//#define I2CMUX_ENABLE_TASKS
+
+#include "I2C_RelaysMuxBus.h"
+
 // Commando's
 enum  {  CMD_PINMODE, CMD_DIGITALWRITE, CMD_DIGITALREAD
-       , CMD_TESTRELAYS, CMD_SPARE5
+       , CMD_TESTRELAYS, CMD_EXTENDED
        , CMD_READCONF, CMD_WRITECONF, CMD_REBOOT 
       };
 
+// Extended commando's (the byte following _BV(CMD_EXTENDED))
+enum  {  XCMD_WRITEALL, XCMD_STAGEALL
+       , XCMD_PULSE, XCMD_DELAYED, XCMD_SEQLOAD, XCMD_SEQSTART, XCMD_STOP
+       , XCMD_RESETCYCLES
+      };
+
 // Map to the various registers on the I2C Multiplexer
 enum encoderRegisters {
   I2CMUX_STATUS          = 0x00,
@@ -33,16 +54,239 @@ enum encoderRegisters {
   I2CMUX_LASTGPIOSTATE   = 0x03,
   I2CMUX_WHOAMI          = 0x04,
   I2CMUX_NUMBEROFRELAYS  = 0x05,
+  I2CMUX_RELAYSTATE      = 0x06,  // 2 bytes, bit (n-1) is relay n
+  I2CMUX_BOOTREASON      = 0x08,  // Slave firmware v1.14+
+  I2CMUX_POWERONMODE     = 0x09,  // Slave firmware v1.14+
+  I2CMUX_POWERONMASK     = 0x0A,  // 2 bytes, Slave firmware v1.14+
 
   //----
-  I2CMUX_COMMAND         = 0xF0   // -> this is NOT a "real" register!!
+  I2CMUX_COMMAND         = 0xF0,  // -> this is NOT a "real" register!!
+  I2CMUX_LATCH           = 0xF2,  // -> NOT a "real" register, also send as General Call
+  I2CMUX_EVENTS          = 0xF3,  // -> NOT a "real" register, read the event log
+  I2CMUX_BATCH           = 0xF4,  // -> NOT a "real" register, batch frame / acknowledgement
+  I2CMUX_CYCLES          = 0xF5   // -> NOT a "real" register, relay cycle counters (paged)
+};
+
+// The register block 0x00 .. 0x07, read in one burst by readInfo()
+struct I2CMUX_Info {
+  uint8_t   status;           // 0x00
+  uint8_t   majorRelease;     // 0x01
+  uint8_t   minorRelease;     // 0x02
+  uint8_t   lastGpioState;    // 0x03
+  uint8_t   whoAmI;           // 0x04
+  uint8_t   numberOfRelays;   // 0x05
+  uint16_t  relayState;       // 0x06 .. 0x07, bit (n-1) is relay n
+};
+#define I2CMUX_INFO_SIZE        8       // bytes on the wire
+#define I2CMUX_REGISTERS_SIZE   12      // all registers (Slave firmware v1.14+)
+
+// Relay state after a reset of the Slave (firmware v1.14+)
+enum  {  I2CMUX_POWERON_OFF       // all relays 'open'
+       , I2CMUX_POWERON_MASK      // the relayMask given to setPowerOnState()
+       , I2CMUX_POWERON_LAST      // the last relay state (saved every 10 minutes at most)
+      };
+
+// Bits in getBootReason() (the MCUSR of the ATmega328P)
+#define I2CMUX_BOOT_POWERON     _BV(0)  // power-on
+#define I2CMUX_BOOT_EXTERNAL    _BV(1)  // reset pin
+#define I2CMUX_BOOT_BROWNOUT    _BV(2)  // supply voltage dropped
+#define I2CMUX_BOOT_WATCHDOG    _BV(3)  // the Slave hung (or a reboot command)
+
+// Bits in the I2CMUX_STATUS register
+#define I2CMUX_STATUS_BUSY      _BV(0)  // Slave has not yet executed all commands
+#define I2CMUX_STATUS_OVERRUN   _BV(1)  // Slave dropped a command (queue was full)
+#define I2CMUX_STATUS_SCHEDULE  _BV(2)  // a relay timer or the sequence is running
+#define I2CMUX_STATUS_EVENTS    _BV(3)  // there are events in the log
+#define I2CMUX_STATUS_RESTARTED _BV(4)  // Slave was reset since STATUS was last read
+
+// Result of the last transaction (getLastError())
+enum  {  I2CMUX_OK
+       , I2CMUX_ERR_NACK_ADDR     // no Slave on the address (or it is rebooting)
+       , I2CMUX_ERR_NACK_DATA     // the Slave did not accept the data
+       , I2CMUX_ERR_BUS           // bus error, lost arbitration or Wire timeout
+       , I2CMUX_ERR_SHORT_READ    // fewer bytes received than asked for
+       , I2CMUX_ERR_BUSY          // the Slave stayed BUSY for _BUSYTIMEOUT msecs
+       , I2CMUX_ERR_UNSUPPORTED   // not in the firmware release of this Slave
+       , I2CMUX_ERR_OVERRUN       // the Slave dropped the command (its queue was full), or
+                                  // STATUS could not be read to find out
+      };
+
+// Failure counters (always counted)
+struct I2CMUX_Errors {
+  uint32_t  nacks;                // transactions the Slave did not ACK
+  uint32_t  busErrors;            // bus errors and Wire timeouts
+  uint32_t  shortReads;           // reads that got fewer bytes than requested
+  uint32_t  busyTimeouts;         // the Slave stayed BUSY too long
+  uint32_t  retries;              // transactions that were tried again
+  uint32_t  failures;             // transactions that failed after all retries
+  uint32_t  recoveries;           // stuck bus freed by toggling SCL
+  uint32_t  restarts;             // Slave resets noticed (and caught up with)
+  uint32_t  overruns;             // commands the Slave dropped (they are sent again)
+};
+
+// A relay change logged by the Slave (firmware v1.12+). As long as there are
+// events in the log the Slave pulls its "changed" line (D12, open-drain) LOW
+struct I2CMUX_Event {
+  uint8_t   relay;            // 1 .. 16
+  uint8_t   state;            // HIGH is 'closed'
+  uint16_t  tick;             // millis() of the Slave, wraps every 65 seconds
+};
+
+#define I2CMUX_MAX_EVENTS       7       // events per readEvents()
+#define I2CMUX_EVENTS_SIZE      (1 + (I2CMUX_MAX_EVENTS * 4))  // bytes on the wire
+
+// What one readEvents() got from the log, oldest event first
+struct I2CMUX_EventBlock {
+  uint8_t       count;        // events in event[]
+  bool          more;         // call readEvents() again
+  bool          lost;         // the log overflowed or the read failed, use readAll() to catch up
+  I2CMUX_Event  event[I2CMUX_MAX_EVENTS];
+};
+
+// A batch of commands the Slave executes in order (firmware v1.16+). Fill it
+// with the batch..() calls and send it with sendBatch(). On the wire it is
+// [seq][length][commands ..][CRC-8] and the Slave only executes it when the
+// CRC is right and it knows all commands
+#define I2CMUX_BATCH_SIZE       28      // command bytes per batch (Wire buffer is 32)
+#define I2CMUX_BATCH_READS      8       // digitalRead's per batch
+
+struct I2CMUX_Batch {
+  uint8_t   length;           // command bytes in data[]
+  uint8_t   reads;            // batchDigitalRead()'s in data[]
+  bool      writes;           // a write in data[] stops the sequence on the Slave
+  uint32_t  timer;            // longest batchPulse() msecs
+  uint8_t   data[I2CMUX_BATCH_SIZE];
+};
+
+// Result of a batch (I2CMUX_BatchAck.result)
+enum  {  I2CMUX_BATCH_OK          // all commands executed
+       , I2CMUX_BATCH_BADCRC      // frame damaged on the bus, nothing executed
+       , I2CMUX_BATCH_BADFRAME    // unknown command or wrong length, nothing executed
+      };
+
+// The acknowledgement of the last batch, read back from I2CMUX_BATCH
+struct I2CMUX_BatchAck {
+  uint8_t   seq;              // sequence number of the batch
+  uint8_t   result;           // I2CMUX_BATCH_..
+  uint8_t   commands;         // commands executed
+  uint8_t   readStates;       // bit n is the (n+1)th digitalRead, a '1' is 'closed'
+  uint16_t  relayState;       // all relays after the batch, bit (n-1) is relay n
 };
+#define I2CMUX_BATCHACK_SIZE    8       // bytes on the wire: status + ack + CRC-8
 
-#define _WRITEDELAY 10
-#define _READDELAY  10
+#define I2CMUX_CYCLES_PER_PAGE  3       // relays per page of I2CMUX_CYCLES
+#define I2CMUX_CYCLES_SIZE      (2 + (I2CMUX_CYCLES_PER_PAGE * 8) + 1)  // bytes on the wire
+
+// Wear of the relays, counted by the Slave (firmware v1.17+) and kept in
+// its EEPROM. Element (n-1) is relay n
+struct I2CMUX_CycleCounters {
+  uint8_t   numRelays;        // of the Slave, the rest of the elements is 0
+  uint32_t  cycles[16];       // times the relay closed
+  uint32_t  onSeconds[16];    // total time the relay was closed
+};
+
+// How to space transactions
+enum  {  I2CMUX_PACING_FIXED      // always wait _READDELAY/_WRITEDELAY msecs
+       , I2CMUX_PACING_ADAPTIVE   // only wait while the Slave reports BUSY
+      };
+
+#ifndef I2CMUX_QUEUE_SIZE
+  #define I2CMUX_QUEUE_SIZE  8    // max. pending asynchronous operations
+#endif
+
+// Asynchronous operations
+enum  {  I2CMUX_OP_PINMODE, I2CMUX_OP_DIGITALWRITE
+       , I2CMUX_OP_WRITEALL, I2CMUX_OP_READALL 
+       , I2CMUX_OP_WRITEMASKS
+      };
+
+// State of an asynchronous operation
+enum  {  I2CMUX_OPSTATE_UNKNOWN   // no such handle (or too old)
+       , I2CMUX_OPSTATE_PENDING, I2CMUX_OPSTATE_DONE, I2CMUX_OPSTATE_FAILED
+      };
+
+// Called by tick() when an asynchronous operation has finished
+// value is the relayMask for I2CMUX_OP_READALL and the relayMask written
+// for I2CMUX_OP_WRITEMASKS
+typedef void (*I2CMUX_callback)(uint8_t handle, bool success, uint16_t value);
+
+struct I2CMUX_Op {
+  uint8_t         handle;
+  uint8_t         type;
+  uint8_t         state;
+  uint8_t         relay;
+  uint16_t        value;    // HIGH_LOW, PINMODE, relayMask or setMask
+  uint16_t        clearMask;  // I2CMUX_OP_WRITEMASKS
+  I2CMUX_callback callback;
+};
+
+// Bus traffic counters (only counted with I2CMUX_ENABLE_STATS)
+struct I2CMUX_Stats {
+  uint32_t  transactions;         // write and read transactions (STATUS polls included)
+  uint32_t  bytes;                // bytes written + bytes received (address bytes not counted)
+  uint32_t  nacks;                // transactions the Slave did not ACK
+  uint32_t  emptyReads;           // reads that got fewer bytes than requested
+  uint32_t  pacingMicros;         // time spent waiting for the Slave in waitForSlave()
+  uint32_t  maxTransactionMicros; // worst case transaction time, pacing not included
+};
+
+#ifdef I2CMUX_ENABLE_STATS
+  #define I2CMUX_STAT(x)  x
+#else
+  #define I2CMUX_STAT(x)
+#endif
+
+#ifndef I2CMUX_TRACE_SIZE
+  #if defined(ARDUINO_ARCH_AVR)
+    #define I2CMUX_TRACE_SIZE  16   // records in the trace ring (20 bytes each)
+  #else
+    #define I2CMUX_TRACE_SIZE  64
+  #endif
+#endif
+#define I2CMUX_TRACE_PAYLOAD  8     // payload bytes kept per transaction
+
+// Kind of traced transaction
+enum  {  I2CMUX_TRACE_WRITE       // [reg, payload] written
+       , I2CMUX_TRACE_READ        // [reg] written, payload read back
+       , I2CMUX_TRACE_PROBE       // address only (isConnected())
+      };
+
+// One transaction (only recorded with I2CMUX_ENABLE_TRACE)
+struct I2CMUX_TraceRecord {
+  uint32_t  timestamp;    // micros() at the start of the transaction
+  uint16_t  duration;     // usecs on the bus (65535 is 65535 or more)
+  uint8_t   address;      // I2C address of the Slave
+  uint8_t   type;         // I2CMUX_TRACE_..
+  uint8_t   reg;          // register written or read
+  uint8_t   result;       // I2CMUX_OK or I2CMUX_ERR_..
+  uint8_t   length;       // bytes written (after reg) or read
+  uint8_t   attempt;      // 0 is the first try
+  uint8_t   payload[I2CMUX_TRACE_PAYLOAD];  // the first bytes of the payload
+};
+
+#ifdef I2CMUX_ENABLE_TRACE
+  #define I2CMUX_TRACE(x)  x
+#else
+  #define I2CMUX_TRACE(x)
+#endif
+
+#define _WRITEDELAY   10
+#define _READDELAY    10
+#define _BUSYTIMEOUT  2000  // max. msecs to wait for a BUSY Slave
+#define _RETRIES      2     // default extra tries of a failed transaction
+#define _RETRYBACKOFF 100   // usecs before the first retry, doubled every retry
+#define _MAXEXTDATA   28    // max. data bytes in an extended command (Wire buffer is 32)
+#define _QUEUEDRELEASE 0x010A // Slave firmware v1.10+ executes commands in loop()
+#define _SLAVEQUEUE    3      // messages the Slave can hold before it drops one
+#define I2CMUX_MAX_STEPS  16  // max. steps in a sequence (Slave firmware v1.11+)
+#define _EVENTRELEASE  0x010C // Slave firmware v1.12+ keeps an event log
+#define _POWERONRELEASE 0x010E // Slave firmware v1.14+ restores relays at power-on
+#define _BATCHRELEASE  0x0110 // Slave firmware v1.16+ executes batch frames
+#define _CYCLESRELEASE 0x0111 // Slave firmware v1.17+ counts relay cycles
 
 class I2CMUX
 {
+  friend class I2CMUXGroup;
 
 public:
   I2CMUX();
@@ -53,32 +297,153 @@ public:
   byte    getMinorRelease();
   byte    getWhoAmI();
   byte    getNumRelays();
-  byte    getStatus();
+  byte    getStatus();                        // an OVERRUN is reported once
+  bool    readInfo(I2CMUX_Info &info);        // all of the above in one transaction
   bool    writeCommand(byte);
   bool    pinMode(byte, byte); 
   bool    digitalRead(byte); 
   bool    digitalWrite(byte, byte); 
+  bool    writeAll(uint16_t relayMask);       // set all relays in one transaction (bit 0 is relay 1)
+  uint16_t readAll();                         // read all relays in one transaction (bit 0 is relay 1)
+  uint8_t digitalRead(byte GPIO_PIN, uint8_t &state);  // I2CMUX_OK or I2CMUX_ERR_..
+  uint8_t readAll(uint16_t &relayMask);       // I2CMUX_OK or I2CMUX_ERR_..
+  bool    stageAll(uint16_t relayMask);       // relays will change at the next latch
+  bool    latch();                            // switch the staged relays on this board
+  static bool broadcastLatch(TwoWire &wireBus = Wire);  // .. on all boards on wireBus
+  //-- timed switching done by the Slave (firmware v1.11+). digitalWrite() cancels the
+  //-- timer of that relay and the sequence, writeAll() and latch() cancel everything
+  bool    pulse(byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs);        // HIGH_LOW now, back after msecs
+  bool    writeDelayed(byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs); // HIGH_LOW after msecs
+  bool    loadSequence(const uint16_t *relayMasks, uint8_t numSteps); // max. I2CMUX_MAX_STEPS
+  bool    loadRotation(uint16_t relayMask, uint8_t numRelays);        // numRelays steps, rotating right
+  bool    startSequence(uint16_t interval, uint8_t passes = 0);       // msecs per step, 0 passes is forever
+  bool    stopSchedule();                                             // stop all timers and the sequence
+  bool    readEvents(I2CMUX_EventBlock &events);  // drain (part of) the event log in one transaction
+  //-- batched commands (firmware v1.16+): many commands in one CRC checked transfer.
+  //-- The batch..() calls only fill batch, they return false if it is full
+  static void batchBegin(I2CMUX_Batch &batch);
+  static bool batchPinMode(I2CMUX_Batch &batch, byte GPIO_PIN, byte PINMODE);
+  static bool batchDigitalWrite(I2CMUX_Batch &batch, byte GPIO_PIN, byte HIGH_LOW);
+  static bool batchDigitalRead(I2CMUX_Batch &batch, byte GPIO_PIN);
+  static bool batchWriteAll(I2CMUX_Batch &batch, uint16_t relayMask);
+  static bool batchPulse(I2CMUX_Batch &batch, byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs);
+  bool    sendBatch(const I2CMUX_Batch &batch, I2CMUX_BatchAck &ack);  // true if all executed
+  //-- relay wear (firmware v1.17+)
+  bool    readCycleCounters(I2CMUX_CycleCounters &counters);  // all relays, CRC checked
+  bool    resetCycleCounters(uint8_t GPIO_PIN = 0);           // 0 is all relays
   bool    setI2Caddress(uint8_t newAddress);  // set a new I2C address for this Slave (1 .. 127)        
   bool    setNumRelays(uint8_t numRelays);    // set the number of relays on the board (8 or 16)        
+  bool    setPowerOnState(uint8_t mode, uint16_t relayMask = 0);  // I2CMUX_POWERON_..
+  bool    getPowerOnState(uint8_t &mode, uint16_t &relayMask);
+  byte    getBootReason();                    // I2CMUX_BOOT_.. bits of the last reset
+  //-- relay state cache
+  void    enableCache(uint32_t verifyInterval, bool coalesce = false);
+  void    disableCache();
+  void    invalidateCache();
+  bool    flush();                            // send coalesced writes (also done by tick())
+  //-- asynchronous (non blocking) interface: returns a handle or 0 if the queue is full
+  uint8_t queuePinMode(byte GPIO_PIN, byte PINMODE, I2CMUX_callback callback = NULL);
+  uint8_t queueDigitalWrite(byte GPIO_PIN, byte HIGH_LOW, I2CMUX_callback callback = NULL);
+  uint8_t queueWriteAll(uint16_t relayMask, I2CMUX_callback callback = NULL);
+  uint8_t queueWriteMasks(uint16_t setMask, uint16_t clearMask, I2CMUX_callback callback = NULL);
+  uint8_t queueReadAll(I2CMUX_callback callback);
+  uint8_t getOpState(uint8_t handle);
+  uint8_t pending();                          // number of queued operations
+  uint8_t tick();                             // call from loop(), returns pending()
+  void    setPacing(uint8_t pacingMode);    // I2CMUX_PACING_FIXED or I2CMUX_PACING_ADAPTIVE
+  bool    setBusClock(uint32_t clock);        // 400000 needs Slave firmware v1.10+
+  uint32_t getLastLatency();                  // micro seconds of the last transaction
+  uint8_t getLastError();                     // I2CMUX_OK or I2CMUX_ERR_.. of the last transaction
+  void    setRetries(uint8_t retries, uint16_t backoffMicros = _RETRYBACKOFF);
+  void    setRecoveryPins(int8_t sdaPin, int8_t sclPin);  // -1 is no bus recovery
+  bool    recoverBus();                       // free a Slave that holds SDA LOW
+  void    getErrors(I2CMUX_Errors &errors);
+  void    resetErrors();
+  void    getStats(I2CMUX_Stats &stats);      // all zero without I2CMUX_ENABLE_STATS
+  void    resetStats();
+  //-- transaction trace (only with I2CMUX_ENABLE_TRACE), it is on after begin()
+  void    enableTrace();
+  void    disableTrace();
+  uint16_t readTrace(I2CMUX_TraceRecord *records, uint16_t maxRecords); // oldest first, removes them
+  void    dumpTrace(Stream *outp);            // as "#T" lines for extras/hostSim/traceTool
   void    showRegister(size_t const size, void const * const ptr, Stream *outp);
   
 private:
   TwoWire           *_I2Cbus;
   uint8_t           _I2Caddress;
   uint8_t           _I2CnumRelays;
+  uint16_t          _slaveRelease;    // (major << 8) | minor
   volatile uint8_t  _status;
   uint32_t          _statusTimer;
+  uint8_t           _pacing;
+  bool              _slaveBusy;
+  bool              _cmdPending;      // Slave may not yet have executed the last command
+  uint8_t           _unconfirmed;     // writes since the Slave was last seen idle
+  uint32_t          _transactionStart;
+  uint32_t          _lastLatency;
+  uint8_t           _lastError;
+  uint8_t           _retries;
+  uint16_t          _retryBackoff;
+  int8_t            _sdaPin, _sclPin;
+  uint32_t          _busClock;
+  bool              _slaveAway;       // the Slave stopped answering (rebooting?)
+  I2CMUX_Errors     _errors;
+  I2CMUX_Op         _queue[I2CMUX_QUEUE_SIZE];
+  uint8_t           _qHead, _qTail, _qCount;
+  uint8_t           _nextHandle;
+  bool              _cacheOn, _coalesce;
+  bool              _shadowValid, _dirty;
+  uint16_t          _shadow;
+  uint32_t          _cacheTimer, _verifyInterval;
+  bool              _staged;
+  bool              _seqRunning;
+  uint8_t           _seqLength;
+  uint32_t          _timerStart, _timerLength;   // the last pulse() or writeDelayed()
+  uint16_t          _stagedMask;
+  uint8_t           _batchSeq;
+#ifdef I2CMUX_ENABLE_STATS
+  I2CMUX_Stats      _stats;
+#endif
+#ifdef I2CMUX_ENABLE_TRACE
+  I2CMUX_TraceRecord _trace[I2CMUX_TRACE_SIZE];
+  uint16_t          _traceHead, _traceCount;
+  uint32_t          _traceLost;       // overwritten before they were read
+  bool              _traceOn;
+#endif
 
   uint8_t   readReg1Byte(uint8_t reg);
   int16_t   readReg2Byte(uint8_t reg);
   int32_t   readReg4Byte(uint8_t reg);
+  uint8_t   readRegNBytes(uint8_t reg, uint8_t *val, uint8_t len);
+  uint8_t   readAfterCommand(uint8_t reg, uint8_t *val, uint8_t len);
+  int16_t   readStatusNoWait();
 
   bool      writeReg1Byte(uint8_t reg, uint8_t val);
   bool      writeReg2Byte(uint8_t reg, int16_t val);
   bool      writeReg3Byte(uint8_t reg, int32_t val);
   bool      writeReg4Byte(uint8_t reg, int32_t val);
+  bool      writeRegNBytes(uint8_t reg, const uint8_t *val, uint8_t len);
   bool      writeCommand2Bytes(byte CMD, byte GPIO_PIN);
   bool      writeCommand3Bytes(byte CMD, byte GPIO_PIN, byte HIGH_LOW);
+  bool      writeExtCommand(byte XCMD, const byte *data, uint8_t len);
+  static bool batchAdd(I2CMUX_Batch &batch, const byte *command, uint8_t len);
+  static uint8_t crc8(const uint8_t *data, uint8_t len);
+  void      countTransaction(uint8_t bytes, bool ack);
+  void      traceTransaction(uint8_t type, uint8_t reg, const uint8_t *payload, uint8_t len
+                           , uint8_t result, uint32_t start, uint8_t attempt);
+  uint8_t   wireError(uint8_t wireResult);
+  bool      retryAfter(uint8_t attempt);
+  int8_t    droppedBySlave();
+  void      checkStatus(uint8_t slaveStatus);
+  void      slaveRestarted();
+  void      waitForSlave(uint16_t minDelay);
+  bool      slaveReady();
+  bool      refreshShadow();
+  bool      scheduleRunning();
+  bool      writeTimedCommand(byte XCMD, byte GPIO_PIN, byte HIGH_LOW, uint32_t msecs);
+  bool      writeRelayMask(uint16_t relayMask);
+  void      stagedLatched();
+  uint8_t   queueOp(uint8_t type, uint8_t relay, uint16_t value, uint16_t clearMask, I2CMUX_callback callback);
 
 };
 
@@ -0,0 +1,63 @@
+/*
+***************************************************************************
+**
+**  File    : I2C_RelaysMuxBus.cpp
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include "I2C_RelaysMux.h"     // may #define I2CMUX_ENABLE_TASKS
+
+#ifdef I2CMUX_ENABLE_TASKS
+
+TwoWire      *I2CMUXBus::_buses[I2CMUX_MAX_BUSES];
+I2CMUX_Mutex  I2CMUXBus::_locks[I2CMUX_MAX_BUSES];
+I2CMUX_Mutex  I2CMUXBus::_registry;
+
+// The lock of wireBus. The first call for a bus claims a free lock for it
+//-------------------------------------------------------------------------------------
+I2CMUX_Mutex *I2CMUXBus::lockFor(TwoWire *wireBus)
+{
+  uint8_t b;
+
+  _registry.lock();
+  for (b = 0; b < (I2CMUX_MAX_BUSES - 1); b++) {
+    if (_buses[b] == wireBus) break;
+    if (_buses[b] == NULL) {
+      _buses[b] = wireBus;
+      break;
+    }
+  }
+  _registry.unlock();
+  return (&_locks[b]);
+
+} // lockFor()
+
+#endif // I2CMUX_ENABLE_TASKS
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
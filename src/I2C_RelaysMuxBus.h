@@ -0,0 +1,149 @@
+/*
+***************************************************************************
+**
+**  File    : I2C_RelaysMuxBus.h
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Only with I2CMUX_ENABLE_TASKS: one lock per TwoWire, so tasks that
+**  share a bus can not mix up each other's transactions. Every
+**  transaction of I2CMUX (and I2CMUXGroup) holds the lock of its bus.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+
+#ifndef _I2C_RELAYSMUXBUS_H
+#define _I2C_RELAYSMUXBUS_H
+
+#ifdef I2CMUX_ENABLE_TASKS
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+  #include <freertos/task.h>
+#elif defined(__linux__) || defined(__APPLE__)    // hostSim
+  #include <mutex>
+  #include <condition_variable>
+  #include <chrono>
+#else
+  #error "I2CMUX_ENABLE_TASKS needs FreeRTOS (ESP32) or a host build"
+#endif
+
+#ifndef I2CMUX_MAX_BUSES
+  #define I2CMUX_MAX_BUSES  2     // Wire and Wire1
+#endif
+
+// A recursive lock: an I2CMUX transaction may start another one (status
+// poll, bus recovery) while it holds the lock
+class I2CMUX_Mutex
+{
+public:
+#if defined(ARDUINO_ARCH_ESP32)
+  I2CMUX_Mutex()  { _mutex = xSemaphoreCreateRecursiveMutex(); }
+  void lock()     { xSemaphoreTakeRecursive(_mutex, portMAX_DELAY); }
+  void unlock()   { xSemaphoreGiveRecursive(_mutex); }
+private:
+  SemaphoreHandle_t     _mutex;
+#else
+  void lock()     { _mutex.lock(); }
+  void unlock()   { _mutex.unlock(); }
+private:
+  std::recursive_mutex  _mutex;
+#endif
+};
+
+// Wakes up a waiting (worker) task. A notify() without a waiter is
+// remembered, so the next wait() returns at once
+class I2CMUX_Signal
+{
+public:
+#if defined(ARDUINO_ARCH_ESP32)
+  I2CMUX_Signal() { _sem = xSemaphoreCreateBinary(); }
+  void wait(uint32_t msecs) { xSemaphoreTake(_sem, pdMS_TO_TICKS(msecs)); }
+  void notify()   { xSemaphoreGive(_sem); }
+private:
+  SemaphoreHandle_t       _sem;
+#else
+  I2CMUX_Signal() : _flag(false) {}
+  void wait(uint32_t msecs)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond.wait_for(lock, std::chrono::milliseconds(msecs), [this] { return _flag; });
+    _flag = false;
+  }
+  void notify()
+  {
+    { std::lock_guard<std::mutex> lock(_mutex);  _flag = true; }
+    _cond.notify_one();
+  }
+private:
+  std::mutex              _mutex;
+  std::condition_variable _cond;
+  bool                    _flag;
+#endif
+};
+
+// The bus arbiter: hands out the lock of a TwoWire. More busses than
+// I2CMUX_MAX_BUSES share the last lock (slower, but still safe)
+class I2CMUXBus
+{
+public:
+  static I2CMUX_Mutex *lockFor(TwoWire *wireBus);
+
+private:
+  static TwoWire      *_buses[I2CMUX_MAX_BUSES];
+  static I2CMUX_Mutex  _locks[I2CMUX_MAX_BUSES];
+  static I2CMUX_Mutex  _registry;
+};
+
+// Holds the lock of wireBus until it goes out of scope
+class I2CMUXBusLock
+{
+public:
+  I2CMUXBusLock(TwoWire *wireBus) : _lock(I2CMUXBus::lockFor(wireBus)) { _lock->lock(); }
+  ~I2CMUXBusLock()  { _lock->unlock(); }
+
+private:
+  I2CMUX_Mutex  *_lock;
+  I2CMUXBusLock(const I2CMUXBusLock &);
+  I2CMUXBusLock &operator=(const I2CMUXBusLock &);
+};
+
+#define I2CMUX_BUSLOCK(bus)  I2CMUXBusLock _busLock(bus)
+
+#else
+
+#define I2CMUX_BUSLOCK(bus)
+
+#endif // I2CMUX_ENABLE_TASKS
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,320 @@
+/*
+***************************************************************************  
+**
+**  File    : I2C_RelaysMuxCommand.cpp
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.                                                            
+***************************************************************************      
+*/
+
+#include "I2C_RelaysMuxCommand.h"
+
+// Constructor
+I2CMUXCommand::I2CMUXCommand()
+{
+  _length     = 0;
+  _overflow   = false;
+  _numRelays  = 16;
+  _numScenes  = 0;
+  memset(&_command, 0, sizeof(_command));
+  _command.word  = "";
+  _command.value = -1;
+}
+
+//-------------------------------------------------------------------------------------
+void I2CMUXCommand::setNumRelays(uint8_t numRelays)
+{
+  if (numRelays > 16) numRelays = 16;
+  _numRelays = numRelays;
+}
+
+// A scene sets a number of relays with one "@name". The name is not
+// copied, so it must stay (a string constant)
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::addScene(const char *name, uint16_t setMask, uint16_t clearMask)
+{
+  if (_numScenes >= I2CMUX_CMD_SCENES) return (false);
+  _scenes[_numScenes].name      = name;
+  _scenes[_numScenes].setMask   = setMask;
+  _scenes[_numScenes].clearMask = clearMask & ~setMask;
+  _numScenes++;
+  return (true);
+}
+
+// Read the characters that are there, never wait for more. Stops at the
+// end of a command (the rest stays in the Stream for the next poll())
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::poll(Stream &in)
+{
+  while (in.available() > 0) {
+    int c = in.read();
+    if (c < 0) break;
+    if (feed((char)c)) return (true);
+  }
+  return (false);
+
+} // poll()
+
+// Add c to the command. Returns true when c ends a command that is not
+// empty; command() is then valid until the next feed()
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::feed(char c)
+{
+  if (c == ';' || c == '\n') {
+    while (_length > 0 && _line[_length - 1] == ' ') _length--;
+    _line[_length] = '\0';
+    if (_overflow) {
+      _length   = 0;
+      _overflow = false;
+      fail(&_line[I2CMUX_CMD_LINE_SIZE - 1]);
+      return (true);
+    }
+    if (_length == 0) return (false);   // empty line, or the '\n' after a ';'
+    _length = 0;
+    tokenize();
+    return (true);
+  }
+  if (c == '\t') c = ' ';
+  if (c < ' ' || c > '~') return (false);
+  //-- no leading spaces and only one between the items --
+  if (c == ' ' && (_length == 0 || _line[_length - 1] == ' ')) return (false);
+  if (_length >= (I2CMUX_CMD_LINE_SIZE - 1)) {
+    _overflow = true;                   // the rest of this command is ignored
+    return (false);
+  }
+  if (c >= 'A' && c <= 'Z') c += ('a' - 'A');
+  _line[_length++] = c;
+  return (false);
+
+} // feed()
+
+// A whole command, from the REST handler for instance. Only separators
+// may follow it, anything else is an error at that position of text
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::parse(const char *text)
+{
+  const char *start = text;
+  bool        done  = false;
+
+  _length   = 0;
+  _overflow = false;
+  while (*text && !done) {
+    done = feed(*text++);
+  }
+  if (!done && !feed(';')) {
+    _command.type = I2CMUX_CMD_NONE;
+    return (false);
+  }
+  while (*text == ';' || *text == ' ' || *text == '\t' || *text == '\r' || *text == '\n') text++;
+  if (*text) {
+    _command.type     = I2CMUX_CMD_ERROR;
+    _command.errorPos = ((text - start) > 255) ? 255 : (text - start);
+    return (false);
+  }
+  return (_command.type == I2CMUX_CMD_RELAYS || _command.type == I2CMUX_CMD_WORD);
+
+} // parse()
+
+//-------------------------------------------------------------------------------------
+const I2CMUX_Command &I2CMUXCommand::command()
+{
+  return (_command);
+}
+
+// The relays after the last command, when they are currentStates now
+//-------------------------------------------------------------------------------------
+uint16_t I2CMUXCommand::relayStates(uint16_t currentStates)
+{
+  if (_command.type != I2CMUX_CMD_RELAYS) return (currentStates);
+  return ((currentStates | _command.setMask) & ~_command.clearMask);
+}
+
+// Switch the relays of the last command with as little bus traffic as
+// possible: one relay is a digitalWrite(), all relays a writeAll(). 
+// Anything in between needs the current state first (no bus traffic if
+// the cache of relay is on)
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::apply(I2CMUX &relay)
+{
+  uint16_t allRelays = (_numRelays >= 16) ? 0xFFFF : ((1U << _numRelays) - 1);
+  uint16_t changed;
+  uint16_t states;
+
+  if (_command.type != I2CMUX_CMD_RELAYS) return (false);
+  changed = (_command.setMask | _command.clearMask) & allRelays;
+  if (changed == 0)         return (true);
+  if (changed == allRelays) return (relay.writeAll(_command.setMask & allRelays));
+  if ((changed & (changed - 1)) == 0) {
+    uint8_t  relayNr  = 1;
+    uint16_t relayBit = 1;
+    while (!(changed & relayBit)) {
+      relayBit <<= 1;
+      relayNr++;
+    }
+    return (relay.digitalWrite(relayNr, (_command.setMask & relayBit) ? HIGH : LOW));
+  }
+  if (relay.readAll(states) != I2CMUX_OK) return (false);
+  return (relay.writeAll(relayStates(states)));
+
+} // apply()
+
+//-------------------------------------------------------------------------------------
+//-------------------------- TOKENIZER ------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Cut _line up in place: a word (with an optional "=value") or relay
+// items separated by spaces
+//-------------------------------------------------------------------------------------
+void I2CMUXCommand::tokenize()
+{
+  char *p = _line;
+  char *end;
+
+  memset(&_command, 0, sizeof(_command));
+  _command.word  = "";
+  _command.value = -1;
+
+  if ((*p < '0' || *p > '9') && *p != '@' && strncmp(p, "all=", 4) != 0 && strncmp(p, "mask=", 5) != 0) {
+    _command.type = I2CMUX_CMD_WORD;
+    _command.word = p;
+    char *eq = strchr(p, '=');
+    if (eq == NULL) return;
+    *eq = '\0';
+    _command.value = strtol(eq + 1, &end, 0);
+    if (end == (eq + 1) || *end != '\0') fail(eq + 1);
+    return;
+  }
+
+  _command.type = I2CMUX_CMD_RELAYS;
+  while (*p) {
+    char *item = p;
+    char *space = strchr(p, ' ');
+    if (space != NULL) {
+      *space = '\0';
+      p = space + 1;
+    }
+    else p += strlen(p);
+    if (!relayItem(item)) return;
+  }
+
+} // tokenize()
+
+// One of "n=s", "n-m,k=s", "all=s", "mask=x" or "@scene". Later items
+// overrule earlier ones
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::relayItem(char *item)
+{
+  uint16_t allRelays = (_numRelays >= 16) ? 0xFFFF : ((1U << _numRelays) - 1);
+  uint16_t on, off;
+
+  if (*item == '@') {
+    uint8_t s = 0;
+    while (s < _numScenes && strcmp(_scenes[s].name, item + 1) != 0) s++;
+    if (s >= _numScenes) {
+      fail(item);
+      return (false);
+    }
+    on  = _scenes[s].setMask;
+    off = _scenes[s].clearMask;
+  }
+  else {
+    char *eq = strchr(item, '=');
+    char *end;
+    if (eq == NULL) {
+      fail(item);
+      return (false);
+    }
+    *eq = '\0';
+    uint32_t value = strtoul(eq + 1, &end, 0);
+    if (end == (eq + 1) || *end != '\0') {
+      fail(eq + 1);
+      return (false);
+    }
+    if (strcmp(item, "mask") == 0) {
+      if (value > 0xFFFF) {
+        fail(eq + 1);
+        return (false);
+      }
+      on  =  value & allRelays;
+      off = ~value & allRelays;
+    }
+    else {
+      uint16_t relays = allRelays;
+      if (value > 1) {
+        fail(eq + 1);
+        return (false);
+      }
+      if (strcmp(item, "all") != 0 && !relayList(item, relays)) return (false);
+      on  = value ? relays : 0;
+      off = value ? 0 : relays;
+    }
+  }
+  _command.setMask   = (_command.setMask   & ~off) | on;
+  _command.clearMask = (_command.clearMask & ~on)  | off;
+  return (true);
+
+} // relayItem()
+
+// "n", "n-m" and lists of them ("1-4,7,9-10") as a relayMask
+//-------------------------------------------------------------------------------------
+bool I2CMUXCommand::relayList(char *list, uint16_t &relayMask)
+{
+  char *p = list;
+
+  relayMask = 0;
+  for (;;) {
+    char    *end;
+    uint32_t first = strtoul(p, &end, 10);
+    uint32_t last  = first;
+    if (end == p) break;
+    p = end;
+    if (*p == '-') {
+      last = strtoul(++p, &end, 10);
+      if (end == p) break;
+      p = end;
+    }
+    if (first < 1 || last > _numRelays || first > last) break;
+    for (uint32_t r = first; r <= last; r++) {
+      relayMask |= (1U << (r - 1));
+    }
+    if (*p == '\0') return (true);
+    if (*p != ',') break;
+    p++;
+  }
+  fail(p);
+  return (false);
+
+} // relayList()
+
+//-------------------------------------------------------------------------------------
+void I2CMUXCommand::fail(const char *where)
+{
+  _command.type     = I2CMUX_CMD_ERROR;
+  _command.errorPos = where - _line;
+}
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
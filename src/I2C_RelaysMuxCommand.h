@@ -0,0 +1,116 @@
+/*
+***************************************************************************
+**
+**  File    : I2C_RelaysMuxCommand.h
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  The command interpreter of the test sketches, without String's and
+**  without waiting for the Stream: commands are collected in a fixed
+**  buffer as the characters come in.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+
+#ifndef _I2C_RELAYSMUXCOMMAND_H
+#define _I2C_RELAYSMUXCOMMAND_H
+
+#include "I2C_RelaysMux.h"
+
+#ifndef I2CMUX_CMD_LINE_SIZE
+  #if defined(ARDUINO_ARCH_AVR)
+    #define I2CMUX_CMD_LINE_SIZE  32    // max. characters in one command
+  #else
+    #define I2CMUX_CMD_LINE_SIZE  64
+  #endif
+#endif
+#ifndef I2CMUX_CMD_SCENES
+  #define I2CMUX_CMD_SCENES       4     // max. scenes (addScene())
+#endif
+
+// What the last command is
+enum  {  I2CMUX_CMD_NONE          // nothing (yet)
+       , I2CMUX_CMD_RELAYS        // relays to switch: setMask and clearMask
+       , I2CMUX_CMD_WORD          // anything else: word [and value]
+       , I2CMUX_CMD_ERROR         // too long, or wrong relays: errorPos
+      };
+
+struct I2CMUX_Command {
+  uint8_t     type;               // I2CMUX_CMD_..
+  uint16_t    setMask;            // relays to close, bit (n-1) is relay n
+  uint16_t    clearMask;          // relays to open
+  const char *word;               // "status", "address48" .. (lower case)
+  int32_t     value;              // the number after "word=", -1 if there is none
+  uint8_t     errorPos;           // where the command went wrong
+};
+
+// A command ends with ';' or a new line. It is either one word, like
+// "status" or "pulse=2000", or one or more relay items (separated by
+// spaces) that are done left to right and sent as one write:
+//    3=1         close relay 3
+//    1-4,7=0     open relays 1 up to 4 and 7
+//    all=1       close all relays
+//    mask=0x0F0F set all relays: bit (n-1) is relay n
+//    @night      the scene "night" (addScene())
+// The same object must not be fed from two Streams at the same time
+class I2CMUXCommand
+{
+
+public:
+  I2CMUXCommand();
+
+  void      setNumRelays(uint8_t numRelays);      // for "all" and "mask" (default 16)
+  bool      addScene(const char *name, uint16_t setMask, uint16_t clearMask); // name is not copied
+  bool      poll(Stream &in);                     // read what is there, true when a command is complete
+  bool      feed(char c);                         // .. one character at a time
+  bool      parse(const char *text);              // exactly one command (REST), true if it is valid
+  const I2CMUX_Command &command();                // the last complete command
+  uint16_t  relayStates(uint16_t currentStates);  // the relays after the command
+  bool      apply(I2CMUX &relay);                 // I2CMUX_CMD_RELAYS in one write (plus a read, see .cpp)
+
+private:
+  char            _line[I2CMUX_CMD_LINE_SIZE];    // cut up in place by tokenize()
+  uint8_t         _length;
+  bool            _overflow;
+  uint8_t         _numRelays;
+  I2CMUX_Command  _command;
+  struct {
+    const char   *name;
+    uint16_t      setMask, clearMask;
+  }               _scenes[I2CMUX_CMD_SCENES];
+  uint8_t         _numScenes;
+
+  void      tokenize();
+  bool      relayItem(char *item);
+  bool      relayList(char *list, uint16_t &relayMask);
+  void      fail(const char *where);
+
+};
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,262 @@
+/*
+***************************************************************************  
+**
+**  File    : I2C_RelaysMuxGroup.cpp
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.                                                            
+***************************************************************************      
+*/
+
+#include "I2C_RelaysMuxGroup.h"
+
+// Constructor
+I2CMUXGroup::I2CMUXGroup() 
+{ 
+  _numBoards  = 0;
+  _nextTick   = 0;
+}
+
+// Scan wireBus for I2C_RelaysMux boards and add every board found to the group.
+// There is no delay between addresses; a board is only added if it tells us 
+// its own address (I2CMUX_WHOAMI) and has 8 or 16 relays (I2CMUX_NUMBEROFRELAYS).
+// Boards that are already in the group are skipped, so discover() can be
+// called again (after a bus recovery) without changing the relay numbers.
+// discover() does not start wireBus: call wireBus.begin() (with your pins
+// and clock) first. Returns the number of boards in the group
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXGroup::discover(TwoWire &wireBus, uint8_t firstAddress, uint8_t lastAddress)
+{
+  if (firstAddress < 1)   firstAddress = 1;
+  if (lastAddress > 127)  lastAddress  = 127;
+
+  for (uint8_t address = firstAddress; address <= lastAddress; address++) {
+    if (_numBoards >= I2CMUX_GROUP_MAX) break;
+    if (findBoard(wireBus, address) >= 0) continue;
+    bool ack;
+    {
+      I2CMUX_BUSLOCK(&wireBus);
+      wireBus.beginTransmission(address);
+      ack = (wireBus.endTransmission() == 0);
+    }
+    if (ack) {
+      addBoard(wireBus, address);
+    }
+    yield();
+  }
+  return (_numBoards);
+
+} // discover()
+
+// Add the board at deviceAddress to the group
+// Returns false if it is not an I2C_RelaysMux board, if it is already in
+// the group (or the group is full)
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::addBoard(TwoWire &wireBus, uint8_t deviceAddress)
+{
+  uint8_t numRelays;
+
+  if (_numBoards >= I2CMUX_GROUP_MAX)                       return (false);
+  if (findBoard(wireBus, deviceAddress) >= 0)               return (false);
+  if (!identify(wireBus, deviceAddress, &numRelays))        return (false);
+  if (!_boards[_numBoards].begin(wireBus, deviceAddress))   return (false);
+
+  _numRelays[_numBoards] = numRelays;
+  _numBoards++;
+  return (true);
+
+} // addBoard()
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXGroup::getNumBoards()
+{
+  return (_numBoards);
+}
+
+//-------------------------------------------------------------------------------------
+uint16_t I2CMUXGroup::getNumRelays()
+{
+  uint16_t numRelays = 0;
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    numRelays += _numRelays[b];
+  }
+  return (numRelays);
+}
+
+//-------------------------------------------------------------------------------------
+I2CMUX *I2CMUXGroup::getBoard(uint8_t boardNr)
+{
+  if (boardNr >= _numBoards) return (NULL);
+  return (&_boards[boardNr]);
+}
+
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::digitalWrite(uint16_t relayNr, byte HIGH_LOW)
+{
+  uint8_t boardNr, boardRelay;
+
+  if (!findRelay(relayNr, &boardNr, &boardRelay)) return (false);
+  return (_boards[boardNr].digitalWrite(boardRelay, HIGH_LOW));
+}
+
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::digitalRead(uint16_t relayNr)
+{
+  uint8_t boardNr, boardRelay;
+
+  if (!findRelay(relayNr, &boardNr, &boardRelay)) return (false);
+  return (_boards[boardNr].digitalRead(boardRelay));
+}
+
+// Set the relays on all boards, one transaction per board
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::writeAll(const uint16_t *relayMasks)
+{
+  bool success = true;
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    if (!_boards[b].writeAll(relayMasks[b])) success = false;
+  }
+  return (success);
+}
+
+// Send every board its new relayMask. Nothing switches until commit()
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::stageAll(const uint16_t *relayMasks)
+{
+  bool success = true;
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    if (!_boards[b].stageAll(relayMasks[b])) success = false;
+  }
+  return (success);
+}
+
+// Switch the staged relays on all boards with one General Call per bus
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::commit()
+{
+  bool success = true;
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    //-- only the first board on a bus sends the broadcast --
+    bool firstOnBus = true;
+    for (uint8_t p = 0; p < b; p++) {
+      if (_boards[p]._I2Cbus == _boards[b]._I2Cbus) firstOnBus = false;
+    }
+    if (firstOnBus && !I2CMUX::broadcastLatch(*_boards[b]._I2Cbus)) success = false;
+  }
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    if (success) _boards[b].stagedLatched();
+    else         _boards[b].invalidateCache();
+  }
+  return (success);
+
+} // commit()
+
+// The handle is only unique for the board relayNr is on
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXGroup::queueDigitalWrite(uint16_t relayNr, byte HIGH_LOW, I2CMUX_callback callback)
+{
+  uint8_t boardNr, boardRelay;
+
+  if (!findRelay(relayNr, &boardNr, &boardRelay)) return (0);
+  return (_boards[boardNr].queueDigitalWrite(boardRelay, HIGH_LOW, callback));
+}
+
+// Returns the number of boards that accepted their relayMask
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXGroup::queueWriteAll(const uint16_t *relayMasks)
+{
+  uint8_t queued = 0;
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    if (_boards[b].queueWriteAll(relayMasks[b]) != 0) queued++;
+  }
+  return (queued);
+}
+
+// Give every board a chance to execute its next operation. A busy board
+// just returns, so it does not hold up the other boards. The board that 
+// starts changes every call so all boards get the same share of the bus
+//-------------------------------------------------------------------------------------
+uint16_t I2CMUXGroup::tick()
+{
+  uint16_t pending = 0;
+
+  for (uint8_t i = 0; i < _numBoards; i++) {
+    pending += _boards[(_nextTick + i) % _numBoards].tick();
+  }
+  if (_numBoards > 0) _nextTick = (_nextTick + 1) % _numBoards;
+
+  return (pending);
+
+} // tick()
+
+// Index of the board at deviceAddress on wireBus, -1 if it is not in the group
+//-------------------------------------------------------------------------------------
+int8_t I2CMUXGroup::findBoard(TwoWire &wireBus, uint8_t deviceAddress)
+{
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    if (_boards[b]._I2Cbus == &wireBus && _boards[b]._I2Caddress == deviceAddress) return (b);
+  }
+  return (-1);
+}
+
+// Translate a group relay number into a board and the relay on that board
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::findRelay(uint16_t relayNr, uint8_t *boardNr, uint8_t *boardRelay)
+{
+  if (relayNr < 1) return (false);
+  for (uint8_t b = 0; b < _numBoards; b++) {
+    if (relayNr <= _numRelays[b]) {
+      *boardNr    = b;
+      *boardRelay = relayNr;
+      return (true);
+    }
+    relayNr -= _numRelays[b];
+  }
+  return (false);
+
+} // findRelay()
+
+// Read I2CMUX_WHOAMI and I2CMUX_NUMBEROFRELAYS in one transaction
+//-------------------------------------------------------------------------------------
+bool I2CMUXGroup::identify(TwoWire &wireBus, uint8_t deviceAddress, uint8_t *numRelays)
+{
+  I2CMUX_BUSLOCK(&wireBus);
+  wireBus.beginTransmission(deviceAddress);
+  wireBus.write(I2CMUX_WHOAMI);
+  if (wireBus.endTransmission() != 0) {
+    return (false); // Slave did not ack
+  }
+  if (wireBus.requestFrom(deviceAddress, (uint8_t) 2) != 2) {
+    return (false); // Slave did not respond
+  }
+  uint8_t whoAmI = wireBus.read();
+  *numRelays     = wireBus.read();
+
+  return (whoAmI == deviceAddress && (*numRelays == 8 || *numRelays == 16));
+
+} // identify()
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
@@ -0,0 +1,81 @@
+/*
+***************************************************************************  
+**
+**  File    : I2C_RelaysMuxGroup.h
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.                                                            
+***************************************************************************      
+*/
+
+
+#ifndef _I2C_RELAYSMUXGROUP_H
+#define _I2C_RELAYSMUXGROUP_H
+
+#include "I2C_RelaysMux.h"
+
+#ifndef I2CMUX_GROUP_MAX
+  #define I2CMUX_GROUP_MAX  8     // max. number of boards in a group
+#endif
+
+// Manage many I2C_RelaysMux boards (on one or more I2C busses) as if
+// they are one big board. Relays are numbered 1 .. getNumRelays() in the
+// order the boards are added (or discovered)
+class I2CMUXGroup
+{
+
+public:
+  I2CMUXGroup();
+
+  uint8_t   discover(TwoWire &wireBus = Wire, uint8_t firstAddress = 1, uint8_t lastAddress = 127);
+  bool      addBoard(TwoWire &wireBus, uint8_t deviceAddress);
+  uint8_t   getNumBoards();
+  uint16_t  getNumRelays();                       // relays on all boards
+  I2CMUX   *getBoard(uint8_t boardNr);            // 0 .. getNumBoards()-1
+  bool      digitalWrite(uint16_t relayNr, byte HIGH_LOW);
+  bool      digitalRead(uint16_t relayNr);
+  bool      writeAll(const uint16_t *relayMasks); // one relayMask per board
+  bool      stageAll(const uint16_t *relayMasks); // one relayMask per board ..
+  bool      commit();                             // .. switched on all boards at once
+  uint8_t   queueDigitalWrite(uint16_t relayNr, byte HIGH_LOW, I2CMUX_callback callback = NULL);
+  uint8_t   queueWriteAll(const uint16_t *relayMasks);
+  uint16_t  tick();                               // call from loop(), returns pending operations
+
+private:
+  I2CMUX    _boards[I2CMUX_GROUP_MAX];
+  uint8_t   _numRelays[I2CMUX_GROUP_MAX];
+  uint8_t   _numBoards;
+  uint8_t   _nextTick;
+
+  int8_t    findBoard(TwoWire &wireBus, uint8_t deviceAddress);
+  bool      findRelay(uint16_t relayNr, uint8_t *boardNr, uint8_t *boardRelay);
+  bool      identify(TwoWire &wireBus, uint8_t deviceAddress, uint8_t *numRelays);
+
+};
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+* 
+***************************************************************************/
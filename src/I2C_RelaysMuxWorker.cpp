@@ -0,0 +1,261 @@
+/*
+***************************************************************************
+**
+**  File    : I2C_RelaysMuxWorker.cpp
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+#include "I2C_RelaysMuxWorker.h"
+
+#ifdef I2CMUX_ENABLE_TASKS
+
+static_assert((I2CMUX_WORKER_QUEUE_SIZE & (I2CMUX_WORKER_QUEUE_SIZE - 1)) == 0,
+              "I2CMUX_WORKER_QUEUE_SIZE must be a power of 2");
+
+#define _WORKER_MASK    (I2CMUX_WORKER_QUEUE_SIZE - 1)
+#define _WORKER_IDLE    10      // msecs the worker sleeps without a notify()
+
+// Constructor
+I2CMUXWorker::I2CMUXWorker()
+{
+  for (uint32_t c = 0; c < I2CMUX_WORKER_QUEUE_SIZE; c++) {
+    _cells[c].seq.store(c, std::memory_order_relaxed);
+  }
+  _enqueuePos.store(0);
+  _dequeuePos.store(0);
+  _running.store(false);
+  _submitted.store(0);
+  _served.store(0);
+  _failed.store(0);
+  _refused.store(0);
+#if defined(ARDUINO_ARCH_ESP32)
+  _task       = NULL;
+#endif
+}
+
+// Start the worker task. Without begin() the requests can be served by
+// calling serve() from one (and only one) task, like loop()
+//-------------------------------------------------------------------------------------
+bool I2CMUXWorker::begin(uint8_t priority, int8_t core)
+{
+  if (_running.exchange(true)) return (false);
+
+#if defined(ARDUINO_ARCH_ESP32)
+  BaseType_t result;
+  if (core < 0) {
+    result = xTaskCreate(workerLoop, "I2CMUX", I2CMUX_WORKER_STACK, this, priority, &_task);
+  }
+  else {
+    result = xTaskCreatePinnedToCore(workerLoop, "I2CMUX", I2CMUX_WORKER_STACK, this, priority, &_task, core);
+  }
+  if (result != pdPASS) {
+    _running.store(false);
+    return (false);
+  }
+#else
+  (void)priority;
+  (void)core;
+  _thread = std::thread(workerLoop, this);
+#endif
+  return (true);
+
+} // begin()
+
+//-------------------------------------------------------------------------------------
+void I2CMUXWorker::end()
+{
+  if (!_running.exchange(false)) return;
+
+  _signal.notify();
+#if defined(ARDUINO_ARCH_ESP32)
+  _stopped.wait(portMAX_DELAY);
+  _task = NULL;
+#else
+  _thread.join();
+#endif
+  serve();    // requests submitted while the worker stopped
+
+} // end()
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::submitPinMode(I2CMUX &board, byte GPIO_PIN, byte PINMODE, I2CMUX_callback callback)
+{
+  I2CMUX_Request request = { &board, I2CMUX_OP_PINMODE, GPIO_PIN, PINMODE, callback };
+  return (submit(request));
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::submitDigitalWrite(I2CMUX &board, byte GPIO_PIN, byte HIGH_LOW, I2CMUX_callback callback)
+{
+  I2CMUX_Request request = { &board, I2CMUX_OP_DIGITALWRITE, GPIO_PIN, HIGH_LOW, callback };
+  return (submit(request));
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::submitWriteAll(I2CMUX &board, uint16_t relayMask, I2CMUX_callback callback)
+{
+  I2CMUX_Request request = { &board, I2CMUX_OP_WRITEALL, 0, relayMask, callback };
+  return (submit(request));
+}
+
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::submitReadAll(I2CMUX &board, I2CMUX_callback callback)
+{
+  I2CMUX_Request request = { &board, I2CMUX_OP_READALL, 0, 0, callback };
+  return (submit(request));
+}
+
+// A producer claims the cell at _enqueuePos with a compare-and-swap, fills
+// it and then publishes it by setting its seq to pos + 1. A cell the worker
+// has not taken yet has a seq below pos: the queue is full
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::submit(const I2CMUX_Request &request)
+{
+  Cell     *cell;
+  uint32_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+  for (;;) {
+    cell = &_cells[pos & _WORKER_MASK];
+    int32_t diff = (int32_t)(cell->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      //-- another task was first, pos now holds the new _enqueuePos --
+    }
+    else if (diff < 0) {
+      _refused.fetch_add(1, std::memory_order_relaxed);
+      return (0);
+    }
+    else {
+      pos = _enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->request = request;
+  cell->handle  = (pos % 255) + 1;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  _submitted.fetch_add(1, std::memory_order_relaxed);
+  _signal.notify();
+  return ((pos % 255) + 1);
+
+} // submit()
+
+// Execute everything that is queued. Only one task may serve a worker
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::serve()
+{
+  I2CMUX_Request request;
+  uint8_t        handle;
+  uint8_t        served = 0;
+
+  while (take(request, handle)) {
+    uint16_t value   = request.value;
+    bool     success = execute(request, value);
+    _served.fetch_add(1, std::memory_order_relaxed);
+    if (!success) _failed.fetch_add(1, std::memory_order_relaxed);
+    if (request.callback) request.callback(handle, success, value);
+    served++;
+  }
+  return (served);
+
+} // serve()
+
+// Requests that are submitted but not (yet) served
+//-------------------------------------------------------------------------------------
+uint8_t I2CMUXWorker::pending()
+{
+  return (_enqueuePos.load(std::memory_order_relaxed) - _dequeuePos.load(std::memory_order_relaxed));
+}
+
+//-------------------------------------------------------------------------------------
+void I2CMUXWorker::getStats(I2CMUX_WorkerStats &stats)
+{
+  stats.submitted = _submitted.load(std::memory_order_relaxed);
+  stats.served    = _served.load(std::memory_order_relaxed);
+  stats.failed    = _failed.load(std::memory_order_relaxed);
+  stats.refused   = _refused.load(std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------
+//-------------------------- HELPER FUNCTIONS -----------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Take the oldest published request and hand its cell back to the producers
+//-------------------------------------------------------------------------------------
+bool I2CMUXWorker::take(I2CMUX_Request &request, uint8_t &handle)
+{
+  uint32_t pos  = _dequeuePos.load(std::memory_order_relaxed);
+  Cell     *cell = &_cells[pos & _WORKER_MASK];
+
+  if ((int32_t)(cell->seq.load(std::memory_order_acquire) - (pos + 1)) < 0) {
+    return (false);   // empty, or the producer is still filling it
+  }
+  request = cell->request;
+  handle  = cell->handle;
+  cell->seq.store(pos + I2CMUX_WORKER_QUEUE_SIZE, std::memory_order_release);
+  _dequeuePos.store(pos + 1, std::memory_order_relaxed);
+  return (true);
+
+} // take()
+
+// Every transaction of the board holds the bus lock, so other tasks that
+// use the bus directly (or another worker) can not get in between
+//-------------------------------------------------------------------------------------
+bool I2CMUXWorker::execute(const I2CMUX_Request &request, uint16_t &value)
+{
+  I2CMUX *board = request.board;
+
+  switch(request.type)
+  {
+    case I2CMUX_OP_PINMODE:       return (board->pinMode(request.relay, request.value));
+    case I2CMUX_OP_DIGITALWRITE:  return (board->digitalWrite(request.relay, request.value));
+    case I2CMUX_OP_WRITEALL:      return (board->writeAll(request.value));
+    case I2CMUX_OP_READALL:       return (board->readAll(value) == I2CMUX_OK);
+  }
+  return (false);
+
+} // execute()
+
+//-------------------------------------------------------------------------------------
+void I2CMUXWorker::workerLoop(void *arg)
+{
+  I2CMUXWorker *worker = (I2CMUXWorker *)arg;
+
+  while (worker->_running.load()) {
+    if (worker->serve() == 0) worker->_signal.wait(_WORKER_IDLE);
+  }
+#if defined(ARDUINO_ARCH_ESP32)
+  worker->_stopped.notify();
+  vTaskDelete(NULL);
+#endif
+
+} // workerLoop()
+
+#endif // I2CMUX_ENABLE_TASKS
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/
@@ -0,0 +1,129 @@
+/*
+***************************************************************************
+**
+**  File    : I2C_RelaysMuxWorker.h
+**  Version : v1.0
+**
+**  Copyright (c) 2020 Willem Aandewiel
+**
+**  Only with I2CMUX_ENABLE_TASKS: one task that does all bus I/O for
+**  many other tasks. submit..() never blocks and never takes a lock, it
+**  claims a slot in a bounded ring with a compare-and-swap, so a web,
+**  MQTT or scheduler task is never held up by a slow transaction.
+**  The worker executes the requests in order and calls the callback
+**  (from the worker task!) when a request is done.
+**
+**  TERMS OF USE: MIT License. See bottom of file.
+***************************************************************************
+*/
+
+
+#ifndef _I2C_RELAYSMUXWORKER_H
+#define _I2C_RELAYSMUXWORKER_H
+
+#include "I2C_RelaysMux.h"
+
+#ifdef I2CMUX_ENABLE_TASKS
+
+#include <atomic>
+#if !defined(ARDUINO_ARCH_ESP32)
+  #include <thread>
+#endif
+
+#ifndef I2CMUX_WORKER_QUEUE_SIZE
+  #define I2CMUX_WORKER_QUEUE_SIZE  32    // must be a power of 2
+#endif
+
+#ifndef I2CMUX_WORKER_STACK
+  #define I2CMUX_WORKER_STACK     3072    // ESP32 task stack (bytes)
+#endif
+
+struct I2CMUX_Request {
+  I2CMUX          *board;
+  uint8_t         type;     // I2CMUX_OP_..
+  uint8_t         relay;
+  uint16_t        value;    // HIGH_LOW, PINMODE or relayMask
+  I2CMUX_callback callback;
+};
+
+struct I2CMUX_WorkerStats {
+  uint32_t  submitted;      // accepted by submit..()
+  uint32_t  served;         // executed by the worker
+  uint32_t  failed;         // executed, but the board did not do it
+  uint32_t  refused;        // submit..() calls that returned 0 (the queue was full),
+                            // a caller that tries again is counted again
+};
+
+class I2CMUXWorker
+{
+public:
+  I2CMUXWorker();
+
+  bool    begin(uint8_t priority = 1, int8_t core = -1);  // starts the worker task
+  void    end();                                          // serves what is queued, then stops
+
+  //-- callable from any task, returns a handle (1..255) or 0 if the queue is full --
+  uint8_t submitPinMode(I2CMUX &board, byte GPIO_PIN, byte PINMODE, I2CMUX_callback callback = NULL);
+  uint8_t submitDigitalWrite(I2CMUX &board, byte GPIO_PIN, byte HIGH_LOW, I2CMUX_callback callback = NULL);
+  uint8_t submitWriteAll(I2CMUX &board, uint16_t relayMask, I2CMUX_callback callback = NULL);
+  uint8_t submitReadAll(I2CMUX &board, I2CMUX_callback callback = NULL);
+  uint8_t submit(const I2CMUX_Request &request);
+
+  uint8_t serve();                // executes all queued requests, returns how many
+  uint8_t pending();
+  void    getStats(I2CMUX_WorkerStats &stats);
+
+private:
+  struct Cell {
+    std::atomic<uint32_t> seq;    // == pos: free for that pos, == pos+1: filled
+    I2CMUX_Request        request;
+    uint8_t               handle;
+  };
+
+  bool    take(I2CMUX_Request &request, uint8_t &handle);
+  bool    execute(const I2CMUX_Request &request, uint16_t &value);
+  static void workerLoop(void *arg);
+
+  Cell                  _cells[I2CMUX_WORKER_QUEUE_SIZE];
+  std::atomic<uint32_t> _enqueuePos;    // shared by all producers
+  std::atomic<uint32_t> _dequeuePos;    // only moved by the worker
+  std::atomic<bool>     _running;
+  std::atomic<uint32_t> _submitted, _served, _failed, _refused;
+  I2CMUX_Signal         _signal;
+#if defined(ARDUINO_ARCH_ESP32)
+  TaskHandle_t          _task;
+  I2CMUX_Signal         _stopped;
+#else
+  std::thread           _thread;
+#endif
+
+  I2CMUXWorker(const I2CMUXWorker &);
+  I2CMUXWorker &operator=(const I2CMUXWorker &);
+};
+
+#endif // I2CMUX_ENABLE_TASKS
+
+#endif
+
+/***************************************************************************
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to permit
+* persons to whom the Software is furnished to do so, subject to the
+* following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT
+* OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR
+* THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*
+***************************************************************************/